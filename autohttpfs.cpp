@@ -22,6 +22,10 @@
 #include "curlaccessor.h"
 #include "dirent.h"
 #include "log.h"
+#include "workerpool.h"
+#include "readahead.h"
+#include "contentcache.h"
+#include "recorder.h"
 #include "int64format.h"
 
 
@@ -36,6 +40,14 @@ void AutoHttpFs::parse_args(const char*& help, int& argc, char* argv[])
   m_max_readahead = 0x20000;
   int ll = Log::NOTE;
   int mr = 0x20000;
+  m_workers = WORKERPOOL_WORKERS;
+  m_queue_max = WORKERPOOL_QUEUE_MAX;
+  m_meta_reserved = WORKERPOOL_META_RESERVED;
+  m_ra_workers = m_bg_workers = 0;
+  int ra = READAHEAD_WINDOW;
+  m_cache_dir = "/tmp";
+  m_cache_size = CONTENTCACHE_SIZE_MB;
+  int slow = RECORDER_SLOW_MSEC;
   bool ro = true, ne = true;
 
   for(int it=1; it<argc; it++) {
@@ -44,6 +56,15 @@ void AutoHttpFs::parse_args(const char*& help, int& argc, char* argv[])
     parsearg_helper(ll, "--loglevel=", argc, argv+it, it);
     parsearg_helper(m_root, "--root=", argc, argv+it, it);
     parsearg_helper(mr, "--max_readahead=", argc, argv+it, it);
+    parsearg_helper(m_workers, "--workers=", argc, argv+it, it);
+    parsearg_helper(m_queue_max, "--queue_max=", argc, argv+it, it);
+    parsearg_helper(m_meta_reserved, "--meta_workers=", argc, argv+it, it);
+    parsearg_helper(m_ra_workers, "--ra_workers=", argc, argv+it, it);
+    parsearg_helper(m_bg_workers, "--bg_workers=", argc, argv+it, it);
+    parsearg_helper(ra, "--readahead=", argc, argv+it, it);
+    parsearg_helper(m_cache_dir, "--cache_dir=", argc, argv+it, it);
+    parsearg_helper(m_cache_size, "--cache_size=", argc, argv+it, it);
+    parsearg_helper(slow, "--slow_ms=", argc, argv+it, it);
     if(strcmp("--help", argv[it])==0) {
       help = "autohttpfs options:\n" \
              "    --readonly=SW       modify file permission.\n" \
@@ -52,13 +73,26 @@ void AutoHttpFs::parse_args(const char*& help, int& argc, char* argv[])
              "                          'yes':non executable, 'no':executable (default:yes)\n" \
              "    --root=DIR          (default: / (root))\n" \
              "    --loglevel=N        syslog level (default: 5 (NOTE))\n" \
-             "    --max_readahead     fuse_conn.info.max_readahead (default: 131072)\n";
+             "                          7 (DEBUG) and 8 (VERBOSE) need a build with DEBUG_OPT.\n" \
+             "    --max_readahead     fuse_conn.info.max_readahead (default: 131072)\n" \
+             "    --workers=N         HTTP worker threads, 0:run on fuse threads (default: 16)\n" \
+             "    --queue_max=N       pending HTTP requests per lane before blocking (default: 256)\n" \
+             "    --meta_workers=N    workers reserved for getattr/open/readdir (default: 4)\n" \
+             "    --readahead=BYTES   sequential readahead window, 0:disable (default: 1048576)\n" \
+             "    --ra_workers=N      max workers for readahead (default: workers/2)\n" \
+             "    --bg_workers=N      max workers for background requests (default: workers/4)\n" \
+             "    --cache_dir=DIR     directory for cached file contents (default: /tmp)\n" \
+             "    --cache_size=MB     max size of cached file contents, 0:disable (default: 256)\n" \
+             "    --slow_ms=MSEC      requests kept in .proc/debug/slow, 0:disable (default: 1000)\n";
     }
   }
   glog.loglevel((Log::LOGLEVEL)ll);
   m_file_readonly = ro;
   m_file_noexec = ne;
   m_max_readahead = mr;
+  m_readahead = (ra>0)? ra: 0;
+  if(m_cache_size<0) m_cache_size = 0;
+  Recorder::slow_msec((slow>0)? slow: 0);
 }
 
 
@@ -68,18 +102,27 @@ void AutoHttpFs::parsearg_helper(std::string& opt, const char* key, int& argc, c
   if(strncmp(*argv, key, kl)==0) {
     opt = argv[0] + kl;
     parsearg_shift(argc, argv, it);
-    glog(Log::DEBUG, "parse_args: '%s' => '%s'\n", key, opt.c_str());
+    LOG(glog, Log::DEBUG, "parse_args: '%s' => '%s'\n", key, opt.c_str());
   }
 }
 
 
+// counts and sizes: a negative or malformed value keeps the default.
 void AutoHttpFs::parsearg_helper(int& opt, const char* key, int& argc, char** argv, int& it)
 {
   size_t kl = strlen(key);
   if(strncmp(*argv, key, kl)==0) {
-    opt = atoi(argv[0] + kl);
+    char* v = argv[0] + kl;
+    char* e;
+    errno = 0;
+    long n = strtol(v, &e, 10);
+    if((*v=='\0') || (*e!='\0') || (errno!=0) || (n<0) || (n>INT_MAX)) {
+      glog(Log::ERR, "Invalid options: '%s' for '%s'.\n", v, key);
+    } else {
+      opt = (int)n;
+    }
     parsearg_shift(argc, argv, it);
-    glog(Log::DEBUG, "parse_args: '%s' => %d\n", key, opt);
+    LOG(glog, Log::DEBUG, "parse_args: '%s' => %d\n", key, opt);
   }
 }
 
@@ -97,7 +140,7 @@ void AutoHttpFs::parsearg_helper(bool& opt, const char* key, int& argc, char** a
       glog(Log::ERR, "Invalid options: '%s' for '%s'.\n", key, v);
     }
     parsearg_shift(argc, argv, it);
-    glog(Log::DEBUG, "parse_args: '%s' => %d\n", key, opt);
+    LOG(glog, Log::DEBUG, "parse_args: '%s' => %d\n", key, opt);
   }
 }
 
@@ -135,7 +178,7 @@ int AutoHttpFs::getattr(const char* path, struct stat *stbuf)
 {
   AutoHttpFsContexts* ctxs = &AUTOHTTPFSCONTEXTS;
   AutoHttpFs* self = ctxs->fs();
-  glog(Log::DEBUG, ">> %s(%s) ctxs=%p, this=%p\n", __FUNCTION__, path, ctxs, self);
+  LOG(glog, Log::DEBUG, ">> %s(%s) ctxs=%p, this=%p\n", __FUNCTION__, path, ctxs, self);
 
   memset(stbuf, 0, sizeof(struct stat));
   if(self->errcode()!=0) return self->errcode();
@@ -172,7 +215,7 @@ int AutoHttpFs::getattr(const char* path, struct stat *stbuf)
 int AutoHttpFs::opendir(const char* path, struct fuse_file_info *ffi)
 {
   AutoHttpFsContexts* ctxs = &AUTOHTTPFSCONTEXTS;
-  glog(Log::DEBUG, ">> %s(%s) ctxs=%p\n", __FUNCTION__, path, ctxs);
+  LOG(glog, Log::DEBUG, ">> %s(%s) ctxs=%p\n", __FUNCTION__, path, ctxs);
 
   // for proc/.
   if(ctxs->proc_opendir(glog, path, *ffi)==0) return 0;
@@ -185,7 +228,7 @@ int AutoHttpFs::opendir(const char* path, struct fuse_file_info *ffi)
   if(us.is_dir()) {
     AutoHttpFsContext* ctx = AUTOHTTPFSCONTEXTS.alloc_context();
     ffi->fh = ctx->seq();
-    glog(Log::DEBUG, "   => fh=%"FINT64"d, ctx=%p\n", ffi->fh, ctx);
+    LOG(glog, Log::DEBUG, "   => fh=%"FINT64"d, ctx=%p\n", ffi->fh, ctx);
     return 0;
   }
   if(us.is_reg()) return -ENOTDIR;
@@ -199,42 +242,46 @@ int AutoHttpFs::readdir(const char *path, void *buf, fuse_fill_dir_t filler, off
   AutoHttpFsContexts* ctxs = &AUTOHTTPFSCONTEXTS;
   AutoHttpFsContext* ctx = AUTOHTTPFSCONTEXTS.find(ffi->fh);
   AutoHttpFs* self = ctxs->fs();
-  glog(Log::DEBUG, ">> %s(%s) fh=%"FINT64"d, ctx=%p, this=%p\n", __FUNCTION__, path, ffi->fh, ctx, self);
+  LOG(glog, Log::DEBUG, ">> %s(%s) fh=%"FINT64"d, ctx=%p, this=%p\n", __FUNCTION__, path, ffi->fh, ctx, self);
 
   if(ffi->fh==0) return -EINVAL;
 
-  filler(buf, ".", NULL, 0);
-  filler(buf, "..", NULL, 0);
-  if(strcmp(path, "/")==0) return 0;
+  if((strcmp(path, "/")==0) || (ctx->proc!=NULL)) {
+    filler(buf, ".", NULL, 0);
+    filler(buf, "..", NULL, 0);
 
-  // for proc/.
-  if(ctx->proc!=NULL) return ctx->proc->readdir(glog, buf, filler, offset);
-
-  // for normal files.
-  CurlAccessor ca(path, true);
-  ca.add_header("Accept", "text/json;hash");
-  std::string json;
-  int r = ca.get(glog, json);
-  if(r!=200) return 0;
-  if(ca.content_type().compare("text/json")!=0) return 0;
-
-  Direntries de;
-  try { de.from_json(json); }
-  catch(std::string e) {
-    glog(Log::INFO, "JSON parse failed in %s - %s\n", __FUNCTION__, e.c_str());
-    std::string e;
+    // for proc/.
+    if(ctx->proc!=NULL) return ctx->proc->readdir(glog, buf, filler, offset);
     return 0;
   }
-  for(Direntries::iterator it = de.begin(); it!=de.end(); it++) {
+
+  // for normal files: the listing is passed as it arrives, in several calls.
+  // the offset of an entry is the index of the next one; "." and ".." are 0 and 1.
+  if(offset==0) {
+    if(filler(buf, ".", NULL, 1)) return 0;
+    offset = 1;
+  }
+  if(offset==1) {
+    if(filler(buf, "..", NULL, 2)) return 0;
+    offset = 2;
+  }
+  for(uint64_t index=offset-2; ; index++) {
+    DirentList::Entry ent;
+    const char* name;
+    // waits for the first entry only, the rest is for the next call.
+    int r = ctx->readdir().get(glog, ctxs->pool(), path, index, index==(uint64_t)offset-2, ent, name);
+    if(r==-EINTR) return r;
+    if(r<=0) break;
+
     struct stat st;
-    if((*it).mode &  S_IFDIR) {
+    if(ent.mode &  S_IFDIR) {
       memcpy(&st, self->stat_d(), sizeof(st));
     } else {
       memcpy(&st, self->stat_r(), sizeof(st));
-      if((*it).mode & S_IFLNK) st.st_mode |= S_IFLNK;
-      st.st_size = (*it).size;
+      if(ent.mode & S_IFLNK) st.st_mode |= S_IFLNK;
+      st.st_size = ent.size;
     }
-    filler(buf, (*it).name.c_str(), &st, 0);
+    if(filler(buf, name, &st, index + 3)) break;
   }
 
   return 0;
@@ -245,12 +292,13 @@ int AutoHttpFs::readdir(const char *path, void *buf, fuse_fill_dir_t filler, off
 int AutoHttpFs::releasedir(const char* path, struct fuse_file_info *ffi)
 {
   AutoHttpFsContext* ctx = AUTOHTTPFSCONTEXTS.find(ffi->fh);
-  glog(Log::DEBUG, ">> %s(%s) ffi=%p, fh=%"FINT64"d, ctx=%p\n", __FUNCTION__, path, ffi, ffi->fh, ctx);
+  LOG(glog, Log::DEBUG, ">> %s(%s) ffi=%p, fh=%"FINT64"d, ctx=%p\n", __FUNCTION__, path, ffi, ffi->fh, ctx);
 
   // for proc/.
   if(ctx->proc) ctx->proc->releasedir(glog);
 
   // for normal files.
+  ctx->readdir().cancel(AUTOHTTPFSCONTEXTS.pool());
   AUTOHTTPFSCONTEXTS.release_context(ctx);
   return 0;
 }
@@ -260,7 +308,7 @@ int AutoHttpFs::releasedir(const char* path, struct fuse_file_info *ffi)
 int AutoHttpFs::truncate(const char* path, off_t size)
 {
   AutoHttpFsContexts* ctxs = &AUTOHTTPFSCONTEXTS;
-  glog(Log::DEBUG, ">> %s(%s) ctxs=%p\n", __FUNCTION__, path, ctxs);
+  LOG(glog, Log::DEBUG, ">> %s(%s) ctxs=%p\n", __FUNCTION__, path, ctxs);
 
   // for proc/.
   if(ctxs->proc_truncate(glog, path, size)==0) return 0;
@@ -274,7 +322,7 @@ int AutoHttpFs::truncate(const char* path, off_t size)
 int AutoHttpFs::open(const char* path, struct fuse_file_info* ffi)
 {
   AutoHttpFsContexts* ctxs = &AUTOHTTPFSCONTEXTS;
-  glog(Log::DEBUG, ">> %s(%s) ctxs=%p\n", __FUNCTION__, path, ctxs);
+  LOG(glog, Log::DEBUG, ">> %s(%s) ctxs=%p\n", __FUNCTION__, path, ctxs);
 
   // for proc/.
   if(ctxs->proc_open(glog, path, *ffi)==0) return 0;
@@ -286,8 +334,9 @@ int AutoHttpFs::open(const char* path, struct fuse_file_info* ffi)
 
   if(us.is_reg()) {
     AutoHttpFsContext* ctx = AUTOHTTPFSCONTEXTS.alloc_context();
+    ctx->content(ctxs->content().open(glog, path, us.length, us.mtime));
     ffi->fh = ctx->seq();
-    glog(Log::DEBUG, "   => fh=%"FINT64"d, ctx=%p\n", ffi->fh, ctx);
+    LOG(glog, Log::DEBUG, "   => fh=%"FINT64"d, ctx=%p\n", ffi->fh, ctx);
     return 0;
   }
   if(us.is_dir()) return -EINVAL;
@@ -299,7 +348,8 @@ int AutoHttpFs::open(const char* path, struct fuse_file_info* ffi)
 int AutoHttpFs::read(const char* path, char* buf, size_t size, off_t offset, struct fuse_file_info* ffi)
 {
   AutoHttpFsContext* ctx = AUTOHTTPFSCONTEXTS.find(ffi->fh);
-  glog(Log::DEBUG, ">> %s(%s) ffi=%p, fh=%"FINT64"d, ctx=%p, size=%"FINT64"d, offset=%"FINT64"d\n", \
+  AutoHttpFs* self = AUTOHTTPFSCONTEXTS.fs();
+  LOG(glog, Log::DEBUG, ">> %s(%s) ffi=%p, fh=%"FINT64"d, ctx=%p, size=%"FINT64"d, offset=%"FINT64"d\n", \
                         __FUNCTION__, path, ffi, ffi->fh, ctx, (off_t)size, offset);
 
   if(ffi->fh==0) return -EINVAL;
@@ -318,20 +368,106 @@ int AutoHttpFs::read(const char* path, char* buf, size_t size, off_t offset, str
     size = us.length - offset;
   }
   if(size<0) return 0;
+  AUTOHTTPFSCONTEXTS.content().access(path, offset, size);
+
+  if(ctx->content()) {
+    r = load(ctx, path, us.length, size, offset);
+    if(r!=0) return r;
+    ssize_t n = pread(ctx->content()->fd(), buf, size, offset);
+    return (n>=0)? n: -errno;
+  }
+
+  r = ctx->readahead().read(glog, AUTOHTTPFSCONTEXTS.pool(), path, buf, size, offset, us.length, self->readahead());
+  if(r!=0) return r;
 
   CurlAccessor ca(path);
   r = ca.get(glog, buf, offset, size);
   if((r==200)||(r==206)) return size;
+  if(ca.aborted()) return -EINTR;
 
   return -ENOENT;
 }
 
 
+#if FUSE_VERSION >= 29
+// fuse::read_buf
+// Cached contents are returned as an fd-backed buffer, so that libfuse can splice them to the kernel.
+int AutoHttpFs::read_buf(const char* path, struct fuse_bufvec** bufp, size_t size, off_t offset, struct fuse_file_info* ffi)
+{
+  AutoHttpFsContext* ctx = AUTOHTTPFSCONTEXTS.find(ffi->fh);
+  LOG(glog, Log::DEBUG, ">> %s(%s) ffi=%p, fh=%"FINT64"d, ctx=%p, size=%"FINT64"d, offset=%"FINT64"d\n", \
+                        __FUNCTION__, path, ffi, ffi->fh, ctx, (off_t)size, offset);
+
+  if(ffi->fh==0) return -EINVAL;
+
+  struct fuse_bufvec* bv = (struct fuse_bufvec*)malloc(sizeof(struct fuse_bufvec));
+  if(bv==NULL) return -ENOMEM;
+  memset(bv, 0, sizeof(struct fuse_bufvec));
+  bv->count = 1;
+  *bufp = bv;
+
+  // for proc/ and non-cached files: copy into memory.
+  if(ctx->proc || (ctx->content()==NULL)) {
+    bv->buf[0].mem = malloc(size);
+    if(bv->buf[0].mem==NULL) return -ENOMEM;
+    int r = read(path, (char*)bv->buf[0].mem, size, offset, ffi);
+    if(r>0) bv->buf[0].size = r;
+    return (r<0)? r: 0;
+  }
+
+  // for normal files.
+  UrlStat us;
+  int r = ctx->get_attr(glog, path, us);
+  if(r!=0) return r;
+  if(!us.is_reg()) return -EINVAL;
+
+  if((uint64_t)offset>=us.length) return 0;
+  if((uint64_t)offset+(uint64_t)size>=us.length) {
+    size = us.length - offset;
+  }
+  AUTOHTTPFSCONTEXTS.content().access(path, offset, size);
+
+  r = load(ctx, path, us.length, size, offset);
+  if(r!=0) return r;
+
+  bv->buf[0].size = size;
+  bv->buf[0].flags = (enum fuse_buf_flags)(FUSE_BUF_IS_FD | FUSE_BUF_FD_SEEK);
+  bv->buf[0].fd = ctx->content()->fd();
+  bv->buf[0].pos = offset;
+  return 0;
+}
+#endif
+
+
+// make [offset, offset+size) of the content file available.
+int AutoHttpFs::load(AutoHttpFsContext* ctx, const char* path, uint64_t length, size_t size, off_t offset)
+{
+  AutoHttpFs* self = AUTOHTTPFSCONTEXTS.fs();
+  ContentFile* cf = ctx->content();
+
+  ReadAheadJob* job = ctx->readahead().advance(glog, AUTOHTTPFSCONTEXTS.pool(), path, size, offset, length, self->readahead(), cf);
+  if(cf->has(offset, size)) {
+    ctx->readahead().release(job);
+    return 0;
+  }
+  if(job) {
+    int r = ctx->readahead().complete(AUTOHTTPFSCONTEXTS.pool(), job, NULL, size, offset);
+    if(r<0) return r;
+    if(cf->has(offset, size)) return 0;
+  }
+  int r = cf->fetch(glog, offset, size);
+  if(r==-EINTR) return r;
+  // a short body may still cover the range; otherwise its holes must not be read as zeros.
+  if(cf->has(offset, size)) return 0;
+  return (r==0)? -EIO: r;
+}
+
+
 // fuse::write
 int AutoHttpFs::write(const char* path, const char* buf, size_t size, off_t offset, struct fuse_file_info* ffi)
 {
   AutoHttpFsContext* ctx = AUTOHTTPFSCONTEXTS.find(ffi->fh);
-  glog(Log::DEBUG, ">> %s(%s) ffi=%p, fh=%"FINT64"d, ctx=%p, size=%"FINT64"d, offset=%"FINT64"d\n", \
+  LOG(glog, Log::DEBUG, ">> %s(%s) ffi=%p, fh=%"FINT64"d, ctx=%p, size=%"FINT64"d, offset=%"FINT64"d\n", \
                         __FUNCTION__, path, ffi, ffi->fh, ctx, (off_t)size, offset);
 
   if(ffi->fh==0) return -EINVAL;
@@ -348,7 +484,7 @@ int AutoHttpFs::write(const char* path, const char* buf, size_t size, off_t offs
 int AutoHttpFs::flush(const char* path, struct fuse_file_info* ffi)
 {
   AutoHttpFsContext* ctx = AUTOHTTPFSCONTEXTS.find(ffi->fh);
-  glog(Log::INFO, ">> %s(%s) ffi=%p, fh=%"FINT64"d, ctx=%p\n", __FUNCTION__, path, ffi, ffi->fh, ctx);
+  LOG(glog, Log::INFO, ">> %s(%s) ffi=%p, fh=%"FINT64"d, ctx=%p\n", __FUNCTION__, path, ffi, ffi->fh, ctx);
 
   // for proc/.
   if(ctx->proc) ctx->proc->flush(glog, ffi);
@@ -362,13 +498,16 @@ int AutoHttpFs::flush(const char* path, struct fuse_file_info* ffi)
 int AutoHttpFs::release(const char* path, struct fuse_file_info* ffi)
 {
   AutoHttpFsContext* ctx = AUTOHTTPFSCONTEXTS.find(ffi->fh);
-  glog(Log::INFO, ">> %s(%s) ffi=%p, fh=%"FINT64"d, ctx=%p\n", __FUNCTION__, path, ffi, ffi->fh, ctx);
+  LOG(glog, Log::INFO, ">> %s(%s) ffi=%p, fh=%"FINT64"d, ctx=%p\n", __FUNCTION__, path, ffi, ffi->fh, ctx);
 
   // for proc/.
   if(ctx->proc) ctx->proc->release(glog);
 
   // for normal files.
+  ctx->readahead().cancel(glog, AUTOHTTPFSCONTEXTS.pool());
+  ContentFile* cf = ctx->content();
   AUTOHTTPFSCONTEXTS.release_context(ctx);
+  AUTOHTTPFSCONTEXTS.content().close(cf);
   return 0;
 }
 
@@ -382,6 +521,9 @@ void* AutoHttpFs::init(struct fuse_conn_info* fci)
   fci->async_read   = 1;
   fci->max_write    = 16;
   fci->max_readahead = self->m_max_readahead;
+#ifdef FUSE_CAP_SPLICE_WRITE
+  fci->want |= FUSE_CAP_SPLICE_WRITE | FUSE_CAP_SPLICE_MOVE;
+#endif
 
   AutoHttpFsContexts* ctxs = new AutoHttpFsContexts(self);
   glog(Log::NOTE, "Starting autohttpfs.\n");
@@ -394,24 +536,111 @@ void AutoHttpFs::destroy(void* user_data)
 {
   AutoHttpFsContexts* ctxs = (AutoHttpFsContexts*)user_data;
   glog(Log::NOTE, "Stopping autohttpfs.\n");
+  Capture::stop();
   delete ctxs;
 }
 
 
+// fuse operations timed and recorded into Latency, Recorder and Capture.
+int AutoHttpFs::op_getattr(const char* path, struct stat *stbuf)
+{
+  OpRecord rec(Latency::GETATTR, path);
+  return rec.done(getattr(path, stbuf));
+}
+
+
+int AutoHttpFs::op_opendir(const char* path, struct fuse_file_info *ffi)
+{
+  OpRecord rec(Latency::OPENDIR, path);
+  return rec.done(opendir(path, ffi));
+}
+
+
+int AutoHttpFs::op_readdir(const char *path, void *buf, fuse_fill_dir_t filler, off_t offset, struct fuse_file_info *ffi)
+{
+  OpRecord rec(Latency::READDIR, path, offset);
+  return rec.done(readdir(path, buf, filler, offset, ffi));
+}
+
+
+int AutoHttpFs::op_releasedir(const char* path, struct fuse_file_info *ffi)
+{
+  OpRecord rec(Latency::RELEASEDIR, path);
+  return rec.done(releasedir(path, ffi));
+}
+
+
+int AutoHttpFs::op_truncate(const char* path, off_t size)
+{
+  OpRecord rec(Latency::TRUNCATE, path, size);
+  return rec.done(truncate(path, size));
+}
+
+
+int AutoHttpFs::op_open(const char* path, struct fuse_file_info* ffi)
+{
+  OpRecord rec(Latency::OPEN, path);
+  return rec.done(open(path, ffi));
+}
+
+
+int AutoHttpFs::op_read(const char* path, char* buf, size_t size, off_t offset, struct fuse_file_info* ffi)
+{
+  OpRecord rec(Latency::READ, path, offset, size);
+  int r = read(path, buf, size, offset, ffi);
+  return rec.done(r, (r>0)? r: 0);
+}
+
+
+#if FUSE_VERSION >= 29
+int AutoHttpFs::op_read_buf(const char* path, struct fuse_bufvec** bufp, size_t size, off_t offset, struct fuse_file_info* ffi)
+{
+  OpRecord rec(Latency::READ, path, offset, size);
+  int r = read_buf(path, bufp, size, offset, ffi);
+  return rec.done(r, (r==0)? (*bufp)->buf[0].size: 0);
+}
+#endif
+
+
+int AutoHttpFs::op_write(const char* path, const char* buf, size_t size, off_t offset, struct fuse_file_info* ffi)
+{
+  OpRecord rec(Latency::WRITE, path, offset, size);
+  int r = write(path, buf, size, offset, ffi);
+  return rec.done(r, (r>0)? r: 0);
+}
+
+
+int AutoHttpFs::op_flush(const char* path, struct fuse_file_info* ffi)
+{
+  OpRecord rec(Latency::FLUSH, path);
+  return rec.done(flush(path, ffi));
+}
+
+
+int AutoHttpFs::op_release(const char* path, struct fuse_file_info* ffi)
+{
+  OpRecord rec(Latency::RELEASE, path);
+  return rec.done(release(path, ffi));
+}
+
+
 // init fuse::fuse_operations
 void AutoHttpFs::init_fuse_operations(fuse_operations& oper)
 {
   memset(&oper, 0, sizeof(oper));
-  oper.getattr    = getattr;
-  oper.opendir    = opendir;
-  oper.readdir    = readdir;
-  oper.releasedir = releasedir;
-  oper.truncate   = truncate;
-  oper.open       = open;
-  oper.read       = read;
-  oper.write      = write;
-  oper.flush      = flush;
-  oper.release    = release;
+  oper.getattr    = op_getattr;
+  oper.opendir    = op_opendir;
+  oper.readdir    = op_readdir;
+  oper.releasedir = op_releasedir;
+  oper.truncate   = op_truncate;
+  oper.open       = op_open;
+  oper.read       = op_read;
+#if FUSE_VERSION >= 29
+  oper.read_buf   = op_read_buf;
+#endif
+  oper.write      = op_write;
+  oper.flush      = op_flush;
+  oper.release    = op_release;
   oper.init       = init;
   oper.destroy    = destroy;
 }
@@ -20,6 +20,8 @@
 
 #define FUSE_USE_VERSION 26
 #include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
 #include <string.h>
 #include <errno.h>
 #include <fcntl.h>
@@ -33,6 +35,7 @@
 #include <string>
 
 
+class AutoHttpFsContext;
 class AutoHttpFs
 {
 public:
@@ -44,6 +47,14 @@ public:
   inline const struct stat* stat_d() { return &m_root_stat; };
   inline const struct stat* stat_r() { return &m_reguler_stat; };
   inline int errcode() { return m_errno; };
+  inline int workers() const { return m_workers; };
+  inline int queue_max() const { return m_queue_max; };
+  inline int meta_reserved() const { return m_meta_reserved; };
+  inline int ra_workers() const { return m_ra_workers; };
+  inline int bg_workers() const { return m_bg_workers; };
+  inline uint64_t readahead() const { return m_readahead; };
+  inline const std::string& cache_dir() const { return m_cache_dir; };
+  inline int cache_size() const { return m_cache_size; };
 
   static void init_fuse_operations(fuse_operations& oper); 
 
@@ -54,6 +65,14 @@ private:
   bool      m_file_readonly;
   bool      m_file_noexec;
   uint64_t  m_max_readahead;
+  int       m_workers;
+  int       m_queue_max;
+  int       m_meta_reserved;
+  int       m_ra_workers;
+  int       m_bg_workers;
+  uint64_t  m_readahead;
+  std::string m_cache_dir;
+  int       m_cache_size;
   static void parsearg_helper(std::string& opt, const char* key, int& argc, char** argv, int& it);
   static void parsearg_helper(int& opt, const char* key, int& argc, char** argv, int& it);
   static void parsearg_helper(bool& opt, const char* key, int& argc, char** argv, int& it);
@@ -67,11 +86,30 @@ private:
   static int truncate(const char* path, off_t size);
   static int open(const char* path, struct fuse_file_info* ffi);
   static int read(const char* path, char* buf, size_t size, off_t offset, struct fuse_file_info* ffi);
+#if FUSE_VERSION >= 29
+  static int read_buf(const char* path, struct fuse_bufvec** bufp, size_t size, off_t offset, struct fuse_file_info* ffi);
+#endif
   static int write(const char* path, const char* buf, size_t size, off_t offset, struct fuse_file_info* ffi);
   static int flush(const char* path, struct fuse_file_info* ffi);
   static int release(const char* path, struct fuse_file_info* ffi);
   static void* init(struct fuse_conn_info* fci);
   static void destroy(void* user_data);
+  static int load(AutoHttpFsContext* ctx, const char* path, uint64_t length, size_t size, off_t offset);
+
+private:
+  static int op_getattr(const char* path, struct stat *stbuf);
+  static int op_opendir(const char* path, struct fuse_file_info *ffi);
+  static int op_readdir(const char *path, void *buf, fuse_fill_dir_t filler, off_t offset, struct fuse_file_info *ffi);
+  static int op_releasedir(const char* path, struct fuse_file_info *ffi);
+  static int op_truncate(const char* path, off_t size);
+  static int op_open(const char* path, struct fuse_file_info* ffi);
+  static int op_read(const char* path, char* buf, size_t size, off_t offset, struct fuse_file_info* ffi);
+#if FUSE_VERSION >= 29
+  static int op_read_buf(const char* path, struct fuse_bufvec** bufp, size_t size, off_t offset, struct fuse_file_info* ffi);
+#endif
+  static int op_write(const char* path, const char* buf, size_t size, off_t offset, struct fuse_file_info* ffi);
+  static int op_flush(const char* path, struct fuse_file_info* ffi);
+  static int op_release(const char* path, struct fuse_file_info* ffi);
 };
 
 
@@ -17,9 +17,14 @@
 
 #include <signal.h>
 #include "cache.h"
+#include "probes.h"
 #include "int64format.h"
 
 
+time_t UrlStat::s_now = 0;
+
+
+
 // UrlStatMap class implements.
 bool UrlStatMap::insert(const char* path, const UrlStat& us)
 {
@@ -28,9 +33,12 @@ bool UrlStatMap::insert(const char* path, const UrlStat& us)
   if(r.second) {
     // inserted.
     m_entries.push_back(r.first);
+    m_bytes += entry_bytes(key);
+    m_inserts++;
   } else {
     // already inserted. => update stat.
     (*r.first).second = us;
+    m_updates++;
   }
   return r.second;
 }
@@ -49,6 +57,7 @@ void UrlStatMap::remove(const char* path)
   iterator it = find(path);
   if(it!=end()) {
     (*it).second.expire = 0; // force expired.
+    m_invalidated++;
   }
 }
 
@@ -57,6 +66,14 @@ void UrlStatMap::trim(size_t count)
   for(; count>0; count--) {
     if(m_entries.size()==0) break;
     iterator it = m_entries.front();
+    bool expired = !(*it).second.is_valid();
+    PROBE2(cache__evict, (*it).first.c_str(), expired);
+    if(expired) {
+      m_evicted_expired++;
+    } else {
+      m_evicted_capacity++;
+    }
+    m_bytes -= entry_bytes((*it).first);
     UrlStatBASE::erase(it);
     m_entries.pop_front();
   }
@@ -75,22 +92,46 @@ void UrlStatMap::dump(Log& logger)
 }
 
 
+void UrlStatMap::stats(UrlStatCacheStats& st)
+{
+  st.inserts = m_inserts;
+  st.updates = m_updates;
+  st.invalidated = m_invalidated;
+  st.evicted_expired = m_evicted_expired;
+  st.evicted_capacity = m_evicted_capacity;
+  st.entries = size();
+  st.bytes = m_bytes;
+  st.live_dirs = st.live_files = 0;
+  for(iterator it=begin(); it!=end(); it++) {
+    if(!(*it).second.is_valid()) continue;
+    if((*it).second.is_dir()) {
+      st.live_dirs++;
+    } else {
+      st.live_files++;
+    }
+  }
+}
+
+
 
 // UrlStatCache class implements.
-void UrlStatCache::init()
+void UrlStatCache::init(bool cleaner)
 {
   pthread_mutexattr_t attr;
   pthread_mutexattr_init(&attr);
   pthread_mutex_init(&m_lock, &attr);
 
   m_stop_cleaner = false;
+  m_has_cleaner = cleaner;
+  if(!cleaner) return;
   signal(SIGUSR2, alarm_handler);
-  pthread_create(&m_cleaner, NULL, cleaner, (void*)this);
+  pthread_create(&m_cleaner, NULL, UrlStatCache::cleaner, (void*)this);
 }
 
 
 void UrlStatCache::stop()
 {
+  if(!m_has_cleaner) return;
   void* ret;
   m_stop_cleaner = true;
   pthread_kill(m_cleaner, SIGUSR2);
@@ -100,7 +141,7 @@ void UrlStatCache::stop()
 
 void UrlStatCache::add(const char* path, const UrlStat& stat)
 {
-  time_t expire = time(NULL) + m_expire_sec;
+  time_t expire = UrlStat::now() + m_expire_sec;
   bool over_capacity = false;
 
   pthread_mutex_lock(&m_lock);
@@ -113,7 +154,7 @@ void UrlStatCache::add(const char* path, const UrlStat& stat)
   }
   pthread_mutex_unlock(&m_lock);
 
-  if(over_capacity) pthread_kill(m_cleaner, SIGUSR2);
+  if(over_capacity && m_has_cleaner) pthread_kill(m_cleaner, SIGUSR2);
 }
 
 
@@ -130,17 +171,28 @@ void UrlStatCache::remove(const char* path)
 bool UrlStatCache::find(const char* path, UrlStat& stat)
 {
   bool result = false;
+  bool expired = false;
 
+  m_mrc.access(path);
   pthread_mutex_lock(&m_lock);
   {
-    UrlStatMap::iterator it = m_stats.find_with_expire(path);
-    if(it!=m_stats.end()) {
+    UrlStatMap::iterator it = m_stats.find(path);
+    if(it==m_stats.end()) {
+      m_misses++;
+    } else if(!(*it).second.is_valid()) {
+      m_misses++;
+      m_expired++;
+      expired = true;
+    } else {
+      // extend the expiration.
+      (*it).second.expire = UrlStat::now() + m_expire_sec;
       stat = (*it).second;
+      m_hits++;
       result = true;
     }
   }
   pthread_mutex_unlock(&m_lock);
-  if(result) add(path, stat.mode, stat.length);
+  PROBE3(cache__lookup, path, result, expired);
 
   return result;
 }
@@ -174,6 +226,21 @@ void UrlStatCache::dump(Log& logger)
 }
 
 
+UrlStatCacheStats UrlStatCache::stats()
+{
+  UrlStatCacheStats st;
+  pthread_mutex_lock(&m_lock);
+  {
+    m_stats.stats(st);
+    st.hits = m_hits;
+    st.misses = m_misses;
+    st.expired = m_expired;
+  }
+  pthread_mutex_unlock(&m_lock);
+  return st;
+}
+
+
 void* UrlStatCache::cleaner(void* ctx)
 {
   UrlStatCache* self = (UrlStatCache*)ctx;
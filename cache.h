@@ -27,6 +27,7 @@
 #include <map>
 #include <list>
 #include "log.h"
+#include "mrc.h"
 
 #ifndef CACHE_EXPIRES_SEC
 # define CACHE_EXPIRES_SEC (180) // sec
@@ -47,7 +48,10 @@ public:
     expire = e;
   };
   inline virtual ~UrlStat() {};
-  inline bool is_valid() const { return (expire>=time(NULL))? true: false; };
+  inline bool is_valid() const { return (expire>=now())? true: false; };
+  // the wall clock, or the clock of a simulation (test/cache_sim).
+  inline static time_t now() { return s_now? s_now: time(NULL); };
+  inline static void now(time_t t) { s_now = t; };
   inline bool is_dir() const { return !!(mode & S_IFDIR); }
   inline bool is_reg() const { return !!(mode & S_IFREG); }
 
@@ -56,6 +60,9 @@ public:
   uint64_t  length;
   time_t    mtime;
   time_t    expire;
+
+private:
+  static time_t s_now;  // 0: the wall clock.
 };
 
 
@@ -71,18 +78,54 @@ public:
 };
 
 
+// Counters of UrlStatCache.
+class UrlStatCacheStats
+{
+public:
+  inline UrlStatCacheStats() {
+    hits = misses = expired = inserts = updates = invalidated = 0;
+    evicted_expired = evicted_capacity = 0;
+    entries = live_dirs = live_files = bytes = 0;
+  };
+  uint64_t  hits;
+  uint64_t  misses;           // includes 'expired'.
+  uint64_t  expired;          // found but expired.
+  uint64_t  inserts;
+  uint64_t  updates;
+  uint64_t  invalidated;      // by remove().
+  uint64_t  evicted_expired;  // trimmed after expired.
+  uint64_t  evicted_capacity; // trimmed before expired.
+  uint64_t  entries;          // includes expired ones.
+  uint64_t  live_dirs;
+  uint64_t  live_files;
+  uint64_t  bytes;            // estimated memory of entries.
+};
+
+
 typedef std::map<Url, UrlStat> UrlStatBASE;
 class UrlStatMap: public UrlStatBASE
 {
 public:
+  inline UrlStatMap() { m_bytes = m_inserts = m_updates = m_invalidated = m_evicted_expired = m_evicted_capacity = 0; };
   bool insert(const char* path, const UrlStat& us);
   iterator find_with_expire(const char* path);
   void remove(const char* path);
   void trim(size_t count);
   void dump(Log& logger);
+  void stats(UrlStatCacheStats& st);
+  inline static uint64_t entry_bytes(const Url& key) {
+    // key and value, and nodes of std::map and std::list.
+    return sizeof(UrlStatBASE::value_type) + key.size() + 1 + 4*sizeof(void*) + 3*sizeof(void*);
+  };
 
 private:
   std::list<iterator> m_entries;
+  uint64_t  m_bytes;
+  uint64_t  m_inserts;
+  uint64_t  m_updates;
+  uint64_t  m_invalidated;
+  uint64_t  m_evicted_expired;
+  uint64_t  m_evicted_capacity;
 };
 
 
@@ -92,12 +135,13 @@ public:
   inline UrlStatCache() {
     m_expire_sec = CACHE_EXPIRES_SEC;
     m_max_entries = CACHE_MAX_ENTRIES;
+    m_hits = m_misses = m_expired = 0;
   };
   inline virtual ~UrlStatCache() {
     try { m_stats.clear(); }
     catch(...){}
   };
-  void init();
+  void init(bool cleaner = true); // without cleaner, the owner calls trim().
   void stop();
   void add(const char* path, const UrlStat& stat);
   inline void add(const char* path, mode_t mode, uint64_t length) {
@@ -115,15 +159,22 @@ public:
   inline void max_entries(uint64_t v) { m_max_entries = v; };
   void trim();
   void dump(Log& logger);
+  UrlStatCacheStats stats();
+  inline MissRatioCurve& mrc() { return m_mrc; };
 
 private:
   pthread_mutex_t m_lock;
   UrlStatMap m_stats;
+  uint64_t  m_hits;     // guarded by m_lock as m_stats.
+  uint64_t  m_misses;
+  uint64_t  m_expired;
+  MissRatioCurve m_mrc; // of find().
   time_t  m_expire_sec;
   size_t  m_max_entries;
   static void* cleaner(void*);
   static void alarm_handler(int);
   pthread_t m_cleaner;
+  bool m_has_cleaner;
   bool m_stop_cleaner;
 };
 
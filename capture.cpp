@@ -0,0 +1,182 @@
+/*
+  Copyright 2010 Toshiyuki Terashita.
+
+  fuse-autohttpfs is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This software is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <errno.h>
+#include <string.h>
+#include <sys/time.h>
+#include "capture.h"
+#include "int64format.h"
+
+
+static inline uint64_t now_usec()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1000000ULL + tv.tv_usec;
+}
+
+
+// Capture class implements.
+pthread_mutex_t Capture::s_lock = PTHREAD_MUTEX_INITIALIZER;
+volatile bool Capture::s_enabled = false;
+FILE* Capture::s_fp = NULL;
+std::string Capture::s_file;
+bool Capture::s_hashed = false;
+uint64_t Capture::s_last = 0;
+uint64_t Capture::s_records = 0;
+uint64_t Capture::s_bytes = 0;
+std::map<uint64_t, uint32_t> Capture::s_paths;
+char Capture::s_buffer[CAPTURE_BUFFER];
+size_t Capture::s_used = 0;
+
+
+// FNV-1a, mixed.
+uint64_t Capture::hash(const char* path)
+{
+  uint64_t h = 0xcbf29ce484222325ULL;
+  for(; *path; path++) {
+    h ^= (unsigned char)*path;
+    h *= 0x100000001b3ULL;
+  }
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  return h;
+}
+
+
+// starts a new capture into 'file', stopping the current one.
+int Capture::start(const char* file, bool hashed)
+{
+  stop();
+  FILE* fp = fopen(file, "wb");
+  if(fp==NULL) return -errno;
+
+  pthread_mutex_lock(&s_lock);
+  {
+    s_fp = fp;
+    s_file = file;
+    s_hashed = hashed;
+    s_last = now_usec();
+    s_records = s_bytes = 0;
+    s_paths.clear();
+    s_used = 0;
+
+    CaptureHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, CAPTURE_MAGIC, sizeof(h.magic));
+    h.version = CAPTURE_VERSION;
+    h.flags = hashed? CAPTURE_HASHED: 0;
+    h.start = s_last;
+    append(&h, sizeof(h));
+    s_enabled = true;
+  }
+  pthread_mutex_unlock(&s_lock);
+  return 0;
+}
+
+
+void Capture::stop()
+{
+  pthread_mutex_lock(&s_lock);
+  {
+    if(s_fp) {
+      s_enabled = false;
+      flush();
+      fclose(s_fp);
+      s_fp = NULL;
+      s_paths.clear();
+    }
+  }
+  pthread_mutex_unlock(&s_lock);
+}
+
+
+void Capture::record(int op, const char* path, uint64_t offset, uint64_t size,
+                     int result, uint64_t nsec, bool miss)
+{
+  uint64_t h = hash(path);
+  pthread_mutex_lock(&s_lock);
+  {
+    if(s_fp) {
+      uint64_t now = now_usec();
+      CaptureRecord r;
+      memset(&r, 0, sizeof(r));
+
+      std::map<uint64_t, uint32_t>::iterator it = s_paths.find(h);
+      if(it==s_paths.end()) {
+        it = s_paths.insert(std::make_pair(h, (uint32_t)s_paths.size()+1)).first;
+        r.op = CAPTURE_PATH;
+        r.path = (*it).second;
+        r.size = s_hashed? sizeof(h): strlen(path);
+        append(&r, sizeof(r));
+        if(s_hashed) append(&h, sizeof(h));
+        else         append(path, r.size);
+      }
+
+      r.usec = (now>s_last)? (uint32_t)(now - s_last): 0;
+      r.op = op;
+      r.flags = miss? CAPTURE_MISS: 0;
+      r.path = (*it).second;
+      r.result = result;
+      r.offset = offset;
+      r.size = (size>0xffffffffULL)? 0xffffffffU: (uint32_t)size;
+      r.duration = (nsec/1000>0xffffffffULL)? 0xffffffffU: (uint32_t)(nsec/1000);
+      append(&r, sizeof(r));
+      s_last = now;
+      s_records++;
+    }
+  }
+  pthread_mutex_unlock(&s_lock);
+}
+
+
+std::string Capture::status()
+{
+  char t[512];
+  pthread_mutex_lock(&s_lock);
+  {
+    if(s_fp) {
+      snprintf(t, sizeof(t), "%s%s records=%"FINT64"u paths=%"FSIZET"u bytes=%"FINT64"u\n",
+               s_hashed? "hash:": "", s_file.c_str(), s_records, s_paths.size(), s_bytes + s_used);
+    } else {
+      snprintf(t, sizeof(t), "0\n");
+    }
+  }
+  pthread_mutex_unlock(&s_lock);
+  return t;
+}
+
+
+// with s_lock.
+void Capture::append(const void* data, size_t size)
+{
+  if(s_used+size>sizeof(s_buffer)) flush();
+  memcpy(s_buffer+s_used, data, size);
+  s_used += size;
+}
+
+
+// with s_lock.
+void Capture::flush()
+{
+  if(s_used>0) fwrite(s_buffer, 1, s_used, s_fp);
+  s_bytes += s_used;
+  s_used = 0;
+}
+
+// vim: sw=2 sts=2 ts=4 expandtab :
@@ -0,0 +1,94 @@
+/*
+  Copyright 2010 Toshiyuki Terashita.
+
+  fuse-autohttpfs is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This software is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __INCLUDE_CAPTURE_H__
+#define __INCLUDE_CAPTURE_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <string>
+#include <map>
+
+#define CAPTURE_MAGIC     "AHFSCAP1"
+#define CAPTURE_VERSION   (1)
+#define CAPTURE_HASHED    (1)       // CaptureHeader::flags: paths are 64bit hashes.
+#define CAPTURE_PATH      (0xff)    // CaptureRecord::op of a path definition.
+#define CAPTURE_MISS      (1)       // CaptureRecord::flags: an HTTP request was made.
+#ifndef CAPTURE_BUFFER
+# define CAPTURE_BUFFER   (64*1024)
+#endif
+
+
+// Capture file: a header and records, little endian.
+// The first record of a path is a CAPTURE_PATH record of 'size' bytes of the
+// path (or 8 bytes of its hash), followed by the path. Later records refer to
+// the path by its id.
+struct CaptureHeader
+{
+  char      magic[8];
+  uint32_t  version;
+  uint32_t  flags;
+  uint64_t  start;      // wall clock, usec.
+} __attribute__((packed));
+
+struct CaptureRecord
+{
+  uint32_t  usec;       // since the previous record.
+  uint8_t   op;         // Latency::OP, or CAPTURE_PATH.
+  uint8_t   flags;
+  uint16_t  reserved;
+  uint32_t  path;       // id, from 1.
+  int32_t   result;
+  uint64_t  offset;     // of read/write, size of truncate.
+  uint32_t  size;       // requested bytes, or length of the path.
+  uint32_t  duration;   // usec.
+} __attribute__((packed));
+
+
+// Records fuse operations into a capture file, for test/replay.
+// Records are buffered and written by the operation that fills the buffer.
+class Capture
+{
+public:
+  static int start(const char* file, bool hashed);
+  static void stop();
+  inline static bool enabled() { return s_enabled; };
+  static void record(int op, const char* path, uint64_t offset, uint64_t size,
+                     int result, uint64_t nsec, bool miss);
+  static std::string status();
+  static uint64_t hash(const char* path);
+
+private:
+  static pthread_mutex_t s_lock;
+  static volatile bool s_enabled;
+  static FILE*    s_fp;
+  static std::string s_file;
+  static bool     s_hashed;
+  static uint64_t s_last;       // usec of the last record.
+  static uint64_t s_records;
+  static uint64_t s_bytes;
+  static std::map<uint64_t, uint32_t> s_paths;
+  static char     s_buffer[CAPTURE_BUFFER];
+  static size_t   s_used;
+  static void append(const void* data, size_t size);
+  static void flush();
+};
+
+
+#endif // __INCLUDE_CAPTURE_H__
+// vim: sw=2 sts=2 ts=4 expandtab :
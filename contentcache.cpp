@@ -0,0 +1,261 @@
+/*
+  Copyright 2010 Toshiyuki Terashita.
+
+  fuse-autohttpfs is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This software is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include "contentcache.h"
+#include "curlaccessor.h"
+#include "int64format.h"
+
+
+// ContentFile class implements.
+ContentFile::ContentFile(int fd, const char* path, uint64_t length, time_t mtime)
+{
+  pthread_mutex_init(&m_lock, NULL);
+  m_fd = fd;
+  m_path = path;
+  m_length = length;
+  m_mtime = mtime;
+  m_blocks.resize((length + CONTENTCACHE_BLOCK - 1) / CONTENTCACHE_BLOCK, false);
+  m_cached = 0;
+  m_refs = 0;
+  m_used = 0;
+  m_stale = false;
+}
+
+
+ContentFile::~ContentFile()
+{
+  ::close(m_fd);
+  pthread_mutex_destroy(&m_lock);
+}
+
+
+bool ContentFile::has(uint64_t offset, uint64_t size)
+{
+  if(size==0) return true;
+  if(offset+size>m_length) return false;
+
+  bool result = true;
+  pthread_mutex_lock(&m_lock);
+  {
+    uint64_t last = (offset + size - 1) / CONTENTCACHE_BLOCK;
+    for(uint64_t b=offset/CONTENTCACHE_BLOCK; b<=last; b++) {
+      if(!m_blocks[b]) {
+        result = false;
+        break;
+      }
+    }
+  }
+  pthread_mutex_unlock(&m_lock);
+  return result;
+}
+
+
+// download blocks covering [offset, offset+size) into the file.
+// Returns 0, -EIO if the body is shorter than asked, -ENOENT if the request failed or -EINTR.
+int ContentFile::fetch(Log& logger, uint64_t offset, uint64_t size, volatile bool* abort)
+{
+  uint64_t from = offset - (offset % CONTENTCACHE_BLOCK);
+  uint64_t to = ((offset + size + CONTENTCACHE_BLOCK - 1) / CONTENTCACHE_BLOCK) * CONTENTCACHE_BLOCK;
+  if(to>m_length) to = m_length;
+  if(from>=to) return 0;
+
+  CurlAccessor ca(m_path.c_str());
+  if(abort) ca.abort_on(abort);
+  int r = ca.get(logger, m_fd, from, to-from);
+  // 200 is the whole body: usable only from the top.
+  // a short body (the file has shrunk, or a short Content-Range) leaves the rest uncached.
+  if((r==206) || ((r==200) && (from==0))) {
+    mark(from, ca.read_size());
+    return (ca.read_size()<to-from)? -EIO: 0;
+  }
+  if(ca.aborted()) return -EINTR;
+  return -ENOENT;
+}
+
+
+// Caller must not hold m_lock.
+void ContentFile::mark(uint64_t offset, uint64_t size)
+{
+  uint64_t end = offset + size;
+  pthread_mutex_lock(&m_lock);
+  {
+    for(uint64_t b=offset/CONTENTCACHE_BLOCK; b<m_blocks.size(); b++) {
+      uint64_t bend = (b + 1) * CONTENTCACHE_BLOCK;
+      if(bend>m_length) bend = m_length;
+      if(bend>end) break;
+      if(b*CONTENTCACHE_BLOCK<offset) continue;
+      if(!m_blocks[b]) {
+        m_blocks[b] = true;
+        m_cached++;
+      }
+    }
+  }
+  pthread_mutex_unlock(&m_lock);
+}
+
+
+
+// ContentCache class implements.
+ContentCache::ContentCache()
+{
+  pthread_mutex_init(&m_lock, NULL);
+  m_max_bytes = 0;
+  m_tick = 0;
+}
+
+
+ContentCache::~ContentCache()
+{
+  ContentFileMap::iterator it;
+  for(it=m_files.begin(); it!=m_files.end(); it++) {
+    delete (*it).second;
+  }
+  m_files.clear();
+  pthread_mutex_destroy(&m_lock);
+}
+
+
+void ContentCache::init(const std::string& dir, uint64_t max_bytes)
+{
+  m_dir = dir;
+  m_max_bytes = max_bytes;
+}
+
+
+// Returns NULL if disabled or failed to create a file.
+ContentFile* ContentCache::open(Log& logger, const char* path, uint64_t length, time_t mtime)
+{
+  if(!enabled()) return NULL;
+
+  ContentFile* cf = NULL;
+  pthread_mutex_lock(&m_lock);
+  {
+    ContentFileMap::iterator it = m_files.find(path);
+    if(it!=m_files.end()) {
+      cf = (*it).second;
+      if((cf->length()!=length) || (cf->mtime()!=mtime)) {
+        // modified: detach the old one.
+        m_files.erase(it);
+        if(cf->m_refs==0) {
+          delete cf;
+        } else {
+          cf->m_stale = true;
+        }
+        cf = NULL;
+      }
+    }
+    if(cf==NULL) {
+      std::string t = m_dir + "/autohttpfs.XXXXXX";
+      std::vector<char> tmpl(t.begin(), t.end());
+      tmpl.push_back(0);
+      int fd = mkstemp(&tmpl[0]);
+      if(fd>=0) {
+        unlink(&tmpl[0]);
+        cf = new ContentFile(fd, path, length, mtime);
+        m_files.insert(ContentFileMap::value_type(path, cf));
+      } else {
+        logger(Log::WARN, "ContentCache::open(%s): mkstemp(%s) failed - %s\n", path, &tmpl[0], strerror(errno));
+      }
+    }
+    if(cf) {
+      cf->m_refs++;
+      cf->m_used = ++m_tick;
+    }
+  }
+  pthread_mutex_unlock(&m_lock);
+
+  trim();
+  return cf;
+}
+
+
+void ContentCache::close(ContentFile* cf)
+{
+  if(cf==NULL) return;
+
+  pthread_mutex_lock(&m_lock);
+  {
+    cf->m_refs--;
+    cf->m_used = ++m_tick;
+    if(cf->m_stale && (cf->m_refs==0)) delete cf;
+  }
+  pthread_mutex_unlock(&m_lock);
+
+  trim();
+}
+
+
+// evict least recently used files not opened.
+void ContentCache::trim()
+{
+  pthread_mutex_lock(&m_lock);
+  for(;;) {
+    uint64_t total = 0;
+    ContentFileMap::iterator it, victim = m_files.end();
+    for(it=m_files.begin(); it!=m_files.end(); it++) {
+      ContentFile* cf = (*it).second;
+      total += cf->bytes();
+      if(cf->m_refs>0) continue;
+      if((victim==m_files.end()) || (cf->m_used<(*victim).second->m_used)) victim = it;
+    }
+    if((total<=m_max_bytes) || (victim==m_files.end())) break;
+    delete (*victim).second;
+    m_files.erase(victim);
+  }
+  pthread_mutex_unlock(&m_lock);
+}
+
+
+uint64_t ContentCache::bytes()
+{
+  uint64_t total = 0;
+  pthread_mutex_lock(&m_lock);
+  {
+    ContentFileMap::iterator it;
+    for(it=m_files.begin(); it!=m_files.end(); it++) total += (*it).second->bytes();
+  }
+  pthread_mutex_unlock(&m_lock);
+  return total;
+}
+
+
+uint64_t ContentCache::files()
+{
+  uint64_t n;
+  pthread_mutex_lock(&m_lock);
+  {
+    n = m_files.size();
+  }
+  pthread_mutex_unlock(&m_lock);
+  return n;
+}
+
+
+// feed blocks of [offset, offset+size) of 'path' to the miss ratio curve.
+void ContentCache::access(const char* path, uint64_t offset, uint64_t size)
+{
+  if(size==0) return;
+  uint64_t h = MissRatioCurve::hash(path);
+  uint64_t last = (offset + size - 1) / CONTENTCACHE_BLOCK;
+  for(uint64_t b=offset/CONTENTCACHE_BLOCK; b<=last; b++) m_mrc.access(MissRatioCurve::mix(h + b));
+}
+
+// vim: sw=2 sts=2 ts=4 expandtab :
@@ -0,0 +1,96 @@
+/*
+  Copyright 2010 Toshiyuki Terashita.
+
+  fuse-autohttpfs is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This software is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __INCLUDE_CONTENTCACHE_H__
+#define __INCLUDE_CONTENTCACHE_H__
+
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <string>
+#include <vector>
+#include <map>
+#include "log.h"
+#include "mrc.h"
+
+#ifndef CONTENTCACHE_BLOCK
+# define CONTENTCACHE_BLOCK (0x20000)
+#endif
+
+#ifndef CONTENTCACHE_SIZE_MB
+# define CONTENTCACHE_SIZE_MB (256)
+#endif
+
+
+// Body of a remote file, cached in an unlinked sparse file per CONTENTCACHE_BLOCK.
+class ContentFile
+{
+public:
+  ContentFile(int fd, const char* path, uint64_t length, time_t mtime);
+  virtual ~ContentFile();
+  inline int fd() const { return m_fd; };
+  inline uint64_t length() const { return m_length; };
+  inline time_t mtime() const { return m_mtime; };
+  inline uint64_t bytes() const { return m_cached * CONTENTCACHE_BLOCK; };
+  bool has(uint64_t offset, uint64_t size);
+  int fetch(Log& logger, uint64_t offset, uint64_t size, volatile bool* abort = NULL);
+  void mark(uint64_t offset, uint64_t size);  // blocks in [offset, offset+size) are cached.
+
+private:
+  friend class ContentCache;
+  pthread_mutex_t m_lock;
+  int       m_fd;
+  std::string m_path;
+  uint64_t  m_length;
+  time_t    m_mtime;
+  std::vector<bool> m_blocks;
+  uint64_t  m_cached;   // number of cached blocks.
+  int       m_refs;     // guarded by ContentCache.
+  uint64_t  m_used;     // guarded by ContentCache.
+  bool      m_stale;    // guarded by ContentCache.
+};
+typedef std::map<std::string, ContentFile*> ContentFileMap;
+
+
+class ContentCache
+{
+public:
+  ContentCache();
+  virtual ~ContentCache();
+  void init(const std::string& dir, uint64_t max_bytes);
+  inline bool enabled() const { return m_max_bytes>0; };
+  ContentFile* open(Log& logger, const char* path, uint64_t length, time_t mtime);
+  void close(ContentFile* cf);
+  void trim();
+  inline uint64_t max_bytes() const { return m_max_bytes; };
+  uint64_t bytes();
+  uint64_t files();
+  void access(const char* path, uint64_t offset, uint64_t size);
+  inline MissRatioCurve& mrc() { return m_mrc; };
+
+private:
+  pthread_mutex_t m_lock;
+  std::string m_dir;
+  uint64_t  m_max_bytes;
+  uint64_t  m_tick;
+  ContentFileMap m_files;
+  MissRatioCurve m_mrc; // of blocks read, whether cached or not.
+};
+
+
+#endif // __INCLUDE_CONTENTCACHE_H__
+// vim: sw=2 sts=2 ts=4 expandtab :
@@ -16,7 +16,9 @@
 */
 
 #include <signal.h>
+#include "autohttpfs.h"
 #include "context.h"
+#include "curlaccessor.h"
 #include "int64format.h"
 
 
@@ -25,6 +27,7 @@ AutoHttpFsContext::AutoHttpFsContext(uint64_t seq, RemoteAttr& attr)
 {
   m_seq = seq;
   m_attr = &attr;
+  m_content = NULL;
   proc = NULL;
 }
 
@@ -47,11 +50,23 @@ AutoHttpFsContexts::AutoHttpFsContexts(AutoHttpFs* fs)
   m_contexts.clear();
   m_proc.init();
   sequence = 1;
+
+  Log::start();
+  m_pool.start(fs->workers(), fs->queue_max(), fs->meta_reserved());
+  if(fs->ra_workers()>0) m_pool.limit(WorkerPool::READAHEAD, fs->ra_workers());
+  if(fs->bg_workers()>0) m_pool.limit(WorkerPool::BACKGROUND, fs->bg_workers());
+  CurlAccessor::pool(&m_pool);
+  WorkerPool::interrupted(fuse_interrupted);
+  m_content.init(fs->cache_dir(), fs->cache_size() * 1024 * 1024);
 }
 
 
 AutoHttpFsContexts::~AutoHttpFsContexts()
 {
+  CurlAccessor::pool(NULL);
+  WorkerPool::interrupted(NULL);
+  m_pool.stop();
+  Log::stop();
 }
 
 
@@ -25,6 +25,10 @@
 #include <fuse/fuse.h>
 #include "remoteattr.h"
 #include "procmap.h"
+#include "workerpool.h"
+#include "readahead.h"
+#include "readdir.h"
+#include "contentcache.h"
 
 
 class AutoHttpFs;
@@ -38,6 +42,10 @@ public:
     return m_attr->get_attr(logger, path, stat);
   };
   inline RemoteAttr& attr() { return *m_attr; };
+  inline ReadAhead& readahead() { return m_readahead; };
+  inline ReadDir& readdir() { return m_readdir; };
+  inline ContentFile* content() const { return m_content; };
+  inline void content(ContentFile* cf) { m_content = cf; };
 
 public:
   ProcAbstract* proc;
@@ -45,6 +53,9 @@ public:
 private:
   uint64_t m_seq;
   RemoteAttr* m_attr;
+  ReadAhead m_readahead;
+  ReadDir m_readdir;
+  ContentFile* m_content;
 };
 typedef std::map<uint64_t, AutoHttpFsContext*> AutoHttpFsContextMap;
 
@@ -59,6 +70,8 @@ public:
     return (AutoHttpFsContexts*)(fc->private_data);
   };
   inline RemoteAttr& remote_attr() { return m_attr; };
+  inline WorkerPool& pool() { return m_pool; };
+  inline ContentCache& content() { return m_content; };
   AutoHttpFsContext* alloc_context();
   void	release_context(AutoHttpFsContext* ctx);
   AutoHttpFsContext* find(uint64_t seq);
@@ -88,6 +101,8 @@ private:
   int64_t   active_fds;
   RemoteAttr m_attr;
   AutoHttpFsProc m_proc;
+  WorkerPool m_pool;
+  ContentCache m_content;
 };
 #define	AUTOHTTPFSCONTEXTS	(*AutoHttpFsContexts::ctxs())
 
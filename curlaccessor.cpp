@@ -15,7 +15,14 @@
   along with this software.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <unistd.h>
+#include <errno.h>
 #include "curlaccessor.h"
+#include "latency.h"
+#include "recorder.h"
+#include "trace.h"
+#include "probes.h"
+#include "hoststats.h"
 #include "version.h"
 #include "log.h"
 #include "int64format.h"
@@ -44,7 +51,22 @@ void CurlSlist::add(const char* string)
 
 
 
+// Transfer delegated to WorkerPool.
+class CurlPerformJob: public WorkerJob
+{
+public:
+  inline CurlPerformJob(CURL* c): curl(c), code(CURLE_OK) {};
+  inline virtual void run() { code = curl_easy_perform(curl); };
+  CURL* curl;
+  CURLcode code;
+};
+
+
+
 // CurlAccessor class implements.
+WorkerPool* CurlAccessor::s_pool = NULL;
+
+
 CurlAccessor::CurlAccessor(const char* path, bool dir_access, bool follow_location)
 {
   m_url = (path[0]!='/')? path: path+1;
@@ -56,7 +78,15 @@ CurlAccessor::CurlAccessor(const char* path, bool dir_access, bool follow_locati
   m_buffer = NULL;
   m_buffer_size = 0;
   m_read_size = 0;
+  m_fd = -1;
+  m_fd_offset = 0;
+  m_body = NULL;
+  m_stream = NULL;
   m_content_length = (uint64_t)-1;
+  m_priority = WorkerPool::FOREGROUND;
+  m_cancel = false;
+  m_abort = NULL;
+  m_curl_code = CURLE_OK;
 
   curl = curl_easy_init();
   curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1);
@@ -65,6 +95,9 @@ CurlAccessor::CurlAccessor(const char* path, bool dir_access, bool follow_locati
   curl_easy_setopt(curl, CURLOPT_WRITEHEADER, this);
   curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, header_callback);
   curl_easy_setopt(curl, CURLOPT_USERAGENT, m_user_agent.c_str());
+  curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0);
+  curl_easy_setopt(curl, CURLOPT_XFERINFODATA, this);
+  curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, xferinfo_callback);
 }
 
 
@@ -88,9 +121,9 @@ int CurlAccessor::head(Log& logger)
 {
   curl_easy_setopt(curl, CURLOPT_NOBODY, 1);
   curl_easy_setopt(curl, CURLOPT_HTTPHEADER, m_headers.slist());
-  m_curl_code = curl_easy_perform(curl);
+  m_curl_code = perform(WorkerPool::META, "HEAD");
 
-  logger(Log::VERBOSE, "   [CurlAccessor::head(%s)] => %d\n", m_url.c_str(), m_res_status);
+  LOG(logger, Log::VERBOSE, "   [CurlAccessor::head(%s)] => %d\n", m_url.c_str(), m_res_status);
   if(m_curl_code!=CURLE_OK) log_request_failed(logger, __FUNCTION__);
 
   return m_res_status;
@@ -111,9 +144,9 @@ int CurlAccessor::get(Log& logger, void* buf, uint64_t offset, uint64_t size)
   curl_easy_setopt(curl, CURLOPT_RANGE, range);
   curl_easy_setopt(curl, CURLOPT_WRITEDATA, this);
   curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
-  m_curl_code = curl_easy_perform(curl);
+  m_curl_code = perform(WorkerPool::DATA, "GET");
 
-  logger(Log::VERBOSE, "   [CurlAccessor::get(%s)] offset=%"FINT64"u, size=%"FINT64"u, Range: %s => %d\n", \
+  LOG(logger, Log::VERBOSE, "   [CurlAccessor::get(%s)] offset=%"FINT64"u, size=%"FINT64"u, Range: %s => %d\n", \
                          m_url.c_str(), offset, size, range, m_res_status);
   if(m_curl_code==CURLE_PARTIAL_FILE) {
     logger(Log::WARN, "    [CurlAccessor::get(%s)] failed / size=%"FINT64"u, offset=%"FINT64"u, Range: %s\n", m_url.c_str(), size, offset, range);
@@ -127,13 +160,14 @@ int CurlAccessor::get(Log& logger, void* buf, uint64_t offset, uint64_t size)
 int CurlAccessor::get(Log& logger, std::string& body)
 {
   m_body = &body;
+  m_stream = NULL;
   curl_easy_setopt(curl, CURLOPT_HTTPGET, 1);
   curl_easy_setopt(curl, CURLOPT_HTTPHEADER, m_headers.slist());
   curl_easy_setopt(curl, CURLOPT_WRITEDATA, this);
   curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback_string);
-  m_curl_code = curl_easy_perform(curl);
+  m_curl_code = perform(WorkerPool::META, "GET");
 
-  logger(Log::VERBOSE, "   [CurlAccessor::get(%s)] %d\n", m_url.c_str(), m_res_status);
+  LOG(logger, Log::VERBOSE, "   [CurlAccessor::get(%s)] %d\n", m_url.c_str(), m_res_status);
   if(m_curl_code==CURLE_PARTIAL_FILE) {
     logger(Log::WARN, "    [CurlAccessor::get(%s)] failed\n", m_url.c_str());
   }
@@ -143,6 +177,110 @@ int CurlAccessor::get(Log& logger, std::string& body)
 }
 
 
+// GET passing the body to 'body' as it arrives.
+int CurlAccessor::get(Log& logger, CurlBodyStream& body)
+{
+  m_body = NULL;
+  m_stream = &body;
+  curl_easy_setopt(curl, CURLOPT_HTTPGET, 1);
+  curl_easy_setopt(curl, CURLOPT_HTTPHEADER, m_headers.slist());
+  curl_easy_setopt(curl, CURLOPT_WRITEDATA, this);
+  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback_string);
+  m_curl_code = perform(WorkerPool::META, "GET");
+
+  LOG(logger, Log::VERBOSE, "   [CurlAccessor::get(%s)] stream => %d\n", m_url.c_str(), m_res_status);
+  if(m_curl_code!=CURLE_OK) log_request_failed(logger, __FUNCTION__);
+
+  return m_res_status;
+}
+
+
+// ranged GET into 'fd' at the same offset.
+int CurlAccessor::get(Log& logger, int fd, uint64_t offset, uint64_t size)
+{
+  char range[256];
+  snprintf(range, sizeof(range), "%"FINT64"u-%"FINT64"u", offset, offset+size-1);
+
+  m_fd = fd;
+  m_fd_offset = offset;
+  m_buffer_size = size;
+  m_read_size = 0;
+  curl_easy_setopt(curl, CURLOPT_HTTPGET, 1);
+  curl_easy_setopt(curl, CURLOPT_HTTPHEADER, m_headers.slist());
+  curl_easy_setopt(curl, CURLOPT_RANGE, range);
+  curl_easy_setopt(curl, CURLOPT_WRITEDATA, this);
+  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback_fd);
+  m_curl_code = perform(WorkerPool::DATA, "GET");
+
+  LOG(logger, Log::VERBOSE, "   [CurlAccessor::get(%s)] fd=%d, offset=%"FINT64"u, size=%"FINT64"u => %d\n", \
+                         m_url.c_str(), fd, offset, size, m_res_status);
+  if(m_curl_code!=CURLE_OK) log_request_failed(logger, __FUNCTION__);
+
+  return m_res_status;
+}
+
+
+CURLcode CurlAccessor::perform(WorkerPool::LANE lane, const char* method)
+{
+  TraceSpan span("http", method, m_url.c_str());
+  PROBE2(http__start, method, m_url.c_str());
+  Latency::remote();
+
+  CURLcode code;
+  if((s_pool==NULL) || WorkerPool::on_worker()) {
+    // already on a worker: the job has been scheduled by its owner.
+    code = curl_easy_perform(curl);
+  } else {
+    CurlPerformJob job(curl);
+    s_pool->submit(&job, lane, m_priority);
+    if(!s_pool->wait(&job)) {
+      // interrupted: drop the request or abort the transfer.
+      m_cancel = true;
+      if(s_pool->cancel(&job)) {
+        PROBE5(http__done, method, m_url.c_str(), -CURLE_ABORTED_BY_CALLBACK, 0, 0);
+        span.status(-CURLE_ABORTED_BY_CALLBACK);
+        return CURLE_ABORTED_BY_CALLBACK;
+      }
+      job.wait();
+    }
+    code = job.code;
+  }
+
+  HttpTiming t = record_timing(code, method);
+  PROBE5(http__done, method, m_url.c_str(), (t.status>0)? t.status: -(int)code, t.bytes, t.total);
+  span.status((t.status>0)? t.status: -(int)code);
+  span.bytes(t.bytes);
+  return code;
+}
+
+
+// aggregate the transfer into HostStats and Recorder.
+HttpTiming CurlAccessor::record_timing(CURLcode code, const char* method)
+{
+  HttpTiming t;
+  double v;
+  long l;
+  if(curl_easy_getinfo(curl, CURLINFO_NAMELOOKUP_TIME, &v)==CURLE_OK) t.namelookup = (uint64_t)(v * 1000000);
+  if(curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME, &v)==CURLE_OK) t.connect = (uint64_t)(v * 1000000);
+  if(curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME, &v)==CURLE_OK) t.appconnect = (uint64_t)(v * 1000000);
+  if(curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME, &v)==CURLE_OK) t.starttransfer = (uint64_t)(v * 1000000);
+  if(curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME, &v)==CURLE_OK) t.total = (uint64_t)(v * 1000000);
+#if LIBCURL_VERSION_NUM >= 0x073700
+  curl_off_t n;
+  if(curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD_T, &n)==CURLE_OK) t.bytes = n;
+#else
+  if(curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD, &v)==CURLE_OK) t.bytes = (uint64_t)v;
+#endif
+  if(curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &l)==CURLE_OK) t.status = l;
+  if(curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &l)==CURLE_OK) t.reused = (l==0) && (t.status>0);
+  t.code = code;
+  HostStats::record(url(), t);
+  Recorder::record(RecorderEntry::HTTP, method, url(), t.total * 1000,
+                   (t.status>0)? t.status: -(int)code, t.bytes, true);
+  return t;
+}
+
+
 size_t CurlAccessor::copy(const void* ptr, uint64_t size)
 {
   if(m_buffer==NULL) return 0;
@@ -205,8 +343,43 @@ size_t CurlAccessor::write_callback(const void* ptr, size_t size, size_t nmemb,
 size_t CurlAccessor::write_callback_string(const void* ptr, size_t size, size_t nmemb, void* _context)
 {
   CurlAccessor* self = (CurlAccessor*)_context;
+  if(self->m_stream) {
+    if(!self->m_stream->write(*self, (const char*)ptr, size*nmemb)) return 0;
+    return nmemb;
+  }
   self->m_body->append((const char*)ptr, size*nmemb);
   return nmemb;
 }
 
+
+size_t CurlAccessor::write_callback_fd(const void* ptr, size_t size, size_t nmemb, void* _context)
+{
+  CurlAccessor* self = (CurlAccessor*)_context;
+  uint64_t n = size*nmemb;
+  if(self->m_read_size+n>self->m_buffer_size) return 0;
+
+  size_t done = 0;
+  while(done<n) {
+    ssize_t w = pwrite(self->m_fd, (const char*)ptr+done, n-done, self->m_fd_offset+self->m_read_size+done);
+    if(w<=0) {
+      if((w<0) && (errno==EINTR)) continue;
+      return 0;
+    }
+    done += w;
+  }
+  self->m_read_size += n;
+  return n;
+}
+
+
+int CurlAccessor::xferinfo_callback(void* _context, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow)
+{
+  CurlAccessor* self = (CurlAccessor*)_context;
+  if(self->m_cancel) return 1;
+  if(self->m_abort && *self->m_abort) return 1;
+  // performing on the client's thread.
+  if(WorkerPool::interrupted()) return 1;
+  return 0;
+}
+
 // vim: sw=2 sts=2 ts=4 expandtab :
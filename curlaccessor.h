@@ -25,6 +25,8 @@
 #include <string>
 #include <curl/curl.h>
 #include "log.h"
+#include "workerpool.h"
+#include "hoststats.h"
 
 
 class CurlSlist
@@ -42,6 +44,16 @@ private:
 };
 
 
+class CurlAccessor;
+// receiver of a body as it arrives. returning false aborts the transfer.
+class CurlBodyStream
+{
+public:
+  inline virtual ~CurlBodyStream() {};
+  virtual bool write(CurlAccessor& ca, const char* ptr, size_t size) = 0;
+};
+
+
 class CurlAccessor
 {
 public:
@@ -51,16 +63,28 @@ public:
   int head(Log& logger);
   int get(Log& logger, void* buf, uint64_t size, uint64_t offset);
   int get(Log& logger, std::string& body);
+  int get(Log& logger, CurlBodyStream& body);
+  int get(Log& logger, int fd, uint64_t offset, uint64_t size);
   inline const char* url() { return m_url.c_str(); };
+  inline int status() const { return m_res_status; };
   inline uint64_t content_length() { return m_content_length; };
   inline std::string content_type() { return m_content_type; };
   inline std::string x_filestat() { return m_x_filestat; };
+  inline void priority(WorkerPool::PRIORITY p) { m_priority = p; };
+  inline void cancel() { m_cancel = true; };
+  inline void abort_on(volatile bool* flag) { m_abort = flag; };
+  inline bool aborted() const { return m_curl_code==CURLE_ABORTED_BY_CALLBACK; };
+  inline uint64_t read_size() const { return m_read_size; };
+  inline static void pool(WorkerPool* p) { s_pool = p; };
 
 private:
   CURL* curl;
   std::string m_user_agent;
   std::string m_url;
   CurlSlist m_headers;
+  WorkerPool::PRIORITY m_priority;
+  volatile bool   m_cancel;
+  volatile bool*  m_abort;
   CURLcode  m_curl_code;
   int m_res_status;
   uint64_t m_content_length;
@@ -69,14 +93,22 @@ private:
   void* m_buffer;
   uint64_t m_buffer_size;
   uint64_t m_read_size;
+  int       m_fd;
+  uint64_t  m_fd_offset;
   std::string* m_body;
+  CurlBodyStream* m_stream;
   size_t copy(const void* ptr, uint64_t size);
   void log_request_failed(Log& logger, const char* func);
+  CURLcode perform(WorkerPool::LANE lane, const char* method);
+  HttpTiming record_timing(CURLcode code, const char* method);
+  static WorkerPool* s_pool;
 
 private:
   static size_t header_callback(const void* ptr, size_t size, size_t nmemb, void* _context);
   static size_t write_callback(const void* ptr, size_t size, size_t nmemb, void* _context);
   static size_t write_callback_string(const void* ptr, size_t size, size_t nmemb, void* _context);
+  static size_t write_callback_fd(const void* ptr, size_t size, size_t nmemb, void* _context);
+  static int xferinfo_callback(void* _context, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow);
 };
   
 
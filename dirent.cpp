@@ -16,6 +16,7 @@
 */
 
 #include <string.h>
+#include "jsonscan.h"
 #include "dirent.h"
 
 
@@ -60,4 +61,190 @@ void Direntries::from_json(std::string& json)
   throw std::string("Unknown json type.");
 }
 
+
+// class DirentList implements.
+void DirentList::from_json(const char* json, size_t len)
+{
+  DirentStream ds;
+  clear();
+  ds.feed(json, len, *this);
+  ds.finish();
+  if(empty()) throw std::string(ds.hash()? "Empty hash.": "Empty array.");
+}
+
+
+// one entry, '"name":{..}' of a hash or '"name"' of an array.
+// nothing is added when the text ends in the entry.
+const char* DirentList::parse_entry(const char* p, const char* end, bool hash)
+{
+  if(p>=end) return NULL;
+  if(*p!='"') throw std::string("Name is required.");
+
+  Entry e;
+  e.name = m_names.size();
+  e.mode = S_IFDIR;
+  e.size = 0;
+  e.mtime = 0;
+  p = JsonScan::string(p, end, &m_names);
+  if(p && hash) {
+    p = JsonScan::skip_ws(p, end);
+    if((p<end) && (*p!=':')) throw std::string("':' is required.");
+    p = (p<end)? FileStat::scan(p + 1, end, e.mode, e.size, e.mtime): NULL;
+  }
+  if(!p) {
+    m_names.resize(e.name);
+    return NULL;
+  }
+  m_names.push_back('\0');
+  if(m_names.size()>0xffffffffULL) throw std::string("Too large listing.");
+  m_entries.push_back(e);
+  return p;
+}
+
+
+// a binary listing of DirentBinary. an empty directory is not an error.
+void DirentList::from_binary(const char* data, size_t len)
+{
+  DirentStream ds(DirentStream::BINARY);
+  clear();
+  ds.feed(data, len, *this);
+  ds.finish();
+}
+
+
+// one entry of a binary listing, whose name_len is not 0.
+// nothing is added when the data ends in the entry.
+const char* DirentList::parse_record(const char* p, const char* end)
+{
+  if(end - p<DirentBinary::RECORD) return NULL;
+  size_t len = DirentBinary::get(p, 2);
+  if((size_t)(end - p)<DirentBinary::RECORD + len) return NULL;
+  const char* name = p + DirentBinary::RECORD;
+  if(memchr(name, '\0', len)) throw std::string("Name has NUL.");
+
+  Entry e;
+  e.name = m_names.size();
+  e.mode = DirentBinary::get(p + 2, 4);
+  e.size = DirentBinary::get(p + 6, 8);
+  e.mtime = (time_t)(int64_t)DirentBinary::get(p + 14, 8);
+  m_names.insert(m_names.end(), name, name + len);
+  m_names.push_back('\0');
+  if(m_names.size()>0xffffffffULL) throw std::string("Too large listing.");
+  m_entries.push_back(e);
+  return name + len;
+}
+
+
+
+// class DirentStream implements.
+DirentStream::DirentStream(FORMAT format)
+{
+  m_state = BEGIN;
+  m_format = format;
+  m_hash = true;
+}
+
+
+// decode the complete entries of the chunk into 'list', and keep the rest for the next one.
+void DirentStream::feed(const char* data, size_t len, DirentList& list)
+{
+  if(m_pending.empty()) {
+    const char* p = (m_format==BINARY)? parse_binary(data, data + len, list): parse(data, data + len, list);
+    m_pending.assign(p, data + len - p);
+  } else {
+    m_pending.append(data, len);
+    const char* b = m_pending.data(), *e = b + m_pending.size();
+    const char* p = (m_format==BINARY)? parse_binary(b, e, list): parse(b, e, list);
+    m_pending.erase(0, p - m_pending.data());
+  }
+}
+
+
+// the body has ended.
+void DirentStream::finish()
+{
+  if(m_format==BINARY) {
+    if(m_state!=END) throw std::string("Unexpected end of listing.");
+    return;
+  }
+  if(m_state==BEGIN) throw std::string("Unknown json type.");
+  if(m_state!=END) throw std::string("Unexpected end of json.");
+}
+
+
+// returns where the decoding has stopped.
+const char* DirentStream::parse(const char* p, const char* end, DirentList& list)
+{
+  for(;;) {
+    p = JsonScan::skip_ws(p, end);
+    if(p>=end) return p;
+
+    switch(m_state) {
+    case BEGIN:
+      if((*p!='{') && (*p!='[')) throw std::string("Unknown json type.");
+      m_hash = (*p=='{');
+      m_state = FIRST;
+      p++;
+      break;
+    case FIRST:
+      if(*p==(m_hash? '}': ']')) {
+        m_state = END;
+        p++;
+      } else {
+        m_state = ENTRY;
+      }
+      break;
+    case ENTRY: {
+        const char* e = list.parse_entry(p, end, m_hash);
+        if(!e) return p;
+        m_state = NEXT;
+        p = e;
+        break;
+      }
+    case NEXT:
+      if(*p==(m_hash? '}': ']')) {
+        m_state = END;
+      } else if(*p==',') {
+        m_state = ENTRY;
+      } else {
+        throw std::string("',' is required.");
+      }
+      p++;
+      break;
+    case END:
+      return end;
+    }
+  }
+}
+
+
+// returns where the decoding has stopped, as parse().
+const char* DirentStream::parse_binary(const char* p, const char* end, DirentList& list)
+{
+  for(;;) {
+    switch(m_state) {
+    case BEGIN:
+      if(end - p<DirentBinary::HEADER) return p;
+      if((memcmp(p, "AHDL", 4)!=0) || (p[4]!=DirentBinary::VERSION)) throw std::string("Unknown listing type.");
+      m_state = ENTRY;
+      p += DirentBinary::HEADER;
+      break;
+    case ENTRY: {
+        if(end - p<2) return p;
+        if(DirentBinary::get(p, 2)==0) {
+          m_state = END;
+          p += 2;
+          break;
+        }
+        const char* e = list.parse_record(p, end);
+        if(!e) return p;
+        p = e;
+        break;
+      }
+    default:
+      return end;
+    }
+  }
+}
+
 // vim: sw=2 sts=2 ts=4 expandtab :
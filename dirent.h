@@ -21,9 +21,13 @@
 #include <stdint.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <vector>
 #include "filestat.h"
 #include "ext/picojson.h"
 
+// media type of the binary listing, asked by Accept before text/json.
+#define DIRENT_BINARY_TYPE "application/x-autohttpfs-listing"
+
 
 class Direntries: public std::vector<FileStat>
 {
@@ -33,5 +37,102 @@ public:
 };
 
 
+// compact listing decoded straight from the JSON text, without a DOM.
+// entries are fixed size and all the names are in one buffer, in the order of the listing.
+class DirentList
+{
+public:
+  struct Entry {
+    uint32_t  name;     // offset of the NUL terminated name in the buffer.
+    mode_t    mode;
+    uint64_t  size;
+    time_t    mtime;
+  };
+
+public:
+  inline DirentList() {};
+  inline size_t size() const { return m_entries.size(); };
+  inline bool empty() const { return m_entries.empty(); };
+  inline const Entry& operator[](size_t i) const { return m_entries[i]; };
+  inline const char* name(size_t i) const { return &m_names[m_entries[i].name]; };
+  inline void clear() { m_entries.clear(); m_names.clear(); };
+  void from_json(const char* json, size_t len);
+  inline void from_json(const std::string& json) { from_json(json.data(), json.size()); };
+  void from_binary(const char* data, size_t len);
+  inline void from_binary(const std::string& data) { from_binary(data.data(), data.size()); };
+
+private:
+  friend class DirentStream;
+  const char* parse_entry(const char* p, const char* end, bool hash);
+  const char* parse_record(const char* p, const char* end);
+
+private:
+  std::vector<Entry> m_entries;
+  std::vector<char>  m_names;
+};
+
+
+// binary listing of DIRENT_BINARY_TYPE. integers are little endian.
+//   header  "AHDL" version(u8: 1) reserved(3 bytes: 0)
+//   entry   name_len(u16: 1..65535) mode(u32: st_mode) size(u64) mtime(s64: unix time) name(name_len bytes)
+//   end     name_len 0
+class DirentBinary
+{
+public:
+  enum { HEADER = 8, RECORD = 22, VERSION = 1 };
+
+  static inline void header(std::string& out) {
+    out.append("AHDL\x01\0\0\0", HEADER);
+  };
+  static inline void entry(std::string& out, const char* name, size_t len, mode_t mode, uint64_t size, time_t mtime) {
+    char r[RECORD];
+    put(r, len, 2);
+    put(r + 2, mode, 4);
+    put(r + 6, size, 8);
+    put(r + 14, (uint64_t)(int64_t)mtime, 8);
+    out.append(r, RECORD);
+    out.append(name, len);
+  };
+  static inline void end(std::string& out) {
+    out.append("\0\0", 2);
+  };
+  static inline uint64_t get(const char* p, int bytes) {
+    uint64_t v = 0;
+    for(int ai=bytes-1; ai>=0; ai--) v = (v << 8) | (unsigned char)p[ai];
+    return v;
+  };
+
+private:
+  static inline void put(char* p, uint64_t v, int bytes) {
+    for(int ai=0; ai<bytes; ai++, v>>=8) p[ai] = (char)(v & 0xff);
+  };
+};
+
+
+// incremental decoder of a listing fed with the chunks of the body as they arrive.
+// complete entries are appended to the DirentList passed to feed(), the rest of a chunk is kept.
+class DirentStream
+{
+public:
+  typedef enum { JSON, BINARY } FORMAT;
+
+  DirentStream(FORMAT format=JSON);
+  void feed(const char* data, size_t len, DirentList& list);
+  void finish();
+  inline bool hash() const { return m_hash; };
+  inline FORMAT format() const { return m_format; };
+  inline void format(FORMAT f) { m_format = f; };
+
+private:
+  typedef enum { BEGIN, FIRST, ENTRY, NEXT, END } STATE;
+  STATE m_state;
+  FORMAT m_format;
+  bool  m_hash;
+  std::string m_pending;
+  const char* parse(const char* p, const char* end, DirentList& list);
+  const char* parse_binary(const char* p, const char* end, DirentList& list);
+};
+
+
 #endif // __INCLUDE_DIRENT_H__
 // vim: sw=2 sts=2 ts=4 expandtab :
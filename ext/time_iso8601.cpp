@@ -47,9 +47,10 @@ TimeIso8601& TimeIso8601::operator=(const char* _str)
     memset(&t, 0, sizeof(t));
     _str = strptime(_str, "%Y-%m-%dT%H:%M:%S%z", &t);
     if(!_str) throw "TimeIso8601#operator=(): parse string failed.";
+    // mktime() takes 't' as a local time.
     int ofs = t.tm_gmtoff - gTzOffset();
     time_t r = mktime(&t);
-    self = r + ofs;
+    self = r - ofs;
   } else {
     self = time(NULL);
   }
@@ -15,17 +15,20 @@
   along with this software.  If not, see <http://www.gnu.org/licenses/>.
 */
 
-#include <ctype.h>
-#include "ext/time_iso8601.h"
+#include <string.h>
+#include <vector>
+#include "jsonscan.h"
 #include "int64format.h"
 #include "filestat.h"
 
 
 // convert '[dl-][rwx]{3}' to mode_t.
-static mode_t str_to_mode(const std::string str)
+mode_t FileStat::str_to_mode(const char* str, size_t len)
 {
   mode_t mode = 0;
 
+  if(len==0) return mode;
+
   switch(str[0]) {
   case 'd': mode = S_IFDIR;   break;
   case 'c': mode = S_IFCHR;   break;
@@ -37,7 +40,7 @@ static mode_t str_to_mode(const std::string str)
   default:
     break;
   }
-  if(str.size()!=10) return mode;
+  if(len!=10) return mode;
 
   if(str[1]=='r') mode |= S_IRUSR;
   if(str[2]=='w') mode |= S_IWUSR;
@@ -53,49 +56,188 @@ static mode_t str_to_mode(const std::string str)
 }
 
 
+// days from 1970-01-01 to a date of the proleptic Gregorian calendar.
+static inline int64_t days_from_civil(int64_t y, int m, int d)
+{
+  y -= (m<=2);
+  int64_t era = ((y>=0)? y: y - 399) / 400;
+  int64_t yoe = y - era * 400;
+  int64_t doy = (153 * (m + ((m>2)? -3: 9)) + 2) / 5 + d - 1;
+  int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + doe - 719468;
+}
+
+
+static inline bool digits(const char* p, int n, int& v)
+{
+  v = 0;
+  for(int ai=0; ai<n; ai++) {
+    if((p[ai]<'0') || (p[ai]>'9')) return false;
+    v = v * 10 + (p[ai] - '0');
+  }
+  return true;
+}
+
+
+// convert 'YYYY-MM-DDThh:mm:ss[.fff](Z|+hh|+hhmm|+hh:mm)' to time_t, without libc's time functions.
+// 'mtime' is not changed if 'str' is not in this form.
+bool FileStat::str_to_mtime(const char* str, size_t len, time_t& mtime)
+{
+  int y, mo, d, h, mi, s;
+  if(len<20) return false;
+  if(!digits(str, 4, y) || (str[4]!='-') || !digits(str + 5, 2, mo) || (str[7]!='-') ||
+     !digits(str + 8, 2, d) || (str[10]!='T') || !digits(str + 11, 2, h) || (str[13]!=':') ||
+     !digits(str + 14, 2, mi) || (str[16]!=':') || !digits(str + 17, 2, s)) return false;
+  if((mo<1) || (mo>12) || (d<1) || (d>31) || (h>23) || (mi>59) || (s>60)) return false;
+
+  const char* p = str + 19;
+  const char* end = str + len;
+  if(*p=='.') {
+    for(p++; (p<end) && (*p>='0') && (*p<='9'); p++);
+  }
+  if(p>=end) return false;
+
+  int ofs = 0;
+  if(*p=='Z') {
+    p++;
+  } else if((*p=='+') || (*p=='-')) {
+    int oh, om = 0;
+    int sign = (*p=='-')? -1: 1;
+    p++;
+    if((end - p<2) || !digits(p, 2, oh)) return false;
+    p += 2;
+    if((p<end) && (*p==':')) {
+      if((end - p<3) || !digits(p + 1, 2, om)) return false;
+      p += 3;
+    } else if(end - p>=2) {
+      if(!digits(p, 2, om)) return false;
+      p += 2;
+    }
+    if((oh>23) || (om>59)) return false;
+    ofs = sign * (oh * 3600 + om * 60);
+  } else {
+    return false;
+  }
+  if(p!=end) return false;
+
+  mtime = (time_t)(days_from_civil(y, mo, d) * 86400 + h * 3600 + mi * 60 + s - ofs);
+  return true;
+}
+
+
+// '{"name":{"mode":..,"size":..,"mtime":..}}' of X-FileStat-Json.
+// nothing is allocated unless the name is longer than before or escaped.
 void FileStat::from_json(std::string& json)
 {
-  std::string::iterator j = json.begin();
-  while(isspace(*j)) j++;
-  if((*j)!='{') throw std::string("Hash is required.");
-
-  std::string err;
-  picojson::value root;
-  picojson::parse<std::string::iterator>(root, json.begin(), json.end(), &err);
-  if(!err.empty()) throw err;
-
-  picojson::object obj = root.get<picojson::object>();
-  picojson::object::iterator it = obj.begin();
-  if(it==obj.end()) throw std::string("Empty hash.");
-
-  std::pair<std::string, picojson::value> val = (*it);
-  name = val.first;
-  from_json(val.second);
+  const char* end = json.data() + json.size();
+  const char* p = JsonScan::skip_ws(json.data(), end);
+  if((p>=end) || (*p!='{')) throw std::string("Hash is required.");
+  p = JsonScan::skip_ws(p + 1, end);
+  if((p<end) && (*p=='}')) throw std::string("Empty hash.");
+  if((p<end) && (*p!='"')) throw std::string("Key is required.");
+
+  const char* n = p;
+  mode_t m = mode;
+  uint64_t s = size;
+  time_t t = mtime;
+  if(p<end) p = JsonScan::string(p, end, NULL);
+  const char* ne = p;
+  if(p) p = JsonScan::skip_ws(p, end);
+  if(p && (p<end) && (*p!=':')) throw std::string("':' is required.");
+  if(p && (p<end)) p = scan(p + 1, end, m, s, t);
+  if(!p || (p>=end)) throw std::string("Unexpected end of json.");
+
+  if(memchr(n + 1, '\\', ne - n - 2)==NULL) {
+    name.assign(n + 1, ne - n - 2);
+  } else {
+    std::vector<char> u;
+    JsonScan::string(n, ne, &u);
+    name.assign(u.begin(), u.end());
+  }
+  mode = m;
+  size = s;
+  mtime = t;
 }
 
 
 void FileStat::from_json(picojson::value& val)
 {
-  picojson::value v;
-
   if(val.is<picojson::object>()) {
-    v = val.get("mode");
-    if(!v.is<picojson::null>()) {
-      mode = str_to_mode(v.get<std::string>());
+    const picojson::value& vm = val.get("mode");
+    if(vm.is<std::string>()) {
+      const std::string& s = vm.get<std::string>();
+      mode = str_to_mode(s.data(), s.size());
     }
 
-    v = val.get("size");
-    if(!v.is<picojson::null>()) {
-      size = (uint64_t)(v.get<double>());
+    const picojson::value& vs = val.get("size");
+    if(vs.is<double>()) {
+      size = (uint64_t)(vs.get<double>());
     }
 
-    v = val.get("mtime");
-    if(!v.is<picojson::null>()) {
-      try { mtime = TimeIso8601(v.get<std::string>().c_str()); }
-      catch(const char* e) {}
+    const picojson::value& vt = val.get("mtime");
+    if(vt.is<std::string>()) {
+      const std::string& s = vt.get<std::string>();
+      str_to_mtime(s.data(), s.size(), mtime);
     }
   }
 }
-  
+
+
+static inline bool is_key(const char* k, size_t len, const char* key, size_t keylen)
+{
+  return (len==keylen) && (memcmp(k, key, len)==0);
+}
+
+
+// the stat of an entry: {"mode":"drwxr-xr-x","size":0,"mtime":"2010-10-01T12:34:56+0900"}.
+// other keys are ignored, and so are values other than a hash.
+// Returns the position after it, or NULL when the text ends in it.
+const char* FileStat::scan(const char* p, const char* end, mode_t& mode, uint64_t& size, time_t& mtime)
+{
+  p = JsonScan::skip_ws(p, end);
+  if(p>=end) return NULL;
+  if(*p!='{') return JsonScan::skip_value(p, end);
+  p = JsonScan::skip_ws(p + 1, end);
+  if(p>=end) return NULL;
+  if(*p=='}') return p + 1;
+
+  for(;;) {
+    if(*p!='"') throw std::string("Key is required.");
+    const char* k = p + 1;
+    p = JsonScan::string(p, end, NULL);
+    if(!p) return NULL;
+    size_t klen = p - 1 - k;
+    p = JsonScan::skip_ws(p, end);
+    if(p>=end) return NULL;
+    if(*p!=':') throw std::string("':' is required.");
+    p = JsonScan::skip_ws(p + 1, end);
+    if(p>=end) return NULL;
+
+    if(is_key(k, klen, "mode", 4) && (*p=='"')) {
+      const char* s = p + 1;
+      p = JsonScan::string(p, end, NULL);
+      if(!p) return NULL;
+      mode = str_to_mode(s, p - 1 - s);
+    } else if(is_key(k, klen, "size", 4) && (*p!='"') && (*p!='{') && (*p!='[') && (*p!='t') && (*p!='f') && (*p!='n')) {
+      p = JsonScan::number(p, end, &size);
+      if(!p) return NULL;
+    } else if(is_key(k, klen, "mtime", 5) && (*p=='"')) {
+      const char* s = p + 1;
+      p = JsonScan::string(p, end, NULL);
+      if(!p) return NULL;
+      str_to_mtime(s, p - 1 - s, mtime);
+    } else {
+      p = JsonScan::skip_value(p, end);
+      if(!p) return NULL;
+    }
+
+    p = JsonScan::skip_ws(p, end);
+    if(p>=end) return NULL;
+    if(*p=='}') return p + 1;
+    if(*p!=',') throw std::string("',' or '}' is required.");
+    p = JsonScan::skip_ws(p + 1, end);
+    if(p>=end) return NULL;
+  }
+}
 
 // vim: sw=2 sts=2 ts=4 expandtab :
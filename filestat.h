@@ -36,6 +36,9 @@ public:
   inline virtual ~FileStat() {};
   void from_json(std::string& json);
   void from_json(picojson::value& val);
+  static mode_t str_to_mode(const char* str, size_t len);
+  static bool str_to_mtime(const char* str, size_t len, time_t& mtime);
+  static const char* scan(const char* p, const char* end, mode_t& mode, uint64_t& size, time_t& mtime);
 
 public:
   std::string name;
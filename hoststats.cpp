@@ -0,0 +1,192 @@
+/*
+  Copyright 2010 Toshiyuki Terashita.
+
+  fuse-autohttpfs is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This software is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <curl/curl.h>
+#include "hoststats.h"
+#include "int64format.h"
+
+
+// HostStat class implements.
+HostStat::HostStat()
+{
+  pthread_mutex_init(&m_lock, NULL);
+  m_requests = m_bytes = m_reused = 0;
+  memset(m_status, 0, sizeof(m_status));
+}
+
+
+HostStat::~HostStat()
+{
+  pthread_mutex_destroy(&m_lock);
+}
+
+
+void HostStat::record(const HttpTiming& t)
+{
+  // curl reports elapsed times from the start: split them into phases.
+  uint64_t handshake = (t.appconnect>t.connect)? t.appconnect: t.connect;
+  uint64_t phase[PHASES];
+  phase[DNS] = t.namelookup;
+  phase[CONNECT] = (t.connect>t.namelookup)? t.connect - t.namelookup: 0;
+  phase[TLS] = (t.appconnect>t.connect)? t.appconnect - t.connect: 0;
+  phase[WAIT] = (t.starttransfer>handshake)? t.starttransfer - handshake: 0;
+  phase[TRANSFER] = (t.total>t.starttransfer && t.starttransfer>0)? t.total - t.starttransfer: 0;
+  phase[TOTAL] = t.total;
+
+  pthread_mutex_lock(&m_lock);
+  {
+    m_requests++;
+    m_bytes += t.bytes;
+    if(t.reused) m_reused++;
+    int c = t.status / 100;
+    m_status[((c>=1) && (c<=5))? c: 0]++;
+    if(t.code!=CURLE_OK) m_errors[t.code]++;
+    // timings of failed connections would hide those of responses.
+    if(t.status>0) {
+      for(int p=0; p<PHASES; p++) m_phase[p].record(phase[p]);
+    }
+  }
+  pthread_mutex_unlock(&m_lock);
+}
+
+
+void HostStat::snapshot(Snapshot& s)
+{
+  pthread_mutex_lock(&m_lock);
+  {
+    s.requests = m_requests;
+    s.bytes = m_bytes;
+    s.reused = m_reused;
+    memcpy(s.status, m_status, sizeof(s.status));
+    s.errors = m_errors;
+    for(int p=0; p<PHASES; p++) s.phase[p] = m_phase[p];
+  }
+  pthread_mutex_unlock(&m_lock);
+}
+
+
+std::string HostStat::report()
+{
+  char t[256];
+  std::string r;
+
+  pthread_mutex_lock(&m_lock);
+  {
+    snprintf(t, sizeof(t), "requests: %"FINT64"u\n" "bytes: %"FINT64"u\n" \
+                           "connections: new=%"FINT64"u reused=%"FINT64"u reuse_ratio=%.3f\n" \
+                           "status: 1xx=%"FINT64"u 2xx=%"FINT64"u 3xx=%"FINT64"u 4xx=%"FINT64"u 5xx=%"FINT64"u none=%"FINT64"u\n",
+             m_requests, m_bytes, m_requests - m_reused, m_reused,
+             (m_requests>0)? (double)m_reused/m_requests: 0.0,
+             m_status[1], m_status[2], m_status[3], m_status[4], m_status[5], m_status[0]);
+    r = t;
+    r += "errors:";
+    std::map<int, uint64_t>::iterator it;
+    for(it=m_errors.begin(); it!=m_errors.end(); it++) {
+      snprintf(t, sizeof(t), " %s(%d)=%"FINT64"u", curl_easy_strerror((CURLcode)(*it).first), (*it).first, (*it).second);
+      r += t;
+    }
+    r += "\n";
+    snprintf(t, sizeof(t), "%-10s %10s %10s %10s %10s %10s %10s\n",
+             "phase", "mean(us)", "p50(us)", "p90(us)", "p99(us)", "p999(us)", "max(us)");
+    r += t;
+    for(int p=0; p<PHASES; p++) {
+      Histogram& h = m_phase[p];
+      snprintf(t, sizeof(t), "%-10s %10"FINT64"u %10"FINT64"u %10"FINT64"u %10"FINT64"u %10"FINT64"u %10"FINT64"u\n",
+               phase_name((PHASE)p), h.mean(), h.percentile(0.5), h.percentile(0.9), h.percentile(0.99),
+               h.percentile(0.999), h.max());
+      r += t;
+    }
+  }
+  pthread_mutex_unlock(&m_lock);
+  return r;
+}
+
+
+const char* HostStat::phase_name(PHASE phase)
+{
+  static const char* names[] = { "dns", "connect", "tls", "wait", "transfer", "total" };
+  return ((phase>=0) && (phase<PHASES))? names[phase]: "unknown";
+}
+
+
+
+// HostStats class implements.
+pthread_mutex_t HostStats::s_lock = PTHREAD_MUTEX_INITIALIZER;
+std::map<std::string, HostStat*> HostStats::s_hosts;
+
+
+void HostStats::record(const char* url, const HttpTiming& t)
+{
+  std::string host = host_of(url);
+  HostStat* hs = NULL;
+
+  pthread_mutex_lock(&s_lock);
+  {
+    std::map<std::string, HostStat*>::iterator it = s_hosts.find(host);
+    if(it==s_hosts.end()) {
+      hs = new HostStat();
+      s_hosts.insert(std::map<std::string, HostStat*>::value_type(host, hs));
+    } else {
+      hs = (*it).second;
+    }
+  }
+  pthread_mutex_unlock(&s_lock);
+
+  hs->record(t);
+}
+
+
+// Returns NULL if no request has been made to the host.
+HostStat* HostStats::find(const std::string& host)
+{
+  HostStat* hs = NULL;
+  pthread_mutex_lock(&s_lock);
+  {
+    std::map<std::string, HostStat*>::iterator it = s_hosts.find(host);
+    if(it!=s_hosts.end()) hs = (*it).second;
+  }
+  pthread_mutex_unlock(&s_lock);
+  return hs;
+}
+
+
+std::vector<std::string> HostStats::hosts()
+{
+  std::vector<std::string> r;
+  pthread_mutex_lock(&s_lock);
+  {
+    std::map<std::string, HostStat*>::iterator it;
+    for(it=s_hosts.begin(); it!=s_hosts.end(); it++) r.push_back((*it).first);
+  }
+  pthread_mutex_unlock(&s_lock);
+  return r;
+}
+
+
+// "host:port/path" => "host:port"
+std::string HostStats::host_of(const char* url)
+{
+  const char* p = strstr(url, "://");
+  p = (p)? p+3: url;
+  while(*p=='/') p++;
+  const char* e = strchr(p, '/');
+  return (e)? std::string(p, e-p): std::string(p);
+}
+
+// vim: sw=2 sts=2 ts=4 expandtab :
@@ -0,0 +1,110 @@
+/*
+  Copyright 2010 Toshiyuki Terashita.
+
+  fuse-autohttpfs is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This software is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __INCLUDE_HOSTSTATS_H__
+#define __INCLUDE_HOSTSTATS_H__
+
+#include <stdint.h>
+#include <pthread.h>
+#include <string>
+#include <vector>
+#include <map>
+#include "latency.h"
+
+
+// Result of an HTTP transfer. Times are in usec from the start, as curl reports them.
+class HttpTiming
+{
+public:
+  inline HttpTiming() {
+    namelookup = connect = appconnect = starttransfer = total = bytes = 0;
+    status = code = 0;
+    reused = false;
+  };
+  uint64_t  namelookup;
+  uint64_t  connect;
+  uint64_t  appconnect;     // 0 without TLS.
+  uint64_t  starttransfer;
+  uint64_t  total;
+  uint64_t  bytes;
+  int       status;         // HTTP status, 0 if no response.
+  int       code;           // CURLcode.
+  bool      reused;         // no new connection was made.
+};
+
+
+// Transfers to an origin host.
+class HostStat
+{
+public:
+  typedef enum {
+    DNS = 0,    // name lookup.
+    CONNECT,    // TCP connect.
+    TLS,        // TLS handshake.
+    WAIT,       // request sent to the first byte.
+    TRANSFER,   // first byte to the last.
+    TOTAL,
+    PHASES,
+  } PHASE;
+
+  // copy of the counters.
+  class Snapshot
+  {
+  public:
+    uint64_t  requests;
+    uint64_t  bytes;
+    uint64_t  reused;
+    uint64_t  status[6];
+    std::map<int, uint64_t> errors;
+    Histogram phase[PHASES];
+  };
+
+  HostStat();
+  virtual ~HostStat();
+  void record(const HttpTiming& t);
+  void snapshot(Snapshot& s);
+  std::string report();
+  static const char* phase_name(PHASE phase);
+
+private:
+  pthread_mutex_t m_lock;
+  uint64_t  m_requests;
+  uint64_t  m_bytes;
+  uint64_t  m_reused;
+  uint64_t  m_status[6];    // by 1xx..5xx, [0] is others.
+  std::map<int, uint64_t> m_errors;   // by CURLcode.
+  Histogram m_phase[PHASES];
+};
+
+
+// HostStat of all origins, keyed by "host[:port]".
+class HostStats
+{
+public:
+  static void record(const char* url, const HttpTiming& t);
+  static HostStat* find(const std::string& host);
+  static std::vector<std::string> hosts();
+  static std::string host_of(const char* url);
+
+private:
+  static pthread_mutex_t s_lock;
+  static std::map<std::string, HostStat*> s_hosts;
+};
+
+
+#endif // __INCLUDE_HOSTSTATS_H__
+// vim: sw=2 sts=2 ts=4 expandtab :
@@ -0,0 +1,2 @@
+#define FINT64 "l"
+#define FSIZET "l"
@@ -0,0 +1,346 @@
+/*
+  Copyright 2010 Toshiyuki Terashita.
+
+  fuse-autohttpfs is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This software is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include "jsonscan.h"
+
+
+// searches of quotes and brackets.
+static const char* find_quote_scalar(const char* p, const char* end)
+{
+  while((p<end) && (*p!='"') && (*p!='\\')) p++;
+  return p;
+}
+
+
+static const char* find_bracket_scalar(const char* p, const char* end)
+{
+  while((p<end) && (*p!='"') && (*p!='{') && (*p!='}') && (*p!='[') && (*p!=']')) p++;
+  return p;
+}
+
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define JSONSCAN_X86
+
+// the tail shorter than a vector is searched by the scalar one.
+__attribute__((target("sse4.2")))
+static const char* find_quote_sse42(const char* p, const char* end)
+{
+  const __m128i set = _mm_setr_epi8('"', '\\', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+  for(; p + 16<=end; p+=16) {
+    __m128i v = _mm_loadu_si128((const __m128i*)p);
+    int i = _mm_cmpestri(set, 2, v, 16, _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY | _SIDD_LEAST_SIGNIFICANT);
+    if(i<16) return p + i;
+  }
+  return find_quote_scalar(p, end);
+}
+
+
+__attribute__((target("sse4.2")))
+static const char* find_bracket_sse42(const char* p, const char* end)
+{
+  const __m128i set = _mm_setr_epi8('"', '{', '}', '[', ']', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+  for(; p + 16<=end; p+=16) {
+    __m128i v = _mm_loadu_si128((const __m128i*)p);
+    int i = _mm_cmpestri(set, 5, v, 16, _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY | _SIDD_LEAST_SIGNIFICANT);
+    if(i<16) return p + i;
+  }
+  return find_bracket_scalar(p, end);
+}
+
+
+// tokens are short: the first 16 bytes are tried alone.
+__attribute__((target("avx2")))
+static const char* find_quote_avx2(const char* p, const char* end)
+{
+  if(p + 16<=end) {
+    __m128i v = _mm_loadu_si128((const __m128i*)p);
+    uint32_t m = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')),
+                                                _mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))));
+    if(m) return p + __builtin_ctz(m);
+    p += 16;
+  }
+  const __m256i q = _mm256_set1_epi8('"');
+  const __m256i b = _mm256_set1_epi8('\\');
+  for(; p + 32<=end; p+=32) {
+    __m256i v = _mm256_loadu_si256((const __m256i*)p);
+    uint32_t m = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, q), _mm256_cmpeq_epi8(v, b)));
+    if(m) return p + __builtin_ctz(m);
+  }
+  return find_quote_scalar(p, end);
+}
+
+
+// '{' '}' '[' ']' are 0x7b 0x7d 0x5b 0x5d: (c | 0x20)=='{' or '}' catches them all.
+__attribute__((target("avx2")))
+static const char* find_bracket_avx2(const char* p, const char* end)
+{
+  if(p + 16<=end) {
+    __m128i v = _mm_loadu_si128((const __m128i*)p);
+    __m128i l = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    uint32_t m = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')),
+                                   _mm_or_si128(_mm_cmpeq_epi8(l, _mm_set1_epi8('{')), _mm_cmpeq_epi8(l, _mm_set1_epi8('}')))));
+    if(m) return p + __builtin_ctz(m);
+    p += 16;
+  }
+  const __m256i q = _mm256_set1_epi8('"');
+  const __m256i lc = _mm256_set1_epi8(0x20);
+  const __m256i o = _mm256_set1_epi8('{');
+  const __m256i c = _mm256_set1_epi8('}');
+  for(; p + 32<=end; p+=32) {
+    __m256i v = _mm256_loadu_si256((const __m256i*)p);
+    __m256i l = _mm256_or_si256(v, lc);
+    __m256i hit = _mm256_or_si256(_mm256_cmpeq_epi8(v, q),
+                                  _mm256_or_si256(_mm256_cmpeq_epi8(l, o), _mm256_cmpeq_epi8(l, c)));
+    uint32_t m = _mm256_movemask_epi8(hit);
+    if(m) return p + __builtin_ctz(m);
+  }
+  return find_bracket_scalar(p, end);
+}
+#endif
+
+
+
+static int hex4(const char* p)
+{
+  int v = 0;
+  for(int ai=0; ai<4; ai++) {
+    char c = p[ai];
+    v <<= 4;
+    if((c>='0') && (c<='9'))      v |= c - '0';
+    else if((c>='a') && (c<='f')) v |= c - 'a' + 10;
+    else if((c>='A') && (c<='F')) v |= c - 'A' + 10;
+    else throw std::string("Bad unicode escape.");
+  }
+  return v;
+}
+
+
+static void put_utf8(std::vector<char>& out, uint32_t c)
+{
+  if(c<0x80) {
+    out.push_back(c);
+  } else if(c<0x800) {
+    out.push_back(0xc0 | (c>>6));
+    out.push_back(0x80 | (c & 0x3f));
+  } else if(c<0x10000) {
+    out.push_back(0xe0 | (c>>12));
+    out.push_back(0x80 | ((c>>6) & 0x3f));
+    out.push_back(0x80 | (c & 0x3f));
+  } else {
+    out.push_back(0xf0 | (c>>18));
+    out.push_back(0x80 | ((c>>12) & 0x3f));
+    out.push_back(0x80 | ((c>>6) & 0x3f));
+    out.push_back(0x80 | (c & 0x3f));
+  }
+}
+
+
+// string at the opening quote 'p'. the unescaped string is appended to 'out' if given.
+const char* JsonScan::string(const char* p, const char* end, std::vector<char>* out)
+{
+  p++;
+  while(p<end) {
+    const char* s = p;
+    p = find_quote(p, end);
+    if(out) out->insert(out->end(), s, p);
+    if(p>=end) return NULL;
+    if(*p=='"') return p + 1;
+
+    if(p + 1>=end) return NULL;
+    char c = p[1];
+    p += 2;
+    switch(c) {
+    case '"': case '\\': case '/': break;
+    case 'b': c = '\b'; break;
+    case 'f': c = '\f'; break;
+    case 'n': c = '\n'; break;
+    case 'r': c = '\r'; break;
+    case 't': c = '\t'; break;
+    case 'u': {
+        if(p + 4>end) return NULL;
+        uint32_t u = hex4(p);
+        p += 4;
+        if((u>=0xd800) && (u<0xdc00)) {
+          // surrogate pair.
+          if(p + 6>end) return NULL;
+          if((p[0]!='\\') || (p[1]!='u')) throw std::string("Bad surrogate pair.");
+          uint32_t l = hex4(p + 2);
+          if((l<0xdc00) || (l>=0xe000)) throw std::string("Bad surrogate pair.");
+          u = 0x10000 + ((u - 0xd800)<<10) + (l - 0xdc00);
+          p += 6;
+        } else if((u>=0xdc00) && (u<0xe000)) {
+          throw std::string("Bad surrogate pair.");
+        }
+        if(out) put_utf8(*out, u);
+        continue;
+      }
+    default:
+      throw std::string("Bad escape.");
+    }
+    if(out) out->push_back(c);
+  }
+  return NULL;
+}
+
+
+// number at 'p' into 'v' if given. negatives are 0 and fractions are truncated.
+const char* JsonScan::number(const char* p, const char* end, uint64_t* v)
+{
+  const char* s = p;
+  while((p<end) && (((*p>='0') && (*p<='9')) || (*p=='-') || (*p=='+') || (*p=='.') || (*p=='e') || (*p=='E'))) p++;
+  if(p>=end) return NULL;
+  if(p==s) throw std::string("Bad value.");
+
+  if(v) {
+    uint64_t n = 0;
+    const char* d = s;
+    while((d<p) && (*d>='0') && (*d<='9')) n = n * 10 + (*d++ - '0');
+    if(d<p) {
+      char t[64];
+      size_t len = (p - s<(ptrdiff_t)sizeof(t))? p - s: sizeof(t) - 1;
+      memcpy(t, s, len);
+      t[len] = 0;
+      double f = strtod(t, NULL);
+      n = (f>0)? (uint64_t)f: 0;
+    }
+    *v = n;
+  }
+  return p;
+}
+
+
+// any value. the contents of hashes and arrays are skipped without checking them.
+const char* JsonScan::skip_value(const char* p, const char* end)
+{
+  static const char* literals[] = { "true", "false", "null" };
+
+  p = skip_ws(p, end);
+  if(p>=end) return NULL;
+  switch(*p) {
+  case '"':
+    return string(p, end, NULL);
+  case '{': case '[':
+    break;
+  case 't': case 'f': case 'n': {
+      const char* l = literals[(*p=='t')? 0: (*p=='f')? 1: 2];
+      size_t len = strlen(l);
+      if(p + len>end) return NULL;
+      if(memcmp(p, l, len)!=0) throw std::string("Bad value.");
+      return p + len;
+    }
+  default:
+    return number(p, end, NULL);
+  }
+
+  int depth = 0;
+  for(;;) {
+    p = find_bracket(p, end);
+    if(p>=end) return NULL;
+    switch(*p) {
+    case '"':
+      p = string(p, end, NULL);
+      if(!p) return NULL;
+      break;
+    case '{': case '[':
+      depth++;
+      p++;
+      break;
+    default:
+      depth--;
+      p++;
+      if(depth==0) return p;
+      break;
+    }
+  }
+}
+
+
+
+// class JsonScan implements.
+JsonScan::ISA JsonScan::s_isa = JsonScan::SCALAR;
+const char* (*JsonScan::s_find_quote)(const char* p, const char* end) = find_quote_scalar;
+const char* (*JsonScan::s_find_bracket)(const char* p, const char* end) = find_bracket_scalar;
+
+
+bool JsonScan::supported(ISA isa)
+{
+  switch(isa) {
+  case SCALAR:
+    return true;
+#ifdef JSONSCAN_X86
+  case SSE42:
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse4.2");
+  case AVX2:
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+  default:
+    return false;
+  }
+}
+
+
+// select the implementation. false if the CPU does not have it.
+bool JsonScan::use(ISA isa)
+{
+  if(!supported(isa)) return false;
+
+  switch(isa) {
+#ifdef JSONSCAN_X86
+  case SSE42:
+    s_find_quote = find_quote_sse42;
+    s_find_bracket = find_bracket_sse42;
+    break;
+  case AVX2:
+    s_find_quote = find_quote_avx2;
+    s_find_bracket = find_bracket_avx2;
+    break;
+#endif
+  default:
+    s_find_quote = find_quote_scalar;
+    s_find_bracket = find_bracket_scalar;
+    break;
+  }
+  s_isa = isa;
+  return true;
+}
+
+
+const char* JsonScan::isa_name(ISA isa)
+{
+  static const char* names[] = { "scalar", "sse4.2", "avx2" };
+  return (isa<ISAS)? names[isa]: "unknown";
+}
+
+
+// the best one at startup.
+class JsonScanSelector
+{
+public:
+  JsonScanSelector() {
+    if(!JsonScan::use(JsonScan::AVX2)) JsonScan::use(JsonScan::SSE42);
+  };
+};
+static JsonScanSelector gJsonScanSelector;
+
+// vim: sw=2 sts=2 ts=4 expandtab :
@@ -0,0 +1,71 @@
+/*
+  Copyright 2010 Toshiyuki Terashita.
+
+  fuse-autohttpfs is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This software is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef __INCLUDE_JSONSCAN_H__
+#define __INCLUDE_JSONSCAN_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+
+// Scanners of JSON text for the decoders of listings and X-FileStat-Json.
+// They return the position after what they have read, or NULL when the text ends in it,
+// and throw std::string on a syntax error.
+// Bodies of strings and skipped hashes/arrays are searched for their quotes and brackets
+// 16 or 32 bytes at a time, with SSE4.2 or AVX2 when the CPU has them.
+class JsonScan
+{
+public:
+  typedef enum {
+    SCALAR = 0,
+    SSE42,
+    AVX2,
+    ISAS,
+  } ISA;
+
+  static inline bool is_ws(char c) {
+    return (c==' ') || (c=='\t') || (c=='\n') || (c=='\r');
+  };
+  static inline const char* skip_ws(const char* p, const char* end) {
+    while((p<end) && is_ws(*p)) p++;
+    return p;
+  };
+  static const char* string(const char* p, const char* end, std::vector<char>* out);
+  static const char* number(const char* p, const char* end, uint64_t* v);
+  static const char* skip_value(const char* p, const char* end);
+
+  // first '"' or '\\' in [p, end), or end.
+  static inline const char* find_quote(const char* p, const char* end) { return s_find_quote(p, end); };
+  // first '"', '{', '}', '[' or ']' in [p, end), or end.
+  static inline const char* find_bracket(const char* p, const char* end) { return s_find_bracket(p, end); };
+
+  static bool use(ISA isa);
+  inline static ISA isa() { return s_isa; };
+  static bool supported(ISA isa);
+  static const char* isa_name(ISA isa);
+
+private:
+  static ISA s_isa;
+  static const char* (*s_find_quote)(const char* p, const char* end);
+  static const char* (*s_find_bracket)(const char* p, const char* end);
+};
+
+
+#endif // __INCLUDE_JSONSCAN_H__
+// vim: sw=2 sts=2 ts=4 expandtab :
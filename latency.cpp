@@ -0,0 +1,198 @@
+/*
+  Copyright 2010 Toshiyuki Terashita.
+
+  fuse-autohttpfs is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This software is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "latency.h"
+#include "int64format.h"
+
+
+// Histogram class implements.
+Histogram::Histogram()
+{
+  clear();
+}
+
+
+void Histogram::clear()
+{
+  memset(m_counts, 0, sizeof(m_counts));
+  m_count = m_sum = m_max = 0;
+}
+
+
+void Histogram::merge(const Histogram& h)
+{
+  for(size_t i=0; i<HISTOGRAM_BUCKETS; i++) m_counts[i] += h.m_counts[i];
+  m_count += h.m_count;
+  m_sum += h.m_sum;
+  if(h.m_max>m_max) m_max = h.m_max;
+}
+
+
+// upper bound of the bucket holding the p (0.0 .. 1.0) quantile.
+uint64_t Histogram::percentile(double p) const
+{
+  if(m_count==0) return 0;
+
+  uint64_t target = (uint64_t)(p * m_count + 0.999999);
+  if(target<1) target = 1;
+  uint64_t n = 0;
+  for(size_t i=0; i<HISTOGRAM_BUCKETS; i++) {
+    n += m_counts[i];
+    if(n>=target) {
+      uint64_t u = upper(i);
+      return (u<m_max)? u: m_max;
+    }
+  }
+  return m_max;
+}
+
+
+size_t Histogram::index(uint64_t v)
+{
+  if(v>=(1ULL<<HISTOGRAM_MAX_BITS)) v = (1ULL<<HISTOGRAM_MAX_BITS) - 1;
+  if(v<HISTOGRAM_SUB) return v;
+
+  int e = 63 - __builtin_clzll(v);
+  size_t sub = (v >> (e - HISTOGRAM_SUB_BITS)) & (HISTOGRAM_SUB - 1);
+  return (e - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB + sub;
+}
+
+
+uint64_t Histogram::lower(size_t index)
+{
+  if(index<HISTOGRAM_SUB) return index;
+
+  int e = index / HISTOGRAM_SUB + HISTOGRAM_SUB_BITS - 1;
+  uint64_t sub = index % HISTOGRAM_SUB;
+  return (HISTOGRAM_SUB + sub) << (e - HISTOGRAM_SUB_BITS);
+}
+
+
+uint64_t Histogram::upper(size_t index)
+{
+  return lower(index + 1) - 1;
+}
+
+
+
+// Latency class implements.
+pthread_mutex_t Latency::s_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_key_t Latency::s_key;
+std::list<Latency::Shard*> Latency::s_shards;
+std::list<Latency::Shard*> Latency::s_free;
+__thread Latency::Shard* Latency::s_shard = NULL;
+__thread bool Latency::s_remote = false;
+__thread bool Latency::s_active = false;
+
+
+void Latency::record(OP op, PATH path, uint64_t nsec)
+{
+  shard()->hist[op][path].record(nsec);
+}
+
+
+// histogram of the calling thread. Shards of exited threads are reused.
+Latency::Shard* Latency::shard()
+{
+  if(s_shard) return s_shard;
+
+  static bool keyed = false;
+  Shard* s = NULL;
+  pthread_mutex_lock(&s_lock);
+  {
+    if(!keyed) {
+      pthread_key_create(&s_key, shard_closed);
+      keyed = true;
+    }
+    if(s_free.empty()) {
+      s = new Shard();
+      s_shards.push_back(s);
+    } else {
+      s = s_free.front();
+      s_free.pop_front();
+    }
+  }
+  pthread_mutex_unlock(&s_lock);
+  pthread_setspecific(s_key, s);
+  s_shard = s;
+  return s;
+}
+
+
+void Latency::shard_closed(void* shard)
+{
+  pthread_mutex_lock(&s_lock);
+  {
+    s_free.push_back((Shard*)shard);
+  }
+  pthread_mutex_unlock(&s_lock);
+}
+
+
+// sum of all threads. Counters being updated may be read slightly behind.
+Histogram Latency::merged(OP op, PATH path)
+{
+  Histogram h;
+  pthread_mutex_lock(&s_lock);
+  {
+    std::list<Shard*>::iterator it;
+    for(it=s_shards.begin(); it!=s_shards.end(); it++) h.merge((*it)->hist[op][path]);
+  }
+  pthread_mutex_unlock(&s_lock);
+  return h;
+}
+
+
+std::string Latency::report()
+{
+  char t[256];
+  snprintf(t, sizeof(t), "%-10s %-4s %10s %10s %10s %10s %10s %10s %10s\n",
+           "op", "path", "count", "mean(us)", "p50(us)", "p90(us)", "p99(us)", "p999(us)", "max(us)");
+  std::string r = t;
+  for(int o=0; o<OPS; o++) {
+    for(int p=0; p<PATHS; p++) {
+      Histogram h = merged((OP)o, (PATH)p);
+      snprintf(t, sizeof(t), "%-10s %-4s %10"FINT64"u %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+               op_name((OP)o), path_name((PATH)p), h.count(), h.mean()/1000.0,
+               h.percentile(0.5)/1000.0, h.percentile(0.9)/1000.0, h.percentile(0.99)/1000.0,
+               h.percentile(0.999)/1000.0, h.max()/1000.0);
+      r += t;
+    }
+  }
+  return r;
+}
+
+
+const char* Latency::op_name(OP op)
+{
+  static const char* names[] = {
+    "getattr", "opendir", "readdir", "releasedir", "truncate",
+    "open", "read", "write", "flush", "release",
+  };
+  return ((op>=0) && (op<OPS))? names[op]: "unknown";
+}
+
+
+const char* Latency::path_name(PATH path)
+{
+  static const char* names[] = { "hit", "miss" };
+  return ((path>=0) && (path<PATHS))? names[path]: "unknown";
+}
+
+// vim: sw=2 sts=2 ts=4 expandtab :
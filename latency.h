@@ -0,0 +1,149 @@
+/*
+  Copyright 2010 Toshiyuki Terashita.
+
+  fuse-autohttpfs is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This software is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __INCLUDE_LATENCY_H__
+#define __INCLUDE_LATENCY_H__
+
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <string>
+#include <list>
+
+// 2^HISTOGRAM_SUB_BITS linear buckets per power of two: about 6% precision.
+#define HISTOGRAM_SUB_BITS  (4)
+#define HISTOGRAM_SUB       (1<<HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_MAX_BITS  (40)  // values are clamped to 2^40 (about 18 minutes in nsec).
+#define HISTOGRAM_BUCKETS   ((HISTOGRAM_MAX_BITS-HISTOGRAM_SUB_BITS+1)*HISTOGRAM_SUB)
+
+
+// Log-linear histogram of non-negative values.
+class Histogram
+{
+public:
+  Histogram();
+  inline void record(uint64_t v) {
+    m_counts[index(v)]++;
+    m_count++;
+    m_sum += v;
+    if(v>m_max) m_max = v;
+  };
+  void merge(const Histogram& h);
+  void clear();
+  inline uint64_t count() const { return m_count; };
+  inline uint64_t sum() const { return m_sum; };
+  inline uint64_t max() const { return m_max; };
+  inline uint64_t mean() const { return (m_count>0)? m_sum/m_count: 0; };
+  uint64_t percentile(double p) const;
+  inline uint64_t bucket(size_t i) const { return m_counts[i]; };
+  static size_t index(uint64_t v);
+  static uint64_t lower(size_t index);
+  static uint64_t upper(size_t index);
+
+private:
+  uint64_t  m_counts[HISTOGRAM_BUCKETS];
+  uint64_t  m_count;
+  uint64_t  m_sum;
+  uint64_t  m_max;
+};
+
+
+// Latency of fuse operations, recorded into per-thread histograms without locking.
+// An operation is a 'miss' if it has performed an HTTP request or waited for one on a worker,
+// otherwise a 'hit'.
+class Latency
+{
+public:
+  typedef enum {
+    GETATTR = 0,
+    OPENDIR,
+    READDIR,
+    RELEASEDIR,
+    TRUNCATE,
+    OPEN,
+    READ,
+    WRITE,
+    FLUSH,
+    RELEASE,
+    OPS,
+  } OP;
+
+  typedef enum {
+    HIT = 0,
+    MISS,
+    PATHS,
+  } PATH;
+
+  static void record(OP op, PATH path, uint64_t nsec);
+  static Histogram merged(OP op, PATH path);
+  static std::string report();
+  static const char* op_name(OP op);
+  static const char* path_name(PATH path);
+  inline static void remote() { s_remote = true; };
+  inline static bool remoted() { return s_remote; };
+  inline static uint64_t now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+  };
+
+private:
+  friend class LatencyTimer;
+  class Shard
+  {
+  public:
+    Histogram hist[OPS][PATHS];
+  };
+  static pthread_mutex_t s_lock;  // guards s_shards and s_free.
+  static pthread_key_t s_key;
+  static std::list<Shard*> s_shards;
+  static std::list<Shard*> s_free;
+  static __thread Shard* s_shard;
+  static __thread bool s_remote;
+  static __thread bool s_active;
+  static Shard* shard();
+  static void shard_closed(void* shard);
+};
+
+
+// Records the latency of the scope. Nested timers are ignored.
+class LatencyTimer
+{
+public:
+  inline LatencyTimer(Latency::OP op): m_op(op) {
+    m_start = Latency::now();
+    m_outer = !Latency::s_active;
+    if(!m_outer) return;
+    Latency::s_active = true;
+    Latency::s_remote = false;
+  };
+  inline ~LatencyTimer() {
+    if(!m_outer) return;
+    Latency::record(m_op, Latency::s_remote? Latency::MISS: Latency::HIT, Latency::now() - m_start);
+    Latency::s_active = false;
+  };
+  inline uint64_t elapsed() const { return Latency::now() - m_start; };
+
+private:
+  Latency::OP m_op;
+  bool      m_outer;
+  uint64_t  m_start;
+};
+
+
+#endif // __INCLUDE_LATENCY_H__
+// vim: sw=2 sts=2 ts=4 expandtab :
@@ -15,9 +15,229 @@
   along with this software.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <string.h>
+#include <time.h>
+#include <sys/time.h>
+#include <pthread.h>
+#include <string>
+#include <list>
+#include <vector>
 #include "log.h"
 
 
+// A formatted message, or a part of it.
+class LogRecord
+{
+public:
+  int       level;
+  uint16_t  size;
+  bool      more;     // the message continues in the next record.
+  char      text[LOG_RECORD_SIZE];
+};
+
+
+// Single producer (the owner thread), single consumer (the drainer) ring.
+class LogRing
+{
+public:
+  inline LogRing(): head(0), tail(0), closed(false) {};
+  volatile uint32_t head;   // written by the owner.
+  volatile uint32_t tail;   // written by the drainer.
+  volatile bool closed;     // the owner thread has exited.
+  LogRecord records[LOG_RING_SLOTS];
+};
+
+
+// Drains all rings into syslog and stdout.
+class LogWriter
+{
+public:
+  LogWriter();
+  void start();
+  void stop();
+  inline bool running() const { return m_running; };
+  LogRing* ring();
+  uint64_t drain();
+
+public:
+  volatile uint64_t written;
+  volatile uint64_t dropped;
+  volatile uint64_t truncated;
+
+private:
+  pthread_mutex_t m_lock;   // guards m_rings and the thread state, never held while writing.
+  pthread_cond_t  m_cond;
+  pthread_key_t   m_key;
+  pthread_t m_thread;
+  std::list<LogRing*> m_rings;
+  volatile bool m_running;
+  bool      m_stop;
+  static __thread LogRing* s_ring;
+  static void ring_closed(void* ring);
+  static void* writer_main(void* ctx);
+};
+
+__thread LogRing* LogWriter::s_ring = NULL;
+static LogWriter s_writer;
+
+
+
+// LogWriter class implements.
+LogWriter::LogWriter()
+{
+  pthread_mutex_init(&m_lock, NULL);
+  pthread_cond_init(&m_cond, NULL);
+  pthread_key_create(&m_key, ring_closed);
+  written = dropped = truncated = 0;
+  m_running = false;
+  m_stop = false;
+}
+
+
+void LogWriter::start()
+{
+  pthread_mutex_lock(&m_lock);
+  {
+    if(!m_running) {
+      m_stop = false;
+      if(pthread_create(&m_thread, NULL, writer_main, this)==0) m_running = true;
+    }
+  }
+  pthread_mutex_unlock(&m_lock);
+}
+
+
+void LogWriter::stop()
+{
+  pthread_mutex_lock(&m_lock);
+  if(!m_running) {
+    pthread_mutex_unlock(&m_lock);
+    return;
+  }
+  // new messages are written synchronously from now.
+  m_running = false;
+  m_stop = true;
+  pthread_cond_signal(&m_cond);
+  pthread_mutex_unlock(&m_lock);
+
+  pthread_join(m_thread, NULL);
+  drain();
+}
+
+
+// ring of the calling thread. The first call of a thread registers it.
+LogRing* LogWriter::ring()
+{
+  if(s_ring) return s_ring;
+
+  LogRing* r = new LogRing();
+  pthread_mutex_lock(&m_lock);
+  {
+    m_rings.push_back(r);
+  }
+  pthread_mutex_unlock(&m_lock);
+  pthread_setspecific(m_key, r);
+  s_ring = r;
+  return r;
+}
+
+
+void LogWriter::ring_closed(void* ring)
+{
+  ((LogRing*)ring)->closed = true;
+}
+
+
+// write out pending records. Returns number of records.
+// m_lock is held only to list the rings: syslog and stdout may block, and
+// a thread logging its first message must not wait for them.
+uint64_t LogWriter::drain()
+{
+  uint64_t n = 0;
+  std::string out;
+  std::string msg;
+  std::vector<LogRing*> rings;
+  std::vector<bool> closed;
+
+  pthread_mutex_lock(&m_lock);
+  {
+    for(std::list<LogRing*>::iterator it=m_rings.begin(); it!=m_rings.end(); it++) {
+      rings.push_back(*it);
+      closed.push_back((*it)->closed);
+    }
+  }
+  pthread_mutex_unlock(&m_lock);
+
+  // the rings are only removed below, by the drainer.
+  for(size_t ai=0; ai<rings.size(); ai++) {
+    LogRing* r = rings[ai];
+    __sync_synchronize();
+    uint32_t t = r->tail;
+    uint32_t h = r->head;
+    __sync_synchronize();
+    // a message is published with all of its records.
+    for(; t!=h; t++) {
+      LogRecord& rec = r->records[t % LOG_RING_SLOTS];
+      msg.append(rec.text, rec.size);
+      if(rec.more) continue;
+      syslog(rec.level, "%s", msg.c_str());
+      char p[16];
+      snprintf(p, sizeof(p), "[%d] ", rec.level);
+      out += p;
+      out += msg;
+      msg.clear();
+      n++;
+    }
+    __sync_synchronize();
+    r->tail = t;
+  }
+
+  if(n>0) {
+    fwrite(out.data(), 1, out.size(), stdout);
+    fflush(stdout);
+    __sync_fetch_and_add(&written, n);
+  }
+
+  // a ring closed before it was drained has no more records.
+  pthread_mutex_lock(&m_lock);
+  {
+    for(size_t ai=0; ai<rings.size(); ai++) {
+      if(!closed[ai]) continue;
+      m_rings.remove(rings[ai]);
+      delete rings[ai];
+    }
+  }
+  pthread_mutex_unlock(&m_lock);
+  return n;
+}
+
+
+void* LogWriter::writer_main(void* ctx)
+{
+  LogWriter* self = (LogWriter*)ctx;
+
+  for(;;) {
+    self->drain();
+
+    pthread_mutex_lock(&self->m_lock);
+    bool stop = self->m_stop;
+    if(!stop) {
+      struct timeval now;
+      gettimeofday(&now, NULL);
+      uint64_t usec = now.tv_usec + LOG_DRAIN_USEC;
+      struct timespec ts;
+      ts.tv_sec = now.tv_sec + usec / 1000000;
+      ts.tv_nsec = (usec % 1000000) * 1000;
+      pthread_cond_timedwait(&self->m_cond, &self->m_lock, &ts);
+    }
+    pthread_mutex_unlock(&self->m_lock);
+    if(stop) break;
+  }
+  return NULL;
+}
+
+
+
 // Log class implements.
 Log::Log(const char* ident, int facility, LOGLEVEL level)
 {
@@ -35,23 +255,106 @@ Log::~Log()
 void Log::vlog(int level, const char* fmt, va_list va) const
 {
   if(level>m_level) return;
-  vsyslog(level, fmt, va);
+
+  if(!s_writer.running()) {
+    va_list vc;
+    va_copy(vc, va);
+    vsyslog(level, fmt, va);
+    fprintf(stdout, "[%d] ", level);
+    vfprintf(stdout, fmt, vc);
+    fflush(stdout);
+    va_end(vc);
+    __sync_fetch_and_add(&s_writer.written, 1);
+    return;
+  }
+
+  // never blocks: a message is dropped when the ring is full.
+  LogRing* r = s_writer.ring();
+  uint32_t h = r->head;
+  if(h - r->tail>=LOG_RING_SLOTS) {
+    __sync_fetch_and_add(&s_writer.dropped, 1);
+    return;
+  }
+  va_list vc;
+  va_copy(vc, va);
+  LogRecord& rec = r->records[h % LOG_RING_SLOTS];
+  int len = vsnprintf(rec.text, sizeof(rec.text), fmt, va);
+  if(len<0) len = 0;
+  if(len<(int)sizeof(rec.text)) {
+    rec.level = level;
+    rec.size = len;
+    rec.more = false;
+    __sync_synchronize();
+    r->head = h + 1;
+    va_end(vc);
+    return;
+  }
+
+  // a long message takes as many records as it needs.
+  char buf[LOG_MESSAGE_MAX];
+  vsnprintf(buf, sizeof(buf), fmt, vc);
+  va_end(vc);
+  if(len>=(int)sizeof(buf)) {
+    __sync_fetch_and_add(&s_writer.truncated, 1);
+    len = sizeof(buf) - 1;
+    buf[len-1] = '\n';
+  }
+  uint32_t slots = (len + LOG_RECORD_SIZE - 1) / LOG_RECORD_SIZE;
+  if(h + slots - r->tail>LOG_RING_SLOTS) {
+    __sync_fetch_and_add(&s_writer.dropped, 1);
+    return;
+  }
+  for(uint32_t ai=0; ai<slots; ai++) {
+    LogRecord& part = r->records[(h + ai) % LOG_RING_SLOTS];
+    int off = ai * LOG_RECORD_SIZE;
+    part.level = level;
+    part.size = (len - off<LOG_RECORD_SIZE)? len - off: LOG_RECORD_SIZE;
+    part.more = (ai + 1<slots);
+    memcpy(part.text, buf + off, part.size);
+  }
+  __sync_synchronize();
+  r->head = h + slots;
 }
 
 
 void Log::operator() (int level, const char* fmt, ...) const
 {
-  va_list va;
+  if(level>m_level) return;
 
+  va_list va;
   va_start(va, fmt);
   vlog(level, fmt, va);
   va_end(va);
+}
 
-  fprintf(stdout, "[%d] ", level);
-  va_start(va, fmt);
-  vfprintf(stdout, fmt, va);
-  fflush(stdout);
-  va_end(va);
+
+void Log::start()
+{
+  s_writer.start();
+}
+
+
+void Log::stop()
+{
+  s_writer.stop();
+}
+
+
+uint64_t Log::written()
+{
+  return s_writer.written;
+}
+
+
+uint64_t Log::dropped()
+{
+  return s_writer.dropped;
+}
+
+
+uint64_t Log::truncated()
+{
+  return s_writer.truncated;
 }
 
 // vim: sw=2 sts=2 ts=4 expandtab :
@@ -19,10 +19,41 @@
 #define __INCLUDE_LOG_H__
 
 #include <stdio.h>
+#include <stdint.h>
 #include <stdarg.h>
 #include <syslog.h>
+#include <limits.h>
 
+#ifndef LOG_RING_SLOTS
+# define LOG_RING_SLOTS (256)
+#endif
 
+// A message longer than a record continues in the following slots of the ring.
+#ifndef LOG_RECORD_SIZE
+# define LOG_RECORD_SIZE (240)
+#endif
+
+// Longer messages are cut (and counted by truncated()). Room for a full path.
+#ifndef LOG_MESSAGE_MAX
+# define LOG_MESSAGE_MAX (PATH_MAX + 512)
+#endif
+
+#ifndef LOG_DRAIN_USEC
+# define LOG_DRAIN_USEC (10000)
+#endif
+
+// Messages less important than LOG_BUILD_LEVEL are compiled out by LOG().
+#ifndef LOG_BUILD_LEVEL
+# define LOG_BUILD_LEVEL (LOG_DEBUG+1)
+#endif
+
+// Arguments are evaluated only if the message is written.
+#define LOG(logger, level, ...) \
+  do { if(((level)<=LOG_BUILD_LEVEL) && (logger).enabled(level)) (logger)(level, __VA_ARGS__); } while(0)
+
+
+// Messages are formatted into a per-thread ring and written by a drainer thread
+// between start() and stop(). Otherwise they are written synchronously.
 class Log
 {
 public:
@@ -42,8 +73,14 @@ public:
   virtual ~Log();
   inline LOGLEVEL loglevel() const { return m_level; };
   inline void loglevel(LOGLEVEL level) { m_level = level; };
+  inline bool enabled(int level) const { return level<=m_level; };
   void vlog(int level, const char* fmt, va_list va) const __attribute__ ((__format__ (__printf__, 3, 0)));
   void operator() (int level, const char* fmt, ...) const __attribute__ ((__format__ (__printf__, 3, 4)));
+  static void start();
+  static void stop();
+  static uint64_t written();
+  static uint64_t dropped();
+  static uint64_t truncated();
 
 private:
   LOGLEVEL  m_level;
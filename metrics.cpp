@@ -0,0 +1,118 @@
+/*
+  Copyright 2010 Toshiyuki Terashita.
+
+  fuse-autohttpfs is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This software is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "metrics.h"
+#include "int64format.h"
+
+
+// MetricsBuffer class implements.
+MetricsBuffer::MetricsBuffer()
+{
+  m_buf.resize(METRICS_BUFFER_SIZE);
+  m_size = 0;
+}
+
+
+void MetricsBuffer::printf(const char* fmt, ...)
+{
+  for(;;) {
+    va_list va;
+    va_start(va, fmt);
+    size_t remain = m_buf.size() - m_size;
+    int n = vsnprintf(&m_buf[m_size], remain, fmt, va);
+    va_end(va);
+    if(n<0) return;
+    if((size_t)n<remain) {
+      m_size += n;
+      return;
+    }
+    m_buf.resize(m_buf.size() * 2);
+  }
+}
+
+
+void MetricsBuffer::family(const char* name, const char* type, const char* help)
+{
+  printf("# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+
+void MetricsBuffer::value(const char* name, const char* labels, uint64_t v)
+{
+  if(labels && labels[0]) {
+    printf("%s{%s} %"FINT64"u\n", name, labels, v);
+  } else {
+    printf("%s %"FINT64"u\n", name, v);
+  }
+}
+
+
+void MetricsBuffer::value(const char* name, const char* labels, double v)
+{
+  if(labels && labels[0]) {
+    printf("%s{%s} %.9g\n", name, labels, v);
+  } else {
+    printf("%s %.9g\n", name, v);
+  }
+}
+
+
+// buckets at powers of 4 of the unit. 'scale' converts recorded values to the unit.
+void MetricsBuffer::histogram(const char* name, const char* labels, const Histogram& h, double scale)
+{
+  char n[256], l[512];
+  const char* sep = (labels && labels[0])? ",": "";
+  if(labels==NULL) labels = "";
+
+  snprintf(n, sizeof(n), "%s_bucket", name);
+  uint64_t c = 0;
+  size_t i = 0;
+  for(uint64_t le=1; le<(1ULL<<HISTOGRAM_MAX_BITS); le<<=2) {
+    // buckets entirely below 'le'.
+    for(; (i<HISTOGRAM_BUCKETS) && (Histogram::upper(i)<le); i++) c += h.bucket(i);
+    snprintf(l, sizeof(l), "%s%sle=\"%.9g\"", labels, sep, le * scale);
+    value(n, l, c);
+  }
+  snprintf(l, sizeof(l), "%s%sle=\"+Inf\"", labels, sep);
+  value(n, l, h.count());
+  snprintf(n, sizeof(n), "%s_sum", name);
+  value(n, labels, h.sum() * scale);
+  snprintf(n, sizeof(n), "%s_count", name);
+  value(n, labels, h.count());
+}
+
+
+void MetricsBuffer::summary(const char* name, const char* labels, const Histogram& h, double scale)
+{
+  static const double quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+  char n[256], l[512];
+  const char* sep = (labels && labels[0])? ",": "";
+  if(labels==NULL) labels = "";
+
+  for(size_t q=0; q<sizeof(quantiles)/sizeof(quantiles[0]); q++) {
+    snprintf(l, sizeof(l), "%s%squantile=\"%g\"", labels, sep, quantiles[q]);
+    value(name, l, h.percentile(quantiles[q]) * scale);
+  }
+  snprintf(n, sizeof(n), "%s_sum", name);
+  value(n, labels, h.sum() * scale);
+  snprintf(n, sizeof(n), "%s_count", name);
+  value(n, labels, h.count());
+}
+
+// vim: sw=2 sts=2 ts=4 expandtab :
@@ -0,0 +1,55 @@
+/*
+  Copyright 2010 Toshiyuki Terashita.
+
+  fuse-autohttpfs is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This software is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __INCLUDE_METRICS_H__
+#define __INCLUDE_METRICS_H__
+
+#include <stdint.h>
+#include <stdarg.h>
+#include <vector>
+#include "latency.h"
+
+#ifndef METRICS_BUFFER_SIZE
+# define METRICS_BUFFER_SIZE (0x10000)
+#endif
+
+
+// Text in Prometheus exposition format.
+// The buffer is kept across clear() and grows only when a larger text is rendered.
+class MetricsBuffer
+{
+public:
+  MetricsBuffer();
+  inline void clear() { m_size = 0; };
+  inline const char* data() const { return &m_buf[0]; };
+  inline size_t size() const { return m_size; };
+  inline size_t capacity() const { return m_buf.size(); };
+  void printf(const char* fmt, ...) __attribute__ ((__format__ (__printf__, 2, 3)));
+  void family(const char* name, const char* type, const char* help);
+  void value(const char* name, const char* labels, uint64_t v);
+  void value(const char* name, const char* labels, double v);
+  void histogram(const char* name, const char* labels, const Histogram& h, double scale);
+  void summary(const char* name, const char* labels, const Histogram& h, double scale);
+
+private:
+  std::vector<char> m_buf;
+  size_t    m_size;
+};
+
+
+#endif // __INCLUDE_METRICS_H__
+// vim: sw=2 sts=2 ts=4 expandtab :
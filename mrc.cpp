@@ -0,0 +1,195 @@
+/*
+  Copyright 2010 Toshiyuki Terashita.
+
+  fuse-autohttpfs is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This software is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <algorithm>
+#include "mrc.h"
+#include "int64format.h"
+
+
+// MissRatioCurve class implements.
+MissRatioCurve::MissRatioCurve(size_t max_samples)
+{
+  pthread_mutex_init(&m_lock, NULL);
+  m_max = max_samples;
+  m_threshold = ~0ULL;
+  m_accesses = m_sampled = m_clock = 0;
+  m_tree.resize(max_samples*4 + 1);
+  m_distance.resize(HISTOGRAM_BUCKETS);
+  m_weight = 0;
+}
+
+
+MissRatioCurve::~MissRatioCurve()
+{
+  pthread_mutex_destroy(&m_lock);
+}
+
+
+// FNV-1a, mixed for the low bits.
+uint64_t MissRatioCurve::hash(const char* key)
+{
+  uint64_t h = 0xcbf29ce484222325ULL;
+  for(; *key; key++) {
+    h ^= (unsigned char)*key;
+    h *= 0x100000001b3ULL;
+  }
+  return mix(h);
+}
+
+
+void MissRatioCurve::sample(uint64_t h)
+{
+  pthread_mutex_lock(&m_lock);
+  {
+    if(h<m_threshold) {
+      double rate = rate_locked();
+      m_sampled++;
+      m_weight += 1 / rate;
+      if(m_clock+1>=m_tree.size()) compact();
+
+      std::map<uint64_t, uint64_t>::iterator it = m_last.find(h);
+      if(it==m_last.end()) {
+        it = m_last.insert(std::make_pair(h, 0)).first;
+      } else {
+        // distinct keys accessed since the last access.
+        uint64_t distance = count(m_clock) - count((*it).second);
+        m_distance[Histogram::index((uint64_t)(distance / rate))] += 1 / rate;
+        mark((*it).second, -1);
+      }
+      (*it).second = ++m_clock;
+      mark(m_clock, 1);
+
+      if(m_last.size()>m_max) {
+        std::map<uint64_t, uint64_t>::iterator last = --m_last.end();
+        mark((*last).second, -1);
+        m_threshold = (*last).first;
+        m_last.erase(last);
+      }
+    }
+  }
+  pthread_mutex_unlock(&m_lock);
+}
+
+
+// renumber live timestamps from 1 when the tree is full.
+void MissRatioCurve::compact()
+{
+  std::vector<std::pair<uint64_t, uint64_t> > order;
+  order.reserve(m_last.size());
+  std::map<uint64_t, uint64_t>::iterator it;
+  for(it=m_last.begin(); it!=m_last.end(); it++) order.push_back(std::make_pair((*it).second, (*it).first));
+  std::sort(order.begin(), order.end());
+
+  std::fill(m_tree.begin(), m_tree.end(), 0);
+  m_clock = 0;
+  for(size_t i=0; i<order.size(); i++) {
+    m_last[order[i].second] = ++m_clock;
+    mark(m_clock, 1);
+  }
+}
+
+
+void MissRatioCurve::mark(uint64_t ts, int delta)
+{
+  for(; ts<m_tree.size(); ts += ts & (~ts + 1)) m_tree[ts] += delta;
+}
+
+
+uint64_t MissRatioCurve::count(uint64_t ts)
+{
+  uint64_t n = 0;
+  for(; ts>0; ts -= ts & (~ts + 1)) n += m_tree[ts];
+  return n;
+}
+
+
+uint64_t MissRatioCurve::sampled()
+{
+  uint64_t n;
+  pthread_mutex_lock(&m_lock);
+  {
+    n = m_sampled;
+  }
+  pthread_mutex_unlock(&m_lock);
+  return n;
+}
+
+
+double MissRatioCurve::rate()
+{
+  double r;
+  pthread_mutex_lock(&m_lock);
+  {
+    r = rate_locked();
+  }
+  pthread_mutex_unlock(&m_lock);
+  return r;
+}
+
+
+// estimated reuses within 'size', over all accesses.
+// As SHARDS-adj, the difference between the actual and the estimated number
+// of accesses is credited to the smallest distance: it is mostly made by a
+// few hot keys which happened to be sampled or not.
+double MissRatioCurve::hit_ratio(uint64_t size)
+{
+  double hits = 0, total;
+  pthread_mutex_lock(&m_lock);
+  {
+    total = m_accesses;
+    if(size>0) hits = total - m_weight;
+    for(size_t i=0; i<HISTOGRAM_BUCKETS; i++) {
+      if(Histogram::lower(i)>=size) break;
+      if(Histogram::upper(i)<size) {
+        hits += m_distance[i];
+      } else {
+        // the bucket holding 'size': assume uniform in the bucket.
+        uint64_t width = Histogram::upper(i) - Histogram::lower(i) + 1;
+        hits += m_distance[i] * (size - Histogram::lower(i)) / width;
+      }
+    }
+  }
+  pthread_mutex_unlock(&m_lock);
+  if(total<=0) return 0.0;
+  double r = hits / total;
+  return (r<0)? 0.0: ((r>1)? 1.0: r);
+}
+
+
+// hit ratio for caches of 2^min_bits .. 2^max_bits keys of 'unit'.
+std::string MissRatioCurve::report(const char* name, uint64_t unit, int min_bits, int max_bits)
+{
+  char t[256];
+  pthread_mutex_lock(&m_lock);
+  {
+    snprintf(t, sizeof(t), "# %s: accesses=%"FINT64"u sampled=%"FINT64"u rate=%.6f keys=%"FSIZET"u\n",
+             name, accesses(), m_sampled, rate_locked(), m_last.size());
+  }
+  pthread_mutex_unlock(&m_lock);
+  std::string r = t;
+  snprintf(t, sizeof(t), "%-8s %14s %9s\n", "cache", (unit>1)? "size(bytes)": "size(entries)", "hit_ratio");
+  r += t;
+  for(int b=min_bits; b<=max_bits; b++) {
+    uint64_t size = 1ULL << b;
+    snprintf(t, sizeof(t), "%-8s %14"FINT64"u %9.4f\n", name, size*unit, hit_ratio(size));
+    r += t;
+  }
+  return r;
+}
+
+// vim: sw=2 sts=2 ts=4 expandtab :
@@ -0,0 +1,85 @@
+/*
+  Copyright 2010 Toshiyuki Terashita.
+
+  fuse-autohttpfs is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This software is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __INCLUDE_MRC_H__
+#define __INCLUDE_MRC_H__
+
+#include <stdint.h>
+#include <pthread.h>
+#include <string>
+#include <vector>
+#include <map>
+#include "latency.h"
+
+#ifndef MRC_SAMPLES
+# define MRC_SAMPLES  (8192)  // max keys tracked.
+#endif
+
+
+// Miss ratio curve of an LRU cache, estimated online by SHARDS.
+// A key is sampled when its hash is below a threshold, so that all accesses
+// of a sampled key are seen. The threshold is lowered to keep at most
+// 'max_samples' keys (the largest hash is dropped). Reuse distances of the
+// sampled stream are scaled by the sampling rate, and each sample stands for
+// 1/rate accesses of the time it was taken.
+class MissRatioCurve
+{
+public:
+  MissRatioCurve(size_t max_samples = MRC_SAMPLES);
+  virtual ~MissRatioCurve();
+  inline void access(const char* key) { access(hash(key)); };
+  inline void access(uint64_t h) {
+    __sync_fetch_and_add(&m_accesses, 1);
+    if(h<m_threshold) sample(h);
+  };
+  double hit_ratio(uint64_t size);  // for a cache of 'size' keys.
+  std::string report(const char* name, uint64_t unit, int min_bits, int max_bits);
+  inline uint64_t accesses() const { return m_accesses; };
+  uint64_t sampled();
+  double rate();
+
+  static uint64_t hash(const char* key);
+  inline static uint64_t mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+  };
+
+private:
+  pthread_mutex_t m_lock;
+  size_t    m_max;
+  volatile uint64_t m_threshold;
+  volatile uint64_t m_accesses;
+  uint64_t  m_sampled;
+  uint64_t  m_clock;        // timestamp of the last sampled access.
+  std::map<uint64_t, uint64_t> m_last;  // hash => timestamp.
+  std::vector<uint32_t> m_tree;         // Fenwick tree of live timestamps.
+  std::vector<double> m_distance;       // accesses per scaled reuse distance, by Histogram::index().
+  double    m_weight;       // accesses estimated from the samples.
+  void sample(uint64_t h);
+  void compact();
+  void mark(uint64_t ts, int delta);
+  uint64_t count(uint64_t ts);  // live timestamps in [1, ts].
+  inline double rate_locked() const { return (m_threshold>>11) / (double)(1ULL<<53); };
+};
+
+
+#endif // __INCLUDE_MRC_H__
+// vim: sw=2 sts=2 ts=4 expandtab :
@@ -0,0 +1,49 @@
+/*
+  Copyright 2010 Toshiyuki Terashita.
+
+  fuse-autohttpfs is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This software is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __INCLUDE_PROBES_H__
+#define __INCLUDE_PROBES_H__
+
+// USDT probes of provider 'autohttpfs' for perf/bpftrace/systemtap.
+// A probe is a nop instruction until a tracer attaches to it.
+// Without <sys/sdt.h> (systemtap-sdt-dev) they are compiled out and
+// their arguments are never evaluated.
+//
+//   fuse__entry   (const char* op, const char* path)
+//   fuse__return  (const char* op, const char* path, int result, uint64_t bytes, uint64_t nsec)
+//   cache__lookup (const char* path, int hit, int expired)
+//   cache__evict  (const char* path, int expired)
+//   http__start   (const char* method, const char* url)
+//   http__done    (const char* method, const char* url, int status, uint64_t bytes, uint64_t usec)
+//   attr__probe   (const char* path, int step, int status)  step 1:"path/" 2:"path" 3:without redirects
+//
+// e.g. bpftrace -e 'usdt:./autohttpfs:autohttpfs:http__done { @[str(arg0)] = hist(arg4); }'
+
+#ifdef HAVE_SYS_SDT_H
+# include <sys/sdt.h>
+# define PROBE2(name, a, b)             DTRACE_PROBE2(autohttpfs, name, a, b)
+# define PROBE3(name, a, b, c)          DTRACE_PROBE3(autohttpfs, name, a, b, c)
+# define PROBE5(name, a, b, c, d, e)    DTRACE_PROBE5(autohttpfs, name, a, b, c, d, e)
+#else
+# define PROBE2(name, a, b)             do { if(0) { (void)(a); (void)(b); } } while(0)
+# define PROBE3(name, a, b, c)          do { if(0) { (void)(a); (void)(b); (void)(c); } } while(0)
+# define PROBE5(name, a, b, c, d, e)    do { if(0) { (void)(a); (void)(b); (void)(c); (void)(d); (void)(e); } } while(0)
+#endif
+
+
+#endif // __INCLUDE_PROBES_H__
+// vim: sw=2 sts=2 ts=4 expandtab :
@@ -17,9 +17,14 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include "proc.h"
 #include "log.h"
 #include "context.h"
+#include "latency.h"
+#include "recorder.h"
+#include "trace.h"
+#include "capture.h"
 #include "int64format.h"
 
 
@@ -159,6 +164,26 @@ int Proc_CacheEntries::open(Log& logger, ProcAbstract*& self)
 
 
 
+// Proc_CacheStats class implements.
+int Proc_CacheStats::open(Log& logger, ProcAbstract*& self)
+{
+  UrlStatCacheStats st = AUTOHTTPFSCONTEXTS.remote_attr().cache().stats();
+  uint64_t lookups = st.hits + st.misses;
+  char t[1024];
+  snprintf(t, sizeof(t), "hits: %"FINT64"u\n" "misses: %"FINT64"u\n" "hit_ratio: %.3f\n" "expired: %"FINT64"u\n" \
+                         "inserts: %"FINT64"u\n" "updates: %"FINT64"u\n" "invalidated: %"FINT64"u\n" \
+                         "evicted_expired: %"FINT64"u\n" "evicted_capacity: %"FINT64"u\n" \
+                         "entries: %"FINT64"u\n" "live_dirs: %"FINT64"u\n" "live_files: %"FINT64"u\n" "bytes: %"FINT64"u\n",
+           st.hits, st.misses, (lookups>0)? (double)st.hits/lookups: 0.0, st.expired,
+           st.inserts, st.updates, st.invalidated, st.evicted_expired, st.evicted_capacity,
+           st.entries, st.live_dirs, st.live_files, st.bytes);
+  m_string = t;
+  self = this;
+  return 0;
+}
+
+
+
 // Proc_CacheExpire class implements.
 int Proc_CacheExpire::open(Log& logger, ProcAbstract*& self)
 {
@@ -203,6 +228,470 @@ int Proc_LogLevel::release(Log& logger)
 
 
 
+// Proc_PoolWorkers class implements.
+int Proc_PoolWorkers::open(Log& logger, ProcAbstract*& self)
+{
+  m_string = uint64_to_str(AUTOHTTPFSCONTEXTS.pool().workers());
+  self = this;
+  return 0;
+}
+
+
+
+// Proc_PoolStatus class implements.
+int Proc_PoolStatus::open(Log& logger, ProcAbstract*& self)
+{
+  WorkerPool& pool = AUTOHTTPFSCONTEXTS.pool();
+  char t[512];
+  snprintf(t, sizeof(t), "workers: %"FSIZET"u\n" "meta_reserved: %"FSIZET"u\n" "queue_max: %"FSIZET"u\n" \
+                         "queued: %"FINT64"u\n" "running: %"FINT64"u\n" \
+                         "submitted: %"FINT64"u\n" "stolen: %"FINT64"u\n" "blocked: %"FINT64"u\n" \
+                         "cancelled: %"FINT64"u\n",
+                         pool.workers(), pool.meta_reserved(), pool.queue_max(), pool.queued(), pool.running(),
+                         pool.submitted(), pool.stolen(), pool.blocked(), pool.cancelled());
+  m_string = t;
+  for(int p=0; p<WorkerPool::PRIORITIES; p++) {
+    WorkerPool::ClassStat cs = pool.class_stat((WorkerPool::PRIORITY)p);
+    snprintf(t, sizeof(t), "%s: limit=%"FINT64"u running=%"FINT64"u submitted=%"FINT64"u promoted=%"FINT64"u\n",
+             WorkerPool::priority_name((WorkerPool::PRIORITY)p), cs.limit, cs.running, cs.submitted, cs.promoted);
+    m_string += t;
+  }
+  self = this;
+  return 0;
+}
+
+
+
+// Proc_PoolLane class implements.
+int Proc_PoolLane::open(Log& logger, ProcAbstract*& self)
+{
+  WorkerPool::LaneStat ls = AUTOHTTPFSCONTEXTS.pool().lane_stat(m_lane);
+  uint64_t taken = ls.submitted - ls.queued;
+  char t[512];
+  snprintf(t, sizeof(t), "queued: %"FINT64"u\n" "running: %"FINT64"u\n" \
+                         "submitted: %"FINT64"u\n" "blocked: %"FINT64"u\n" \
+                         "wait_avg_usec: %"FINT64"u\n" "wait_max_usec: %"FINT64"u\n",
+                         ls.queued, ls.running, ls.submitted, ls.blocked,
+                         (taken>0)? ls.wait_usec/taken: 0, ls.wait_max_usec);
+  m_string = t;
+  self = this;
+  return 0;
+}
+
+
+// Proc_CacheContent class implements.
+int Proc_CacheContent::open(Log& logger, ProcAbstract*& self)
+{
+  ContentCache& cc = AUTOHTTPFSCONTEXTS.content();
+  char t[256];
+  snprintf(t, sizeof(t), "files: %"FINT64"u\n" "bytes: %"FINT64"u\n" "max_bytes: %"FINT64"u\n",
+           cc.files(), cc.bytes(), cc.max_bytes());
+  m_string = t;
+  self = this;
+  return 0;
+}
+
+
+// Proc_CacheMrc class implements.
+int Proc_CacheMrc::open(Log& logger, ProcAbstract*& self)
+{
+  // attribute cache: 16 .. 1M entries, content cache: 1 .. 64K blocks.
+  m_string = AUTOHTTPFSCONTEXTS.remote_attr().cache().mrc().report("attr", 1, 4, 20);
+  m_string += "\n";
+  m_string += AUTOHTTPFSCONTEXTS.content().mrc().report("content", CONTENTCACHE_BLOCK, 0, 16);
+  self = this;
+  return 0;
+}
+
+
+// Proc_StatsLatency class implements.
+int Proc_StatsLatency::open(Log& logger, ProcAbstract*& self)
+{
+  m_string = Latency::report();
+  self = this;
+  return 0;
+}
+
+
+// Proc_StatsHost class implements.
+int Proc_StatsHost::open(Log& logger, ProcAbstract*& self)
+{
+  m_string = m_stat->report();
+  self = this;
+  return 0;
+}
+
+
+
+// Proc_StatsHosts class implements.
+Proc_StatsHosts::Proc_StatsHosts(const Proc_Dir& root, const char* path): Proc_Dir(root, path)
+{
+  pthread_mutex_init(&m_lock, NULL);
+}
+
+
+Proc_StatsHosts::~Proc_StatsHosts()
+{
+  std::map<std::string, Proc_StatsHost*>::iterator it;
+  for(it=m_hosts.begin(); it!=m_hosts.end(); it++) delete (*it).second;
+  pthread_mutex_destroy(&m_lock);
+}
+
+
+int Proc_StatsHosts::readdir(Log& logger, void *buf, fuse_fill_dir_t filler, off_t offset)
+{
+  std::vector<std::string> hosts = HostStats::hosts();
+  std::vector<std::string>::iterator it;
+  for(it = hosts.begin(); it!=hosts.end(); it++) {
+    filler(buf, (*it).c_str(), NULL, 0);
+  }
+  return 0;
+}
+
+
+ProcAbstract* Proc_StatsHosts::lookup(Log& logger, const std::string& name)
+{
+  HostStat* hs = HostStats::find(name);
+  if(hs==NULL) return NULL;
+
+  Proc_StatsHost* proc = NULL;
+  pthread_mutex_lock(&m_lock);
+  {
+    std::map<std::string, Proc_StatsHost*>::iterator it = m_hosts.find(name);
+    if(it==m_hosts.end()) {
+      proc = new Proc_StatsHost(hs);
+      m_hosts.insert(std::map<std::string, Proc_StatsHost*>::value_type(name, proc));
+    } else {
+      proc = (*it).second;
+    }
+  }
+  pthread_mutex_unlock(&m_lock);
+  return proc;
+}
+
+
+// Proc_DebugRecorder class implements.
+int Proc_DebugRecorder::open(Log& logger, ProcAbstract*& self)
+{
+  m_string = Recorder::dump(m_ring);
+  self = this;
+  return 0;
+}
+
+
+
+// Proc_DebugSlowMsec class implements.
+int Proc_DebugSlowMsec::open(Log& logger, ProcAbstract*& self)
+{
+  m_string = uint64_to_str(Recorder::slow_msec());
+  m_wrote = 0;
+  self = this;
+  return 0;
+}
+
+
+int Proc_DebugSlowMsec::release(Log& logger)
+{
+  if(m_wrote) {
+    int64_t msec = strtoll(m_string.c_str(), NULL, 10);
+    if(msec<0) msec = 0;
+    Recorder::slow_msec(msec);
+    logger(Log::NOTE, "Set debug::slow_msec to %"FINT64"d\n", msec);
+  }
+  Proc_StringStream::release(logger);
+  return 0;
+}
+
+
+
+// Proc_DebugTrace class implements.
+int Proc_DebugTrace::open(Log& logger, ProcAbstract*& self)
+{
+  m_string = uint64_to_str(Trace::enabled());
+  m_wrote = 0;
+  self = this;
+  return 0;
+}
+
+
+int Proc_DebugTrace::release(Log& logger)
+{
+  if(m_wrote) {
+    if(strtol(m_string.c_str(), NULL, 10)) {
+      Trace::start();
+      logger(Log::NOTE, "Start tracing.\n");
+    } else {
+      Trace::stop();
+      logger(Log::NOTE, "Stop tracing: %"FINT64"u spans, %"FINT64"u dropped.\n", Trace::spans(), Trace::dropped());
+    }
+  }
+  Proc_StringStream::release(logger);
+  return 0;
+}
+
+
+
+// Proc_DebugCapture class implements.
+int Proc_DebugCapture::open(Log& logger, ProcAbstract*& self)
+{
+  m_string = Capture::status();
+  m_wrote = 0;
+  self = this;
+  return 0;
+}
+
+
+int Proc_DebugCapture::release(Log& logger)
+{
+  if(m_wrote) {
+    std::string file = m_string.substr(0, m_string.find_last_not_of("\r\n\t ")+1);
+    bool hashed = (file.compare(0, 5, "hash:")==0);
+    if(hashed) file.erase(0, 5);
+    if(file.empty() || (file=="0")) {
+      Capture::stop();
+      logger(Log::NOTE, "Stop capturing.\n");
+    } else {
+      int r = Capture::start(file.c_str(), hashed);
+      if(r==0) {
+        logger(Log::NOTE, "Start capturing into %s%s.\n", file.c_str(), hashed? " (hashed paths)": "");
+      } else {
+        logger(Log::WARN, "Capture::start(%s): %s\n", file.c_str(), strerror(-r));
+      }
+    }
+  }
+  Proc_StringStream::release(logger);
+  return 0;
+}
+
+
+
+// Proc_DebugTraceJson class implements.
+int Proc_DebugTraceJson::open(Log& logger, ProcAbstract*& self)
+{
+  m_string = Trace::json();
+  self = this;
+  return 0;
+}
+
+
+
+// Proc_Metrics class implements.
+Proc_Metrics::Proc_Metrics()
+{
+  pthread_mutex_init(&m_lock, NULL);
+}
+
+
+Proc_Metrics::~Proc_Metrics()
+{
+  pthread_mutex_destroy(&m_lock);
+}
+
+
+int Proc_Metrics::getattr(Log& logger, struct stat& stbuf)
+{
+  stbuf.st_mode = S_IFREG|S_IRUSR|S_IRGRP|S_IROTH;
+  stbuf.st_atime = stbuf.st_ctime = stbuf.st_mtime = time(NULL);
+  pthread_mutex_lock(&m_lock);
+  {
+    stbuf.st_size = m_buffer.size();
+  }
+  pthread_mutex_unlock(&m_lock);
+  return 0;
+}
+
+
+int Proc_Metrics::open(Log& logger, ProcAbstract*& self)
+{
+  pthread_mutex_lock(&m_lock);
+  {
+    render();
+  }
+  pthread_mutex_unlock(&m_lock);
+  self = this;
+  return 0;
+}
+
+
+int Proc_Metrics::read(Log& logger, char* buf, size_t size, off_t offset)
+{
+  pthread_mutex_lock(&m_lock);
+  {
+    if(m_buffer.size()<size+offset) {
+      size = ((off_t)m_buffer.size()>offset)? m_buffer.size()-offset: 0;
+    }
+    if(size>0) memcpy(buf, m_buffer.data()+offset, size);
+  }
+  pthread_mutex_unlock(&m_lock);
+  return size;
+}
+
+
+// Caller must hold m_lock.
+void Proc_Metrics::render()
+{
+  AutoHttpFsContexts& ctxs = AUTOHTTPFSCONTEXTS;
+  MetricsBuffer& m = m_buffer;
+  char l[256];
+  m.clear();
+
+  // fuse operations.
+  m.family("autohttpfs_fuse_op_duration_seconds", "histogram", "Latency of fuse operations.");
+  for(int o=0; o<Latency::OPS; o++) {
+    for(int p=0; p<Latency::PATHS; p++) {
+      snprintf(l, sizeof(l), "op=\"%s\",path=\"%s\"", Latency::op_name((Latency::OP)o), Latency::path_name((Latency::PATH)p));
+      m.histogram("autohttpfs_fuse_op_duration_seconds", l, Latency::merged((Latency::OP)o, (Latency::PATH)p), 1e-9);
+    }
+  }
+
+  // HTTP per host.
+  std::vector<std::string> hosts = HostStats::hosts();
+  std::vector<HostStat::Snapshot> hs(hosts.size());
+  for(size_t i=0; i<hosts.size(); i++) HostStats::find(hosts[i])->snapshot(hs[i]);
+  m.family("autohttpfs_http_requests_total", "counter", "HTTP requests per host.");
+  for(size_t i=0; i<hosts.size(); i++) {
+    snprintf(l, sizeof(l), "host=\"%s\"", hosts[i].c_str());
+    m.value("autohttpfs_http_requests_total", l, hs[i].requests);
+  }
+  m.family("autohttpfs_http_received_bytes_total", "counter", "Bytes received per host.");
+  for(size_t i=0; i<hosts.size(); i++) {
+    snprintf(l, sizeof(l), "host=\"%s\"", hosts[i].c_str());
+    m.value("autohttpfs_http_received_bytes_total", l, hs[i].bytes);
+  }
+  m.family("autohttpfs_http_connections_reused_total", "counter", "Requests on a reused connection per host.");
+  for(size_t i=0; i<hosts.size(); i++) {
+    snprintf(l, sizeof(l), "host=\"%s\"", hosts[i].c_str());
+    m.value("autohttpfs_http_connections_reused_total", l, hs[i].reused);
+  }
+  m.family("autohttpfs_http_responses_total", "counter", "HTTP responses per host and status class.");
+  for(size_t i=0; i<hosts.size(); i++) {
+    for(int c=0; c<6; c++) {
+      if(c==0) {
+        snprintf(l, sizeof(l), "host=\"%s\",class=\"none\"", hosts[i].c_str());
+      } else {
+        snprintf(l, sizeof(l), "host=\"%s\",class=\"%dxx\"", hosts[i].c_str(), c);
+      }
+      m.value("autohttpfs_http_responses_total", l, hs[i].status[c]);
+    }
+  }
+  m.family("autohttpfs_http_errors_total", "counter", "Failed transfers per host and CURLcode.");
+  for(size_t i=0; i<hosts.size(); i++) {
+    std::map<int, uint64_t>::iterator it;
+    for(it=hs[i].errors.begin(); it!=hs[i].errors.end(); it++) {
+      snprintf(l, sizeof(l), "host=\"%s\",code=\"%d\"", hosts[i].c_str(), (*it).first);
+      m.value("autohttpfs_http_errors_total", l, (*it).second);
+    }
+  }
+  m.family("autohttpfs_http_phase_seconds", "summary", "Time of HTTP transfer phases per host.");
+  for(size_t i=0; i<hosts.size(); i++) {
+    for(int p=0; p<HostStat::PHASES; p++) {
+      snprintf(l, sizeof(l), "host=\"%s\",phase=\"%s\"", hosts[i].c_str(), HostStat::phase_name((HostStat::PHASE)p));
+      m.summary("autohttpfs_http_phase_seconds", l, hs[i].phase[p], 1e-6);
+    }
+  }
+
+  // attribute cache.
+  UrlStatCache& cache = ctxs.remote_attr().cache();
+  UrlStatCacheStats cs = cache.stats();
+  m.family("autohttpfs_attr_cache_lookups_total", "counter", "Attribute cache lookups by result.");
+  m.value("autohttpfs_attr_cache_lookups_total", "result=\"hit\"", cs.hits);
+  m.value("autohttpfs_attr_cache_lookups_total", "result=\"miss\"", cs.misses - cs.expired);
+  m.value("autohttpfs_attr_cache_lookups_total", "result=\"expired\"", cs.expired);
+  m.family("autohttpfs_attr_cache_writes_total", "counter", "Attribute cache writes by kind.");
+  m.value("autohttpfs_attr_cache_writes_total", "kind=\"insert\"", cs.inserts);
+  m.value("autohttpfs_attr_cache_writes_total", "kind=\"update\"", cs.updates);
+  m.value("autohttpfs_attr_cache_writes_total", "kind=\"invalidate\"", cs.invalidated);
+  m.family("autohttpfs_attr_cache_evictions_total", "counter", "Attribute cache evictions by reason.");
+  m.value("autohttpfs_attr_cache_evictions_total", "reason=\"expired\"", cs.evicted_expired);
+  m.value("autohttpfs_attr_cache_evictions_total", "reason=\"capacity\"", cs.evicted_capacity);
+  m.family("autohttpfs_attr_cache_entries", "gauge", "Attribute cache entries by state.");
+  m.value("autohttpfs_attr_cache_entries", "state=\"dir\"", cs.live_dirs);
+  m.value("autohttpfs_attr_cache_entries", "state=\"file\"", cs.live_files);
+  m.value("autohttpfs_attr_cache_entries", "state=\"expired\"", cs.entries - cs.live_dirs - cs.live_files);
+  m.family("autohttpfs_attr_cache_bytes", "gauge", "Estimated memory of attribute cache entries.");
+  m.value("autohttpfs_attr_cache_bytes", NULL, cs.bytes);
+  m.family("autohttpfs_attr_cache_max_entries", "gauge", "Threshold to trim attribute cache entries.");
+  m.value("autohttpfs_attr_cache_max_entries", NULL, cache.max_entries());
+  m.family("autohttpfs_attr_cache_expire_seconds", "gauge", "Expiration of attribute cache entries.");
+  m.value("autohttpfs_attr_cache_expire_seconds", NULL, cache.expire());
+
+  // content cache.
+  ContentCache& cc = ctxs.content();
+  m.family("autohttpfs_content_cache_files", "gauge", "Files in the content cache.");
+  m.value("autohttpfs_content_cache_files", NULL, cc.files());
+  m.family("autohttpfs_content_cache_bytes", "gauge", "Bytes in the content cache.");
+  m.value("autohttpfs_content_cache_bytes", NULL, cc.bytes());
+  m.family("autohttpfs_content_cache_max_bytes", "gauge", "Limit of the content cache.");
+  m.value("autohttpfs_content_cache_max_bytes", NULL, cc.max_bytes());
+
+  // worker pool.
+  WorkerPool& pool = ctxs.pool();
+  m.family("autohttpfs_pool_workers", "gauge", "HTTP worker threads.");
+  m.value("autohttpfs_pool_workers", NULL, (uint64_t)pool.workers());
+  m.family("autohttpfs_pool_stolen_total", "counter", "Jobs stolen from other workers.");
+  m.value("autohttpfs_pool_stolen_total", NULL, pool.stolen());
+  m.family("autohttpfs_pool_cancelled_total", "counter", "Jobs cancelled before running.");
+  m.value("autohttpfs_pool_cancelled_total", NULL, pool.cancelled());
+  WorkerPool::LaneStat ls[WorkerPool::LANES];
+  for(int i=0; i<WorkerPool::LANES; i++) ls[i] = pool.lane_stat((WorkerPool::LANE)i);
+  m.family("autohttpfs_pool_queued", "gauge", "Jobs waiting for a worker per lane.");
+  for(int i=0; i<WorkerPool::LANES; i++) {
+    snprintf(l, sizeof(l), "lane=\"%s\"", WorkerPool::lane_name((WorkerPool::LANE)i));
+    m.value("autohttpfs_pool_queued", l, ls[i].queued);
+  }
+  m.family("autohttpfs_pool_running", "gauge", "Running jobs per lane.");
+  for(int i=0; i<WorkerPool::LANES; i++) {
+    snprintf(l, sizeof(l), "lane=\"%s\"", WorkerPool::lane_name((WorkerPool::LANE)i));
+    m.value("autohttpfs_pool_running", l, ls[i].running);
+  }
+  m.family("autohttpfs_pool_submitted_total", "counter", "Submitted jobs per lane.");
+  for(int i=0; i<WorkerPool::LANES; i++) {
+    snprintf(l, sizeof(l), "lane=\"%s\"", WorkerPool::lane_name((WorkerPool::LANE)i));
+    m.value("autohttpfs_pool_submitted_total", l, ls[i].submitted);
+  }
+  m.family("autohttpfs_pool_blocked_total", "counter", "Submissions blocked by queue_max per lane.");
+  for(int i=0; i<WorkerPool::LANES; i++) {
+    snprintf(l, sizeof(l), "lane=\"%s\"", WorkerPool::lane_name((WorkerPool::LANE)i));
+    m.value("autohttpfs_pool_blocked_total", l, ls[i].blocked);
+  }
+  m.family("autohttpfs_pool_wait_seconds_total", "counter", "Time jobs waited for a worker per lane.");
+  for(int i=0; i<WorkerPool::LANES; i++) {
+    snprintf(l, sizeof(l), "lane=\"%s\"", WorkerPool::lane_name((WorkerPool::LANE)i));
+    m.value("autohttpfs_pool_wait_seconds_total", l, ls[i].wait_usec * 1e-6);
+  }
+  m.family("autohttpfs_pool_class_running", "gauge", "Running jobs per priority class.");
+  for(int i=0; i<WorkerPool::PRIORITIES; i++) {
+    snprintf(l, sizeof(l), "class=\"%s\"", WorkerPool::priority_name((WorkerPool::PRIORITY)i));
+    m.value("autohttpfs_pool_class_running", l, pool.class_stat((WorkerPool::PRIORITY)i).running);
+  }
+  m.family("autohttpfs_pool_class_promoted_total", "counter", "Jobs promoted to a priority class.");
+  for(int i=0; i<WorkerPool::PRIORITIES; i++) {
+    snprintf(l, sizeof(l), "class=\"%s\"", WorkerPool::priority_name((WorkerPool::PRIORITY)i));
+    m.value("autohttpfs_pool_class_promoted_total", l, pool.class_stat((WorkerPool::PRIORITY)i).promoted);
+  }
+
+  // logger.
+  m.family("autohttpfs_log_messages_total", "counter", "Log messages written.");
+  m.value("autohttpfs_log_messages_total", NULL, Log::written());
+  m.family("autohttpfs_log_dropped_total", "counter", "Log messages dropped by a full ring.");
+  m.value("autohttpfs_log_dropped_total", NULL, Log::dropped());
+
+  // memory.
+  unsigned long vsize = 0, rss = 0;
+  FILE* fp = fopen("/proc/self/statm", "r");
+  if(fp) {
+    if(fscanf(fp, "%lu %lu", &vsize, &rss)!=2) vsize = rss = 0;
+    fclose(fp);
+  }
+  uint64_t page = sysconf(_SC_PAGESIZE);
+  m.family("process_virtual_memory_bytes", "gauge", "Virtual memory size in bytes.");
+  m.value("process_virtual_memory_bytes", NULL, (uint64_t)vsize * page);
+  m.family("process_resident_memory_bytes", "gauge", "Resident memory size in bytes.");
+  m.value("process_resident_memory_bytes", NULL, (uint64_t)rss * page);
+}
+
+
+
 // Proc_Benchmark class implements.
 int Proc_BenchmarkNull::getattr(Log& logger, struct stat& stbuf)
 {
@@ -25,9 +25,15 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <errno.h>
+#include <pthread.h>
 #include <string>
 #include <vector>
+#include <map>
 #include "log.h"
+#include "workerpool.h"
+#include "hoststats.h"
+#include "metrics.h"
+#include "recorder.h"
 
 
 // Base class of proc/ implements.
@@ -47,6 +53,7 @@ public:
   inline virtual int write(Log& logger, const char* buf, size_t size, off_t offset) { return -EINVAL; };
   inline virtual int flush(Log& logger, struct fuse_file_info* ffi) { return -EINVAL; };
   inline virtual int release(Log& logger) { return -EINVAL; };
+  inline virtual ProcAbstract* lookup(Log& logger, const std::string& name) { return NULL; };
   inline virtual const char* name() { return "ProcAbstract"; };
 };
 
@@ -98,7 +105,7 @@ public:
   inline virtual int truncate(Log& logger, off_t size) { m_string.resize(0); return 0; };
   virtual int write(Log& logger, const char* buf, size_t size, off_t offset);
   inline virtual int flush(Log& logger, struct fuse_file_info* ffi) {
-    logger(Log::DEBUG, "Proc_StringStreamIO::flush: ffi.flush = %d\n", ffi->flush);
+    LOG(logger, Log::DEBUG, "Proc_StringStreamIO::flush: ffi.flush = %d\n", ffi->flush);
     return 0;
   }
   inline virtual const char* name() { return "Proc_StringStreamIO"; };
@@ -129,6 +136,16 @@ public:
 };
 
 
+// Return counters of the attribute cache.
+class Proc_CacheStats: public Proc_StringStream
+{
+public:
+  inline Proc_CacheStats() {};
+  virtual int open(Log& logger, ProcAbstract*& self);
+  inline virtual const char* name() { return "Proc_CacheStats"; };
+};
+
+
 // Cache expire control.
 class Proc_CacheExpire: public Proc_StringStreamIO
 {
@@ -163,6 +180,174 @@ public:
 
 
 
+// Return worker pool size.
+class Proc_PoolWorkers: public Proc_StringStream
+{
+public:
+  inline Proc_PoolWorkers() {};
+  virtual int open(Log& logger, ProcAbstract*& self);
+  inline virtual const char* name() { return "Proc_PoolWorkers"; };
+};
+
+
+// Return worker pool status.
+class Proc_PoolStatus: public Proc_StringStream
+{
+public:
+  inline Proc_PoolStatus() {};
+  virtual int open(Log& logger, ProcAbstract*& self);
+  inline virtual const char* name() { return "Proc_PoolStatus"; };
+};
+
+
+// Return worker pool lane status.
+class Proc_PoolLane: public Proc_StringStream
+{
+public:
+  inline Proc_PoolLane(WorkerPool::LANE lane): m_lane(lane) {};
+  virtual int open(Log& logger, ProcAbstract*& self);
+  inline virtual const char* name() { return "Proc_PoolLane"; };
+
+private:
+  WorkerPool::LANE m_lane;
+};
+
+
+// Return estimated hit ratio against cache size.
+class Proc_CacheMrc: public Proc_StringStream
+{
+public:
+  inline Proc_CacheMrc() {};
+  virtual int open(Log& logger, ProcAbstract*& self);
+  inline virtual const char* name() { return "Proc_CacheMrc"; };
+};
+
+
+// Return content cache status.
+class Proc_CacheContent: public Proc_StringStream
+{
+public:
+  inline Proc_CacheContent() {};
+  virtual int open(Log& logger, ProcAbstract*& self);
+  inline virtual const char* name() { return "Proc_CacheContent"; };
+};
+
+
+// Return latency of fuse operations.
+class Proc_StatsLatency: public Proc_StringStream
+{
+public:
+  inline Proc_StatsLatency() {};
+  virtual int open(Log& logger, ProcAbstract*& self);
+  inline virtual const char* name() { return "Proc_StatsLatency"; };
+};
+
+
+// Return transfer statistics of a host.
+class Proc_StatsHost: public Proc_StringStream
+{
+public:
+  inline Proc_StatsHost(HostStat* hs): m_stat(hs) {};
+  virtual int open(Log& logger, ProcAbstract*& self);
+  inline virtual const char* name() { return "Proc_StatsHost"; };
+
+private:
+  HostStat* m_stat;
+};
+
+
+// Directory of Proc_StatsHost, an entry per host requested so far.
+class Proc_StatsHosts: public Proc_Dir
+{
+public:
+  Proc_StatsHosts(const Proc_Dir& root, const char* path);
+  virtual ~Proc_StatsHosts();
+  virtual int readdir(Log& logger, void *buf, fuse_fill_dir_t filler, off_t offset);
+  virtual ProcAbstract* lookup(Log& logger, const std::string& name);
+  inline virtual const char* name() { return "Proc_StatsHosts"; };
+
+private:
+  pthread_mutex_t m_lock;
+  std::map<std::string, Proc_StatsHost*> m_hosts;
+};
+
+
+// Return entries of a flight recorder ring, oldest first.
+class Proc_DebugRecorder: public Proc_StringStream
+{
+public:
+  inline Proc_DebugRecorder(const RecorderRing& ring): m_ring(ring) {};
+  virtual int open(Log& logger, ProcAbstract*& self);
+  inline virtual const char* name() { return "Proc_DebugRecorder"; };
+
+private:
+  const RecorderRing& m_ring;
+};
+
+
+// Return/Set threshold of slow requests in msec, 0:disable.
+class Proc_DebugSlowMsec: public Proc_StringStreamIO
+{
+public:
+  inline Proc_DebugSlowMsec() {};
+  virtual int open(Log& logger, ProcAbstract*& self);
+  virtual int release(Log& logger);
+  inline virtual const char* name() { return "Proc_DebugSlowMsec"; };
+};
+
+
+// Start(1)/Stop(0) tracing. Starting discards the previous trace.
+class Proc_DebugTrace: public Proc_StringStreamIO
+{
+public:
+  inline Proc_DebugTrace() {};
+  virtual int open(Log& logger, ProcAbstract*& self);
+  virtual int release(Log& logger);
+  inline virtual const char* name() { return "Proc_DebugTrace"; };
+};
+
+
+// Start capturing fuse operations into FILE ("FILE" or "hash:FILE"), or stop it ("0").
+class Proc_DebugCapture: public Proc_StringStreamIO
+{
+public:
+  inline Proc_DebugCapture() {};
+  virtual int open(Log& logger, ProcAbstract*& self);
+  virtual int release(Log& logger);
+  inline virtual const char* name() { return "Proc_DebugCapture"; };
+};
+
+
+// Return the trace in Chrome trace-event format.
+class Proc_DebugTraceJson: public Proc_StringStream
+{
+public:
+  inline Proc_DebugTraceJson() {};
+  virtual int open(Log& logger, ProcAbstract*& self);
+  inline virtual const char* name() { return "Proc_DebugTraceJson"; };
+};
+
+
+// Return all counters in Prometheus exposition format.
+class Proc_Metrics: public ProcAbstract
+{
+public:
+  Proc_Metrics();
+  virtual ~Proc_Metrics();
+  virtual int getattr(Log& logger, struct stat& stbuf);
+  virtual int open(Log& logger, ProcAbstract*& self);
+  virtual int read(Log& logger, char* buf, size_t size, off_t offset);
+  inline virtual int release(Log& logger) { return 0; };
+  inline virtual const char* name() { return "Proc_Metrics"; };
+
+private:
+  pthread_mutex_t m_lock;
+  MetricsBuffer m_buffer;
+  void render();
+};
+
+
+
 class Proc_BenchmarkNull: public ProcAbstract
 {
 public:
@@ -25,12 +25,26 @@
 
 // class AutoHttpFsProc implements.
 
+// static entries, or dynamic ones of their parent directory.
+ProcAbstract* AutoHttpFsProc::find(Log& logger, const char* path)
+{
+  ProcMap::iterator it = m_procs.find(path);
+  if(it!=m_procs.end()) return (*it).second;
+
+  const char* base = strrchr(path, '/');
+  if((base==NULL) || (base==path)) return NULL;
+  it = m_procs.find(std::string(path, base-path));
+  if(it==m_procs.end()) return NULL;
+  return (*it).second->lookup(logger, base+1);
+}
+
+
 // proc::getattr
 int AutoHttpFsProc::getattr(Log& logger, const char* path, struct stat& stbuf)
 {
-  ProcMap::iterator it = m_procs.find(path);
-  if(it==m_procs.end()) return -ENOENT;
-  logger(Log::DEBUG, "--> AutoHttpFsProc::getattr(%s) => %s\n", path, (*it).second->name());
+  ProcAbstract* entry = find(logger, path);
+  if(entry==NULL) return -ENOENT;
+  LOG(logger, Log::DEBUG, "--> AutoHttpFsProc::getattr(%s) => %s\n", path, entry->name());
 
   stbuf.st_dev = 0;
   stbuf.st_ino = 0;
@@ -39,8 +53,8 @@ int AutoHttpFsProc::getattr(Log& logger, const char* path, struct stat& stbuf)
   stbuf.st_gid = getegid();
 
   ProcAbstract* proc = NULL;
-  int o = (*it).second->open(logger, proc);
-  int r = (*it).second->getattr(logger, stbuf);
+  int o = entry->open(logger, proc);
+  int r = entry->getattr(logger, stbuf);
   if(o==0) proc->release(logger);
   return r;
 }
@@ -49,17 +63,17 @@ int AutoHttpFsProc::getattr(Log& logger, const char* path, struct stat& stbuf)
 // proc::opendir
 int AutoHttpFsProc::opendir(Log& logger, const char* path, struct fuse_file_info& ffi)
 {
-  ProcMap::iterator it = m_procs.find(path);
-  if(it==m_procs.end()) return -ENOENT;
-  logger(Log::DEBUG, "--> AutoHttpFsProc::opendir(%s) => %s\n", path, (*it).second->name());
+  ProcAbstract* entry = find(logger, path);
+  if(entry==NULL) return -ENOENT;
+  LOG(logger, Log::DEBUG, "--> AutoHttpFsProc::opendir(%s) => %s\n", path, entry->name());
 
   ProcAbstract* proc = NULL;
-  int r = (*it).second->opendir(logger, proc);
+  int r = entry->opendir(logger, proc);
   if(r==0) {
     AutoHttpFsContext* ctx = AUTOHTTPFSCONTEXTS.alloc_context();
     ctx->proc = proc;
     ffi.fh = ctx->seq();
-    logger(Log::DEBUG, "   => fh=%"FINT64"d, ctx=%p, proc=%p\n", ffi.fh, ctx, proc);
+    LOG(logger, Log::DEBUG, "   => fh=%"FINT64"d, ctx=%p, proc=%p\n", ffi.fh, ctx, proc);
   }
   return r;
 }
@@ -68,28 +82,28 @@ int AutoHttpFsProc::opendir(Log& logger, const char* path, struct fuse_file_info
 // proc::truncate
 int AutoHttpFsProc::truncate(Log& logger, const char* path, off_t size)
 {
-  ProcMap::iterator it = m_procs.find(path);
-  if(it==m_procs.end()) return -ENOENT;
-  logger(Log::DEBUG, "--> AutoHttpFsProc::truncate(%s) => %s\n", path, (*it).second->name());
+  ProcAbstract* entry = find(logger, path);
+  if(entry==NULL) return -ENOENT;
+  LOG(logger, Log::DEBUG, "--> AutoHttpFsProc::truncate(%s) => %s\n", path, entry->name());
 
-  return (*it).second->truncate(logger, size);
+  return entry->truncate(logger, size);
 }
 
 
 // proc::open
 int AutoHttpFsProc::open(Log& logger, const char* path, struct fuse_file_info& ffi)
 {
-  ProcMap::iterator it = m_procs.find(path);
-  if(it==m_procs.end()) return -ENOENT;
-  logger(Log::DEBUG, "--> AutoHttpFsProc::open(%s) => %s\n", path, (*it).second->name());
+  ProcAbstract* entry = find(logger, path);
+  if(entry==NULL) return -ENOENT;
+  LOG(logger, Log::DEBUG, "--> AutoHttpFsProc::open(%s) => %s\n", path, entry->name());
 
   ProcAbstract* proc = NULL;
-  int r = (*it).second->open(logger, proc);
+  int r = entry->open(logger, proc);
   if(r==0) {
     AutoHttpFsContext* ctx = AUTOHTTPFSCONTEXTS.alloc_context();
     ctx->proc = proc;
     ffi.fh = ctx->seq();
-    logger(Log::DEBUG, "   => fh=%"FINT64"d, ctx=%p, proc=%p\n", ffi.fh, ctx, proc);
+    LOG(logger, Log::DEBUG, "   => fh=%"FINT64"d, ctx=%p, proc=%p\n", ffi.fh, ctx, proc);
   }
   return r;
 }
@@ -98,7 +112,7 @@ int AutoHttpFsProc::open(Log& logger, const char* path, struct fuse_file_info& f
 // initialize proc/ entries.
 void AutoHttpFsProc::init()
 {
-  Proc_Dir *root, *cache, *bench;
+  Proc_Dir *root, *cache, *bench, *pool, *stats, *debug;
   mount(".proc", root = new Proc_Dir("/.proc"));
   mount("benchmark", bench = new Proc_Dir(*root, "/benchmark"), root);
   mount("4GB.null", new Proc_BenchmarkNull(4ULL*1024*1024*1024), bench);
@@ -106,9 +120,28 @@ void AutoHttpFsProc::init()
   mount("cache", cache = new Proc_Dir(*root, "/cache"), root);
   mount("enable", new Proc_CacheEnable(), cache);
   mount("entries", new Proc_CacheEntries(), cache);
+  mount("stats", new Proc_CacheStats(), cache);
   mount("max_entries", new Proc_CacheMaxEntries(), cache);
   mount("expire", new Proc_CacheExpire(), cache);
+  mount("content", new Proc_CacheContent(), cache);
+  mount("mrc", new Proc_CacheMrc(), cache);
   mount("loglevel", new Proc_LogLevel(), cache);
+  mount("pool", pool = new Proc_Dir(*root, "/pool"), root);
+  mount("workers", new Proc_PoolWorkers(), pool);
+  mount("status", new Proc_PoolStatus(), pool);
+  mount("meta", new Proc_PoolLane(WorkerPool::META), pool);
+  mount("data", new Proc_PoolLane(WorkerPool::DATA), pool);
+  mount("metrics", new Proc_Metrics(), root);
+  mount("stats", stats = new Proc_Dir(*root, "/stats"), root);
+  mount("latency", new Proc_StatsLatency(), stats);
+  mount("hosts", new Proc_StatsHosts(*stats, "/hosts"), stats);
+  mount("debug", debug = new Proc_Dir(*root, "/debug"), root);
+  mount("recent", new Proc_DebugRecorder(Recorder::recent()), debug);
+  mount("slow", new Proc_DebugRecorder(Recorder::slow()), debug);
+  mount("slow_msec", new Proc_DebugSlowMsec(), debug);
+  mount("trace", new Proc_DebugTrace(), debug);
+  mount("trace.json", new Proc_DebugTraceJson(), debug);
+  mount("capture", new Proc_DebugCapture(), debug);
 }
 
 
@@ -40,6 +40,7 @@ public:
 
 private:
   ProcMap m_procs;
+  ProcAbstract* find(Log& logger, const char* path);
   void mount(const char* name, ProcAbstract* proc, Proc_Dir* base = NULL);
 };
 
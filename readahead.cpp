@@ -0,0 +1,211 @@
+/*
+  Copyright 2010 Toshiyuki Terashita.
+
+  fuse-autohttpfs is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This software is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include "readahead.h"
+#include "curlaccessor.h"
+#include "int64format.h"
+
+
+// ReadAheadJob class implements.
+ReadAheadJob::ReadAheadJob(Log& logger, const char* path, uint64_t offset, uint64_t size, ContentFile* cf): m_logger(logger)
+{
+  refs = 0;
+  m_path = path;
+  m_offset = offset;
+  m_size = size;
+  m_content = cf;
+  m_buffer = (cf==NULL)? new char[size]: NULL;
+  m_status = 0;
+  m_cancel = false;
+}
+
+
+ReadAheadJob::~ReadAheadJob()
+{
+  delete[] m_buffer;
+}
+
+
+void ReadAheadJob::run()
+{
+  if(m_content) {
+    m_status = (m_content->fetch(m_logger, m_offset, m_size, &m_cancel)==0)? 206: 0;
+    return;
+  }
+  CurlAccessor ca(m_path.c_str());
+  ca.abort_on(&m_cancel);
+  m_status = ca.get(m_logger, m_buffer, m_offset, m_size);
+}
+
+
+// buf==NULL: check the result only.
+bool ReadAheadJob::copy(char* buf, uint64_t offset, uint64_t size) const
+{
+  if((m_status!=200) && (m_status!=206)) return false;
+  if(buf==NULL) return true;
+  if(m_content) return (pread(m_content->fd(), buf, size, offset)==(ssize_t)size);
+  memcpy(buf, m_buffer + (offset - m_offset), size);
+  return true;
+}
+
+
+
+// ReadAhead class implements.
+ReadAhead::ReadAhead()
+{
+  pthread_mutex_init(&m_lock, NULL);
+  m_expect = 0;
+  m_ahead = 0;
+}
+
+
+ReadAhead::~ReadAhead()
+{
+  std::list<ReadAheadJob*>::iterator it;
+  for(it=m_jobs.begin(); it!=m_jobs.end(); it++) {
+    (*it)->wait();
+    delete (*it);
+  }
+  pthread_mutex_destroy(&m_lock);
+}
+
+
+// Serve [offset, offset+size) from readahead windows and schedule the next one.
+// Returns 0 if the range is not covered, -EINTR if the client is interrupted.
+int ReadAhead::read(Log& logger, WorkerPool& pool, const char* path, char* buf, size_t size, off_t offset,
+                    uint64_t length, uint64_t window, ContentFile* cf)
+{
+  ReadAheadJob* job = advance(logger, pool, path, size, offset, length, window, cf);
+  if(job==NULL) return 0;
+  return complete(pool, job, buf, size, offset);
+}
+
+
+// record a read of [offset, offset+size) and schedule the next window.
+// Returns the window covering the range, or NULL. It must be passed to complete() or release().
+ReadAheadJob* ReadAhead::advance(Log& logger, WorkerPool& pool, const char* path, size_t size, off_t offset,
+                                 uint64_t length, uint64_t window, ContentFile* cf)
+{
+  if((window==0) || (pool.workers()==0)) return NULL;
+
+  uint64_t end = offset + size;
+  ReadAheadJob* job = NULL;
+
+  pthread_mutex_lock(&m_lock);
+  {
+    std::list<ReadAheadJob*>::iterator it;
+    for(it=m_jobs.begin(); it!=m_jobs.end(); it++) {
+      if((*it)->covers(offset, size)) {
+        job = (*it);
+        job->refs++;
+        break;
+      }
+    }
+
+    bool sequential = (job!=NULL) || ((uint64_t)offset==m_expect);
+    m_expect = end;
+    if(!sequential) m_ahead = 0;
+    prune(offset, window);
+
+    // keep at least a half window ahead of the reader.
+    uint64_t from = (m_ahead>end)? m_ahead: end;
+    if(sequential && (from<length) && (from<end+window/2) && (m_jobs.size()<READAHEAD_MAX_JOBS)) {
+      uint64_t n = (from+window<length)? window: length-from;
+      // under m_lock, so it must not wait for a full DATA lane: the window is skipped then.
+      bool scheduled = true;
+      if((cf==NULL) || !cf->has(from, n)) {
+        ReadAheadJob* ra = new ReadAheadJob(logger, path, from, n, cf);
+        scheduled = pool.try_submit(ra, WorkerPool::DATA, WorkerPool::READAHEAD);
+        if(scheduled) {
+          m_jobs.push_back(ra);
+          LOG(logger, Log::VERBOSE, "   [ReadAhead::advance(%s)] schedule offset=%"FINT64"u, size=%"FINT64"u\n", path, from, n);
+        } else {
+          delete ra;
+        }
+      }
+      if(scheduled) m_ahead = from + n;
+    }
+  }
+  pthread_mutex_unlock(&m_lock);
+
+  return job;
+}
+
+
+// wait for the window and copy the range into 'buf' (NULL: not copied).
+// Returns 'size', 0 if the window failed, -EINTR if the client is interrupted.
+int ReadAhead::complete(WorkerPool& pool, ReadAheadJob* job, char* buf, size_t size, off_t offset)
+{
+  // a client is blocked on this range now.
+  if(!job->done()) pool.promote(job, WorkerPool::FOREGROUND);
+  bool interrupted = !pool.wait(job);
+  bool copied = !interrupted && job->copy(buf, offset, size);
+  release(job);
+
+  if(interrupted) return -EINTR;
+  return copied? size: 0;
+}
+
+
+void ReadAhead::release(ReadAheadJob* job)
+{
+  if(job==NULL) return;
+
+  pthread_mutex_lock(&m_lock);
+  {
+    job->refs--;
+  }
+  pthread_mutex_unlock(&m_lock);
+}
+
+
+// drop queued windows and abort running ones. They are freed by the destructor.
+void ReadAhead::cancel(Log& logger, WorkerPool& pool)
+{
+  pthread_mutex_lock(&m_lock);
+  {
+    std::list<ReadAheadJob*>::iterator it;
+    for(it=m_jobs.begin(); it!=m_jobs.end(); it++) {
+      if((*it)->done()) continue;
+      if(!pool.cancel(*it)) (*it)->cancel();
+      LOG(logger, Log::VERBOSE, "   [ReadAhead::cancel] offset=%"FINT64"u\n", (*it)->offset());
+    }
+    m_ahead = 0;
+  }
+  pthread_mutex_unlock(&m_lock);
+}
+
+
+// drop finished windows out of the reader's way. Caller must hold m_lock.
+void ReadAhead::prune(uint64_t offset, uint64_t window)
+{
+  std::list<ReadAheadJob*>::iterator it = m_jobs.begin();
+  while(it!=m_jobs.end()) {
+    ReadAheadJob* job = (*it);
+    if((job->refs==0) && job->done() && ((job->end()<=offset) || (job->offset()>=offset+window*2))) {
+      it = m_jobs.erase(it);
+      delete job;
+    } else {
+      it++;
+    }
+  }
+}
+
+// vim: sw=2 sts=2 ts=4 expandtab :
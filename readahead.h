@@ -0,0 +1,94 @@
+/*
+  Copyright 2010 Toshiyuki Terashita.
+
+  fuse-autohttpfs is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This software is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __INCLUDE_READAHEAD_H__
+#define __INCLUDE_READAHEAD_H__
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <pthread.h>
+#include <string>
+#include <list>
+#include "workerpool.h"
+#include "contentcache.h"
+#include "log.h"
+
+#ifndef READAHEAD_WINDOW
+# define READAHEAD_WINDOW (0x100000)
+#endif
+
+#ifndef READAHEAD_MAX_JOBS
+# define READAHEAD_MAX_JOBS (3)
+#endif
+
+
+// Ranged GET of the next window, run on WorkerPool with READAHEAD priority.
+// The window is stored into ContentFile if given, or into memory.
+class ReadAheadJob: public WorkerJob
+{
+public:
+  ReadAheadJob(Log& logger, const char* path, uint64_t offset, uint64_t size, ContentFile* cf = NULL);
+  virtual ~ReadAheadJob();
+  virtual void run();
+  inline uint64_t offset() const { return m_offset; };
+  inline uint64_t end() const { return m_offset + m_size; };
+  inline bool covers(uint64_t offset, uint64_t size) const {
+    return (m_offset<=offset) && (offset+size<=end());
+  };
+  bool copy(char* buf, uint64_t offset, uint64_t size) const;
+  inline void cancel() { m_cancel = true; };
+
+public:
+  int refs;   // readers waiting on this job. guarded by ReadAhead.
+
+private:
+  Log&  m_logger;
+  std::string m_path;
+  uint64_t m_offset;
+  uint64_t m_size;
+  char* m_buffer;
+  ContentFile* m_content;
+  int   m_status;
+  volatile bool m_cancel;
+};
+
+
+// Sequential readahead state of an opened file.
+class ReadAhead
+{
+public:
+  ReadAhead();
+  virtual ~ReadAhead();
+  int read(Log& logger, WorkerPool& pool, const char* path, char* buf, size_t size, off_t offset,
+           uint64_t length, uint64_t window, ContentFile* cf = NULL);
+  ReadAheadJob* advance(Log& logger, WorkerPool& pool, const char* path, size_t size, off_t offset,
+                        uint64_t length, uint64_t window, ContentFile* cf = NULL);
+  int complete(WorkerPool& pool, ReadAheadJob* job, char* buf, size_t size, off_t offset);
+  void release(ReadAheadJob* job);
+  void cancel(Log& logger, WorkerPool& pool);
+
+private:
+  pthread_mutex_t m_lock;
+  std::list<ReadAheadJob*> m_jobs;
+  uint64_t  m_expect;   // end of the last read.
+  uint64_t  m_ahead;    // end of the last scheduled window.
+  void prune(uint64_t offset, uint64_t window);
+};
+
+
+#endif // __INCLUDE_READAHEAD_H__
+// vim: sw=2 sts=2 ts=4 expandtab :
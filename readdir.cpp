@@ -0,0 +1,286 @@
+/*
+  Copyright 2010 Toshiyuki Terashita.
+
+  fuse-autohttpfs is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This software is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <errno.h>
+#include <time.h>
+#include "readdir.h"
+#include "latency.h"
+#include "int64format.h"
+
+
+// ReadDirJob class implements.
+volatile size_t ReadDirJob::s_streams = 0;
+
+
+ReadDirJob::ReadDirJob(Log& logger, const char* path, size_t queue_max, bool reserved): m_logger(logger)
+{
+  pthread_mutex_init(&m_lock, NULL);
+  pthread_cond_init(&m_cond, NULL);
+  m_path = path;
+  m_queue_max = queue_max;
+  m_base = 0;
+  m_queued = 0;
+  m_eof = false;
+  m_skip = false;
+  m_checked = false;
+  m_cancel = false;
+  m_reserved = reserved;
+}
+
+
+ReadDirJob::~ReadDirJob()
+{
+  unreserve();
+  while(!m_batches.empty()) {
+    delete m_batches.front();
+    m_batches.pop_front();
+  }
+  pthread_cond_destroy(&m_cond);
+  pthread_mutex_destroy(&m_lock);
+}
+
+
+void ReadDirJob::run()
+{
+  CurlAccessor ca(m_path.c_str(), true);
+  // servers without the binary listing answer text/json.
+  ca.add_header("Accept", DIRENT_BINARY_TYPE ", text/json;hash");
+  ca.abort_on(&m_cancel);
+  int r = ca.get(m_logger, *this);
+  std::string type = ca.content_type();
+  if((r==200) && !m_skip && ((type.compare(DIRENT_BINARY_TYPE)==0) || (type.compare("text/json")==0))) {
+    try { m_decoder.finish(); }
+    catch(std::string e) {
+      LOG(m_logger, Log::INFO, "Listing parse failed in %s - %s\n", __FUNCTION__, e.c_str());
+    }
+  }
+
+  pthread_mutex_lock(&m_lock);
+  {
+    m_eof = true;
+    pthread_cond_broadcast(&m_cond);
+  }
+  pthread_mutex_unlock(&m_lock);
+  unreserve();
+}
+
+
+// a chunk of the body, on the transfer's thread.
+bool ReadDirJob::write(CurlAccessor& ca, const char* ptr, size_t size)
+{
+  if(m_cancel) return false;
+  if(!m_checked) {
+    m_checked = true;
+    if(ca.content_type().compare(DIRENT_BINARY_TYPE)==0) m_decoder.format(DirentStream::BINARY);
+    m_skip = (ca.status()!=200) ||
+             ((m_decoder.format()!=DirentStream::BINARY) && (ca.content_type().compare("text/json")!=0));
+  }
+  if(m_skip) return true;
+
+  DirentList* batch = new DirentList();
+  try { m_decoder.feed(ptr, size, *batch); }
+  catch(std::string e) {
+    LOG(m_logger, Log::INFO, "Listing parse failed in %s - %s\n", __FUNCTION__, e.c_str());
+    m_skip = true;
+  }
+  if(batch->empty()) {
+    delete batch;
+    return true;
+  }
+
+  pthread_mutex_lock(&m_lock);
+  {
+    while((m_queue_max>0) && (m_queued>=m_queue_max) && !m_cancel) {
+      pthread_cond_wait(&m_cond, &m_lock);
+    }
+    if(!m_cancel) {
+      m_batches.push_back(batch);
+      m_queued += batch->size();
+      batch = NULL;
+      pthread_cond_broadcast(&m_cond);
+    }
+  }
+  pthread_mutex_unlock(&m_lock);
+
+  delete batch;
+  return !m_cancel;
+}
+
+
+// entry 'index' of the listing. entries before it are dropped.
+// Returns 1, 0 at the end of the listing, -EAGAIN if it has not arrived and 'wait' is false,
+// -ESPIPE if it has been dropped, or -EINTR if the client is interrupted.
+// 'name' is valid until the next call.
+int ReadDirJob::get(uint64_t index, bool wait, DirentList::Entry& entry, const char*& name)
+{
+  int result;
+  pthread_mutex_lock(&m_lock);
+  {
+    for(;;) {
+      drop(index);
+      if(index<m_base) {
+        result = -ESPIPE;
+        break;
+      }
+      if(index<m_base+m_queued) {
+        DirentList* batch = m_batches.front();
+        entry = (*batch)[index - m_base];
+        name = batch->name(index - m_base);
+        result = 1;
+        break;
+      }
+      if(m_eof) {
+        result = 0;
+        break;
+      }
+      if(!wait) {
+        result = -EAGAIN;
+        break;
+      }
+      // the client waits for the transfer: a miss of the readdir.
+      Latency::remote();
+
+      struct timespec ts;
+      clock_gettime(CLOCK_REALTIME, &ts);
+      ts.tv_nsec += WORKERPOOL_POLL_USEC * 1000;
+      if(ts.tv_nsec>=1000000000) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+      }
+      pthread_cond_timedwait(&m_cond, &m_lock, &ts);
+      if(WorkerPool::interrupted()) {
+        result = -EINTR;
+        break;
+      }
+    }
+  }
+  pthread_mutex_unlock(&m_lock);
+  return result;
+}
+
+
+// abort the transfer.
+void ReadDirJob::cancel()
+{
+  pthread_mutex_lock(&m_lock);
+  {
+    m_cancel = true;
+    pthread_cond_broadcast(&m_cond);
+  }
+  pthread_mutex_unlock(&m_lock);
+}
+
+
+// count a bounded transfer, which may keep its worker waiting for the reader.
+// Returns false if 'limit' of them are running. The job given 'reserved' releases it when it ends.
+bool ReadDirJob::reserve(size_t limit)
+{
+  for(;;) {
+    size_t n = s_streams;
+    if(n>=limit) return false;
+    if(__sync_bool_compare_and_swap(&s_streams, n, n+1)) return true;
+  }
+}
+
+
+void ReadDirJob::unreserve()
+{
+  if(!m_reserved) return;
+  m_reserved = false;
+  __sync_fetch_and_sub(&s_streams, 1);
+}
+
+
+// drop the batches before 'index'. Caller must hold m_lock.
+void ReadDirJob::drop(uint64_t index)
+{
+  bool dropped = false;
+  while(!m_batches.empty() && (m_base + m_batches.front()->size()<=index)) {
+    m_base += m_batches.front()->size();
+    m_queued -= m_batches.front()->size();
+    delete m_batches.front();
+    m_batches.pop_front();
+    dropped = true;
+  }
+  if(dropped) pthread_cond_broadcast(&m_cond);
+}
+
+
+
+// ReadDir class implements.
+ReadDir::ReadDir()
+{
+  m_job = NULL;
+}
+
+
+ReadDir::~ReadDir()
+{
+  if(m_job) {
+    m_job->cancel();
+    m_job->wait();
+    delete m_job;
+  }
+}
+
+
+// entry 'index' of the listing of 'path', from a transfer started by the first call.
+// The transfer is restarted when an entry before the queued ones is asked (rewinddir).
+int ReadDir::get(Log& logger, WorkerPool& pool, const char* path, uint64_t index, bool wait,
+                 DirentList::Entry& entry, const char*& name)
+{
+  if(m_job==NULL) start(logger, pool, path);
+  int r = m_job->get(index, wait, entry, name);
+  if(r!=-ESPIPE) return r;
+
+  LOG(logger, Log::VERBOSE, "   [ReadDir::get(%s)] restart for index=%"FINT64"u\n", path, index);
+  stop(pool);
+  start(logger, pool, path);
+  return m_job->get(index, wait, entry, name);
+}
+
+
+void ReadDir::cancel(WorkerPool& pool)
+{
+  if(m_job && !m_job->done() && !pool.cancel(m_job)) m_job->cancel();
+}
+
+
+void ReadDir::start(Log& logger, WorkerPool& pool, const char* path)
+{
+  // without workers the job runs on the caller, which must not wait for itself.
+  // a bounded transfer keeps a worker while the reader is slow, and the reader may need
+  // META workers for getattr: they are limited to a half of the reserved ones, so that
+  // the rest (and --workers=1) buffer the listing instead.
+  bool bounded = (pool.workers()>0) && ReadDirJob::reserve(pool.meta_reserved()/2);
+  m_job = new ReadDirJob(logger, path, bounded? READDIR_QUEUE_MAX: 0, bounded);
+  // the op which starts the transfer is a miss, even if the first entry is there before it waits.
+  Latency::remote();
+  pool.submit(m_job, WorkerPool::META, WorkerPool::FOREGROUND);
+}
+
+
+void ReadDir::stop(WorkerPool& pool)
+{
+  cancel(pool);
+  m_job->cancel();
+  m_job->wait();
+  delete m_job;
+  m_job = NULL;
+}
+
+// vim: sw=2 sts=2 ts=4 expandtab :
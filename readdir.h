@@ -0,0 +1,90 @@
+/*
+  Copyright 2010 Toshiyuki Terashita.
+
+  fuse-autohttpfs is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This software is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __INCLUDE_READDIR_H__
+#define __INCLUDE_READDIR_H__
+
+#include <stdint.h>
+#include <pthread.h>
+#include <string>
+#include <deque>
+#include "workerpool.h"
+#include "curlaccessor.h"
+#include "dirent.h"
+#include "log.h"
+
+#ifndef READDIR_QUEUE_MAX
+# define READDIR_QUEUE_MAX (4096)
+#endif
+
+
+// GET of a listing run on WorkerPool, decoded by DirentStream as the body arrives.
+// Entries are queued for readdir in batches of a chunk; the transfer waits while
+// 'queue_max' entries are queued (0: no limit), keeping a META worker while the reader is slow.
+// Such bounded transfers are limited by reserve(), the others buffer the whole listing.
+class ReadDirJob: public WorkerJob, public CurlBodyStream
+{
+public:
+  ReadDirJob(Log& logger, const char* path, size_t queue_max, bool reserved = false);
+  virtual ~ReadDirJob();
+  virtual void run();
+  virtual bool write(CurlAccessor& ca, const char* ptr, size_t size);
+  int get(uint64_t index, bool wait, DirentList::Entry& entry, const char*& name);
+  void cancel();
+  static bool reserve(size_t limit);
+  inline static size_t streams() { return s_streams; };
+
+private:
+  Log&  m_logger;
+  std::string m_path;
+  size_t    m_queue_max;
+  pthread_mutex_t m_lock;
+  pthread_cond_t  m_cond;
+  std::deque<DirentList*> m_batches;
+  uint64_t  m_base;     // index of the first entry of m_batches.
+  size_t    m_queued;   // entries in m_batches.
+  bool      m_eof;
+  bool      m_skip;     // not a listing, or a broken one: the rest of the body is ignored.
+  bool      m_checked;
+  volatile bool m_cancel;
+  DirentStream m_decoder;
+  bool      m_reserved; // counted in s_streams.
+  static volatile size_t s_streams;
+  void drop(uint64_t index);
+  void unreserve();
+};
+
+
+// Streamed listing of an opened directory.
+class ReadDir
+{
+public:
+  ReadDir();
+  virtual ~ReadDir();
+  int get(Log& logger, WorkerPool& pool, const char* path, uint64_t index, bool wait,
+          DirentList::Entry& entry, const char*& name);
+  void cancel(WorkerPool& pool);
+
+private:
+  ReadDirJob* m_job;
+  void start(Log& logger, WorkerPool& pool, const char* path);
+  void stop(WorkerPool& pool);
+};
+
+
+#endif // __INCLUDE_READDIR_H__
+// vim: sw=2 sts=2 ts=4 expandtab :
@@ -0,0 +1,141 @@
+/*
+  Copyright 2010 Toshiyuki Terashita.
+
+  fuse-autohttpfs is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This software is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/syscall.h>
+#include "recorder.h"
+#include "int64format.h"
+
+
+static __thread pid_t s_tid = 0;
+
+static pid_t gettid_cached()
+{
+  if(s_tid==0) s_tid = syscall(SYS_gettid);
+  return s_tid;
+}
+
+
+// RecorderEntry class implements.
+std::string RecorderEntry::str() const
+{
+  char t[32], buf[RECORDER_PATH+256];
+  time_t sec = time / 1000000;
+  struct tm tm;
+  localtime_r(&sec, &tm);
+  strftime(t, sizeof(t), "%Y-%m-%dT%H:%M:%S", &tm);
+  snprintf(buf, sizeof(buf), "%s.%06u tid=%d %s %-10s %s %10.3fms status=%d bytes=%"FINT64"u %s\n",
+           t, (unsigned)(time % 1000000), tid, (kind==FUSE)? "fuse": "http", name,
+           (kind==FUSE)? (miss? "miss": "hit "): "    ", nsec / 1000000.0, status, bytes, path);
+  return buf;
+}
+
+
+
+// RecorderRing class implements.
+RecorderRing::RecorderRing(size_t size)
+{
+  m_size = size;
+  m_next = 0;
+  m_entries = new RecorderEntry[size];
+  memset(m_entries, 0, sizeof(RecorderEntry)*size);
+}
+
+
+RecorderRing::~RecorderRing()
+{
+  delete[] m_entries;
+}
+
+
+void RecorderRing::push(RecorderEntry::KIND kind, const char* name, const char* path,
+                        uint64_t nsec, int status, uint64_t bytes, bool miss)
+{
+  uint64_t seq = __sync_add_and_fetch(&m_next, 1);
+  RecorderEntry& e = m_entries[(seq-1) % m_size];
+
+  e.seq = 0;
+  __sync_synchronize();
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  e.time = tv.tv_sec * 1000000ULL + tv.tv_usec;
+  e.nsec = nsec;
+  e.bytes = bytes;
+  e.status = status;
+  e.tid = gettid_cached();
+  e.kind = kind;
+  e.miss = miss;
+  e.name = name;
+  strncpy(e.path, path? path: "", RECORDER_PATH-1);
+  e.path[RECORDER_PATH-1] = '\0';
+  __sync_synchronize();
+  e.seq = seq;
+}
+
+
+void RecorderRing::snapshot(std::vector<RecorderEntry>& entries) const
+{
+  uint64_t last = m_next;
+  uint64_t first = (last>m_size)? last-m_size+1: 1;
+  entries.clear();
+  entries.reserve(last-first+1);
+  for(uint64_t seq=first; seq<=last; seq++) {
+    const RecorderEntry& e = m_entries[(seq-1) % m_size];
+    const volatile uint64_t& published = e.seq;
+    if(published!=seq) continue;  // being written, or overwritten already.
+    __sync_synchronize();
+    entries.push_back(e);
+    __sync_synchronize();
+    if(published!=seq) entries.pop_back();
+  }
+}
+
+
+
+// Recorder class implements.
+RecorderRing Recorder::s_recent(RECORDER_RECENT);
+RecorderRing Recorder::s_slow(RECORDER_SLOW);
+volatile uint64_t Recorder::s_slow_nsec = RECORDER_SLOW_MSEC * 1000000ULL;
+
+
+void Recorder::record(RecorderEntry::KIND kind, const char* name, const char* path,
+                      uint64_t nsec, int status, uint64_t bytes, bool miss)
+{
+  s_recent.push(kind, name, path, nsec, status, bytes, miss);
+  uint64_t slow = s_slow_nsec;
+  if((slow>0) && (nsec>=slow)) s_slow.push(kind, name, path, nsec, status, bytes, miss);
+}
+
+
+std::string Recorder::dump(const RecorderRing& ring)
+{
+  std::vector<RecorderEntry> entries;
+  ring.snapshot(entries);
+
+  char buf[128];
+  snprintf(buf, sizeof(buf), "# recorded=%"FINT64"u, shown=%"FSIZET"u, slow_msec=%"FINT64"u\n",
+           ring.pushed(), entries.size(), slow_msec());
+  std::string s = buf;
+  for(size_t i=0; i<entries.size(); i++) s += entries[i].str();
+  return s;
+}
+
+// vim: sw=2 sts=2 ts=4 expandtab :
@@ -0,0 +1,137 @@
+/*
+  Copyright 2010 Toshiyuki Terashita.
+
+  fuse-autohttpfs is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This software is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __INCLUDE_RECORDER_H__
+#define __INCLUDE_RECORDER_H__
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <string>
+#include <vector>
+#include "latency.h"
+#include "trace.h"
+#include "capture.h"
+#include "probes.h"
+
+#ifndef RECORDER_RECENT
+# define RECORDER_RECENT  (1024)  // entries of .proc/debug/recent
+#endif
+#ifndef RECORDER_SLOW
+# define RECORDER_SLOW    (256)   // entries of .proc/debug/slow
+#endif
+#ifndef RECORDER_SLOW_MSEC
+# define RECORDER_SLOW_MSEC (1000)
+#endif
+#define RECORDER_PATH     (128)   // longer paths are truncated.
+
+
+// A fuse operation or an HTTP request.
+class RecorderEntry
+{
+public:
+  typedef enum {
+    FUSE = 0,
+    HTTP,
+  } KIND;
+
+  uint64_t  seq;      // 0 while being written.
+  uint64_t  time;     // wall clock at the end, usec.
+  uint64_t  nsec;     // duration.
+  uint64_t  bytes;
+  int       status;   // return value of fuse op, HTTP status or -CURLcode.
+  pid_t     tid;
+  uint8_t   kind;
+  bool      miss;     // fuse op has performed an HTTP request.
+  const char* name;   // static string.
+  char      path[RECORDER_PATH];
+
+  std::string str() const;
+};
+
+
+// Fixed-size ring of the last entries.
+// A writer claims a slot by an atomic counter and never blocks; the slot is
+// published by its sequence number, so that readers skip torn ones.
+class RecorderRing
+{
+public:
+  RecorderRing(size_t size);
+  virtual ~RecorderRing();
+  void push(RecorderEntry::KIND kind, const char* name, const char* path,
+            uint64_t nsec, int status, uint64_t bytes, bool miss);
+  void snapshot(std::vector<RecorderEntry>& entries) const;  // oldest first.
+  inline uint64_t pushed() const { return m_next; };
+  inline size_t size() const { return m_size; };
+
+private:
+  RecorderEntry*  m_entries;
+  size_t          m_size;
+  volatile uint64_t m_next;
+};
+
+
+// Always-on flight recorder of the recent requests.
+// Requests taking slow_msec() or more are also kept in a separate ring.
+class Recorder
+{
+public:
+  static void record(RecorderEntry::KIND kind, const char* name, const char* path,
+                     uint64_t nsec, int status, uint64_t bytes, bool miss);
+  static std::string dump(const RecorderRing& ring);
+  inline static RecorderRing& recent() { return s_recent; };
+  inline static RecorderRing& slow() { return s_slow; };
+  inline static uint64_t slow_msec() { return s_slow_nsec / 1000000; };
+  inline static void slow_msec(uint64_t msec) { s_slow_nsec = msec * 1000000; };
+
+private:
+  static RecorderRing s_recent;
+  static RecorderRing s_slow;
+  static volatile uint64_t s_slow_nsec;   // 0: disabled.
+};
+
+
+// Times a fuse operation into Latency, Recorder, Trace and Capture.
+class OpRecord
+{
+public:
+  inline OpRecord(Latency::OP op, const char* path, uint64_t offset = 0, uint64_t size = 0):
+    m_timer(op), m_span("fuse", Latency::op_name(op), path), m_op(op), m_path(path),
+    m_offset(offset), m_size(size) {
+    PROBE2(fuse__entry, Latency::op_name(op), path);
+  };
+  inline int done(int r, uint64_t bytes = 0) {
+    uint64_t nsec = m_timer.elapsed();
+    PROBE5(fuse__return, Latency::op_name(m_op), m_path, r, bytes, nsec);
+    m_span.status(r);
+    m_span.bytes(bytes);
+    Recorder::record(RecorderEntry::FUSE, Latency::op_name(m_op), m_path, nsec, r, bytes, Latency::remoted());
+    if(Capture::enabled()) Capture::record(m_op, m_path, m_offset, m_size, r, nsec, Latency::remoted());
+    return r;
+  };
+
+private:
+  LatencyTimer  m_timer;
+  TraceSpan     m_span;
+  Latency::OP   m_op;
+  const char*   m_path;
+  uint64_t      m_offset;
+  uint64_t      m_size;
+};
+
+
+#endif // __INCLUDE_RECORDER_H__
+// vim: sw=2 sts=2 ts=4 expandtab :
@@ -19,6 +19,7 @@
 #include "remoteattr.h"
 #include "curlaccessor.h"
 #include "filestat.h"
+#include "probes.h"
 #include "ext/time_iso8601.h"
 
 
@@ -57,8 +58,8 @@ int RemoteAttr::get_attr(Log& logger, const char* path, UrlStat& stat)
 
   // check cache.
   if(m_cache.find(path, stat)) {
-    TimeIso8601 t(stat.mtime);
-    logger(Log::DEBUG, "   RemoteAttr::get_attr(%s:FIND): %05o %s\n", path, stat.mode, ((std::string)t).c_str());
+    LOG(logger, Log::DEBUG, "   RemoteAttr::get_attr(%s:FIND): %05o %s\n", path, stat.mode,
+        ((std::string)TimeIso8601(stat.mtime)).c_str());
     return 0;
   }
 
@@ -67,6 +68,7 @@ int RemoteAttr::get_attr(Log& logger, const char* path, UrlStat& stat)
     CurlAccessor ca(path, true);
     ca.add_header("Accept", "text/json");
     int res = ca.head(logger);
+    PROBE3(attr__probe, path, 1, res);
     if((res==200) || (res==403)) {
       // path should be directory.
       try{ store(stat, path, S_IFDIR, ca.x_filestat(), ca.content_length()); }
@@ -82,6 +84,7 @@ int RemoteAttr::get_attr(Log& logger, const char* path, UrlStat& stat)
     CurlAccessor ca(path);
     ca.add_header("Accept", "text/json");
     int res = ca.head(logger);
+    PROBE3(attr__probe, path, 2, res);
     if(res==200) {
       // path is regular file.
       try{ store(stat, path, S_IFREG, ca.x_filestat(), ca.content_length()); }
@@ -96,6 +99,7 @@ int RemoteAttr::get_attr(Log& logger, const char* path, UrlStat& stat)
   {
     CurlAccessor ca(path, false, false);
     int res = ca.head(logger);
+    PROBE3(attr__probe, path, 3, res);
     if(res==200) {
       // path is regular file.
       try{ store(stat, path, S_IFREG, ca.x_filestat(), ca.content_length()); }
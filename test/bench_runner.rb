@@ -0,0 +1,301 @@
+#!/usr/bin/env ruby
+# End-to-end benchmark: mounts autohttpfs against origin_server and runs workload profiles.
+#   $ (cd .. && make) && make origin_server
+#   $ ./bench_runner.rb [--profiles=seq_cold,ls_l] [--mount=DIR] [--port=N] [--output=FILE] [-- autohttpfs options]
+#
+# Each profile starts its own origin_server and a fresh mount (and content cache),
+# so that the first pass is cold. Reported per profile:
+#   ops, ops_per_sec, bytes, mb_per_sec, latency_ms (p50/p90/p99/max),
+#   http_requests_per_op, http_bytes_per_op (counted by the origin) and cpu_ms_per_op (of autohttpfs).
+
+require 'rubygems'
+require 'json'
+require 'fileutils'
+require 'tmpdir'
+require 'socket'
+require 'etc'
+require 'time'
+
+HERE = File.dirname(File.expand_path(__FILE__))
+MB = 1024*1024
+
+
+def now
+  Process.clock_gettime(Process::CLOCK_MONOTONIC)
+end
+
+
+# test/origin_server, one per profile.
+class Origin
+  attr_reader :port
+
+  def initialize(port, args)
+    @port = port
+    @pid = spawn("#{HERE}/origin_server", "--port=#{port}", *args, :err=>"/dev/null")
+    100.times {
+      begin
+        TCPSocket.new("127.0.0.1", port).close
+        return
+      rescue Errno::ECONNREFUSED
+        sleep 0.05
+      end
+    }
+    raise "origin_server did not start on #{port}"
+  end
+
+  def stats
+    s = TCPSocket.new("127.0.0.1", @port)
+    s.write("GET /.stats HTTP/1.0\r\n\r\n")
+    JSON.parse(s.read.split("\r\n\r\n", 2)[1])
+  ensure
+    s.close if s
+  end
+
+  def stop
+    Process.kill(:TERM, @pid)
+    Process.wait(@pid)
+  end
+end
+
+
+# autohttpfs in the foreground on 'dir', with a private content cache.
+class Mount
+  attr_reader :dir
+
+  def initialize(dir, opts)
+    @dir = dir
+    @cache = Dir.mktmpdir("bench_cache")
+    FileUtils.mkdir_p(dir)
+    @pid = spawn("#{HERE}/../autohttpfs", dir, "-f", "--cache_dir=#{@cache}", *opts,
+                 :out=>"/dev/null", :err=>"/dev/null")
+    200.times {
+      return if File.exist?("#{dir}/.proc")
+      sleep 0.05
+    }
+    stop
+    raise "autohttpfs did not mount #{dir}"
+  end
+
+  # user+system seconds of autohttpfs.
+  def cpu
+    f = File.read("/proc/#{@pid}/stat").split(") ", 2)[1].split(" ")
+    (f[11].to_i + f[12].to_i).to_f / Etc.sysconf(Etc::SC_CLK_TCK)
+  end
+
+  def stop
+    system("fusermount", "-u", @dir) || system("fusermount3", "-u", @dir) || system("umount", @dir)
+    Process.wait(@pid)
+    FileUtils.rm_rf(@cache)
+  end
+end
+
+
+# latencies and bytes of the measured operations.
+class Result
+  attr_reader :ops, :bytes
+  attr_accessor :extra
+
+  def initialize
+    @latency = []
+    @bytes = 0
+    @ops = 0
+    @extra = {}
+    @lock = Mutex.new
+  end
+
+  # measures the block as one operation, which returns the bytes transferred.
+  def op
+    s = now
+    n = yield
+    e = now
+    @lock.synchronize {
+      @latency << (e - s)
+      @bytes += n.to_i
+      @ops += 1
+    }
+  end
+
+  def percentile(p)
+    return 0 if @latency.empty?
+    @sorted ||= @latency.sort
+    @sorted[[(p * @sorted.size).ceil - 1, 0].max] * 1000
+  end
+
+  def to_h(sec)
+    {
+      "ops"=>@ops, "seconds"=>sec.round(3), "ops_per_sec"=>(@ops / sec).round(1),
+      "bytes"=>@bytes, "mb_per_sec"=>(@bytes / sec / MB).round(2),
+      "latency_ms"=>{
+        "p50"=>percentile(0.5).round(3), "p90"=>percentile(0.9).round(3),
+        "p99"=>percentile(0.99).round(3), "max"=>percentile(1.0).round(3) },
+    }.merge(@extra)
+  end
+end
+
+
+def read_all(path)
+  n = 0
+  File.open(path, "rb") {|io|
+    while b = io.read(MB)
+      n += b.size
+    end
+  }
+  n
+end
+
+
+def entries(dir)
+  Dir.children(dir).sort
+end
+
+
+# 'ls -l' of 'base', 3 times.
+def ls_l(base, r)
+  3.times {
+    r.op {
+      names = entries(base)
+      names.each {|n| File.lstat("#{base}/#{n}") }
+      r.extra["entries"] = names.size
+      0
+    }
+  }
+end
+
+
+# name => origin_server arguments, warmup and measured passes.
+PROFILES = {
+  # 64MB files read sequentially, on a fresh mount.
+  "seq_cold" => {
+    :origin=>%w{--fanout=0 --depth=0 --files=4 --size=67108864 --fixed_size},
+    :run=>lambda {|base, r|
+      4.times {|i| r.op { read_all("#{base}/f#{i}") } }
+    },
+  },
+  # the same after a first pass.
+  "seq_warm" => {
+    :origin=>%w{--fanout=0 --depth=0 --files=4 --size=67108864 --fixed_size},
+    :warmup=>lambda {|base| 4.times {|i| read_all("#{base}/f#{i}") } },
+    :run=>lambda {|base, r|
+      4.times {|i| r.op { read_all("#{base}/f#{i}") } }
+    },
+  },
+  # 4KiB preads at random offsets of 64MB files.
+  "random_4k" => {
+    :origin=>%w{--fanout=0 --depth=0 --files=4 --size=67108864 --fixed_size},
+    :run=>lambda {|base, r|
+      rnd = Random.new(1)
+      ios = (0...4).map {|i| File.open("#{base}/f#{i}", "rb") }
+      2000.times {
+        io = ios[rnd.rand(4)]
+        r.op { io.pread(4096, rnd.rand(16384) * 4096).size }
+      }
+      ios.each {|io| io.close }
+    },
+  },
+  # 'ls -l' of a directory of 100,000 files, 3 times.
+  "ls_l" => {
+    :origin=>%w{--fanout=0 --depth=0 --files=100000 --size=65536},
+    :run=>method(:ls_l),
+  },
+  # the same from a server without the binary listing, in text/json.
+  "ls_l_json" => {
+    :origin=>%w{--fanout=0 --depth=0 --files=100000 --size=65536 --no_binary},
+    :run=>method(:ls_l),
+  },
+  # 'find' of a tree: a readdir of each directory and a lstat of each entry.
+  "find" => {
+    :origin=>%w{--fanout=8 --depth=3 --files=20 --size=4096},
+    :run=>lambda {|base, r|
+      dirs = [base]
+      while dir = dirs.shift
+        names = nil
+        r.op { names = entries(dir); 0 }
+        names.each {|n|
+          st = nil
+          r.op { st = File.lstat("#{dir}/#{n}"); 0 }
+          dirs << "#{dir}/#{n}" if st.directory?
+        }
+      end
+    },
+  },
+  # cp of many small files.
+  "small_files" => {
+    :origin=>%w{--fanout=0 --depth=0 --files=2000 --size=16384},
+    :run=>lambda {|base, r|
+      2000.times {|i| r.op { IO.copy_stream("#{base}/f#{i}", "/dev/null") } }
+    },
+  },
+  # Apache-like: 16 threads of stat and read of popular files.
+  "apache" => {
+    :origin=>%w{--fanout=4 --depth=2 --files=200 --size=65536},
+    :run=>lambda {|base, r|
+      (0...16).map {|t|
+        Thread.new(Random.new(t+1)) {|rnd|
+          500.times {
+            # skewed towards the first files.
+            path = "#{base}/d#{rnd.rand(4)}/d#{rnd.rand(4)}/f#{(200 * rnd.rand**3).to_i}"
+            r.op {
+              File.stat(path)
+              read_all(path)
+            }
+          }
+        }
+      }.each {|th| th.join }
+    },
+  },
+}
+
+
+def run_profile(name, profile, mount_dir, port, opts)
+  origin = Origin.new(port, profile[:origin])
+  mount = Mount.new(mount_dir, opts)
+  begin
+    base = "#{mount_dir}/127.0.0.1:#{port}"
+    profile[:warmup].call(base) if profile[:warmup]
+    r = Result.new
+    st0, cpu0, t0 = origin.stats, mount.cpu, now
+    profile[:run].call(base, r)
+    sec, cpu, st = now - t0, mount.cpu - cpu0, origin.stats
+    ops = [r.ops, 1].max
+    { "profile"=>name }.merge(r.to_h(sec)).merge(
+      "http_requests_per_op"=>((st["requests"] - st0["requests"] - 1).to_f / ops).round(3),
+      "http_bytes_per_op"=>((st["bytes"] - st0["bytes"]).to_f / ops).round(1),
+      "cpu_ms_per_op"=>(cpu * 1000 / ops).round(4))
+  ensure
+    mount.stop
+    origin.stop
+  end
+end
+
+
+if $0==__FILE__
+  names = PROFILES.keys
+  mount_dir = "#{HERE}/tmp/bench"
+  port = 8124
+  output = nil
+  opts = []
+  while arg = ARGV.shift
+    case arg
+    when /^--profiles=(.*)/ then names = $1.split(",")
+    when /^--mount=(.*)/ then mount_dir = File.expand_path($1)
+    when /^--port=(\d+)/ then port = $1.to_i
+    when /^--output=(.*)/ then output = $1
+    when "--" then opts = ARGV.dup; ARGV.clear
+    else
+      STDERR.puts "usage: #{$0} [--profiles=#{PROFILES.keys.join(',')}] [--mount=DIR] [--port=N] [--output=FILE] [-- autohttpfs options]"
+      exit 1
+    end
+  end
+  unknown = names - PROFILES.keys
+  abort "unknown profiles: #{unknown.join(',')}" unless unknown.empty?
+
+  version = File.read("#{HERE}/../version.h")[/VERSION\s+"([^"]*)"/, 1]
+  results = names.map {|name|
+    STDERR.puts "Benchmark: #{name}"
+    run_profile(name, PROFILES[name], mount_dir, port, opts)
+  }
+  json = JSON.pretty_generate({
+    "bench"=>"bench_runner", "version"=>version, "date"=>Time.now.iso8601,
+    "options"=>opts, "results"=>results })
+  output ? File.write(output, json + "\n") : puts(json)
+end
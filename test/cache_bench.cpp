@@ -0,0 +1,253 @@
+// Throughput and latency of UrlStatCache from 1..N threads, in JSON.
+//   $ make cache_bench && ./cache_bench [--entries=N] [--ops=N] [--threads=1,2,4,8] [--workload=NAME]
+//
+// workloads:
+//   zipf       find of Zipfian(0.99) keys, add on a miss (as RemoteAttr::get_attr).
+//   zipf_miss  as zipf, 20% of finds are for keys never added (404).
+//   uniform    find of uniformly distributed keys, add on a miss.
+//   scan       each thread walks a key space twice the population, add on a miss.
+//   mixed      80% find, 10% update, 5% add of new keys, 5% remove; thread 0 trims.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "../cache.h"
+#include "../latency.h"
+#include "../int64format.h"
+
+typedef enum { FIND = 0, ADD, REMOVE, TRIM, KINDS } KIND;
+static const char* kind_names[] = { "find", "add", "remove", "trim" };
+static const char* workloads[] = { "zipf", "zipf_miss", "uniform", "scan", "mixed" };
+#define WORKLOADS (sizeof(workloads)/sizeof(workloads[0]))
+
+
+static size_t g_entries = 100000;
+static size_t g_ops = 50000;      // per thread.
+static std::vector<std::string> g_keys;     // population, and the same number of new keys.
+static std::vector<std::string> g_absent;   // never added.
+static std::vector<double> g_zipf;          // CDF over the population.
+
+
+// per thread xorshift64*.
+class Random
+{
+public:
+  inline Random(uint64_t seed): m_s(seed*0x9e3779b97f4a7c15ULL + 1) {};
+  inline uint64_t next() {
+    m_s ^= m_s >> 12;
+    m_s ^= m_s << 25;
+    m_s ^= m_s >> 27;
+    return m_s * 0x2545f4914f6cdd1dULL;
+  };
+  inline double uniform() { return (next() >> 11) / (double)(1ULL<<53); };
+  inline size_t zipf() {
+    return std::lower_bound(g_zipf.begin(), g_zipf.end(), uniform()) - g_zipf.begin();
+  };
+
+private:
+  uint64_t m_s;
+};
+
+
+class Worker
+{
+public:
+  int       id;
+  const char* workload;
+  UrlStatCache* cache;
+  Histogram hist[KINDS];
+  uint64_t  hits;
+  uint64_t  finds;
+  pthread_t thread;
+};
+
+
+static inline void timed_find(Worker* w, const char* path, bool add_on_miss)
+{
+  UrlStat us;
+  uint64_t s = Latency::now();
+  bool hit = w->cache->find(path, us);
+  uint64_t e = Latency::now();
+  w->hist[FIND].record(e - s);
+  w->finds++;
+  if(hit) {
+    w->hits++;
+  } else if(add_on_miss) {
+    w->cache->add(path, S_IFREG, 1024);
+    w->hist[ADD].record(Latency::now() - e);
+  }
+}
+
+
+static void* worker_main(void* ctx)
+{
+  Worker* w = (Worker*)ctx;
+  Random r(w->id + 1);
+  std::string wl = w->workload;
+  size_t scan = (g_entries * 2 / 16) * w->id;
+
+  for(size_t op=0; op<g_ops; op++) {
+    if(wl=="zipf") {
+      timed_find(w, g_keys[r.zipf()].c_str(), true);
+    } else if(wl=="zipf_miss") {
+      if(r.next()%100<20) {
+        timed_find(w, g_absent[r.next()%g_absent.size()].c_str(), false);
+      } else {
+        timed_find(w, g_keys[r.zipf()].c_str(), true);
+      }
+    } else if(wl=="uniform") {
+      timed_find(w, g_keys[r.next()%g_entries].c_str(), true);
+    } else if(wl=="scan") {
+      timed_find(w, g_keys[scan++ % g_keys.size()].c_str(), true);
+    } else {
+      uint64_t p = r.next() % 100;
+      uint64_t s = Latency::now();
+      if(p<80) {
+        timed_find(w, g_keys[r.zipf()].c_str(), false);
+      } else if(p<90) {
+        w->cache->add(g_keys[r.zipf()].c_str(), S_IFREG, 2048);
+        w->hist[ADD].record(Latency::now() - s);
+      } else if(p<95) {
+        w->cache->add(g_keys[g_entries + r.next()%g_entries].c_str(), S_IFREG, 4096);
+        w->hist[ADD].record(Latency::now() - s);
+      } else {
+        w->cache->remove(g_keys[r.next()%g_entries].c_str());
+        w->hist[REMOVE].record(Latency::now() - s);
+      }
+      if((w->id==0) && (op%1024==1023)) {
+        s = Latency::now();
+        w->cache->trim();
+        w->hist[TRIM].record(Latency::now() - s);
+      }
+    }
+  }
+  return NULL;
+}
+
+
+static std::string run(const char* workload, int threads)
+{
+  UrlStatCache* cache = new UrlStatCache();
+  cache->max_entries(g_entries);
+  cache->init();
+  for(size_t i=0; i<g_entries; i++) cache->add(g_keys[i].c_str(), S_IFREG, 1024);
+
+  std::vector<Worker> workers(threads);
+  uint64_t s = Latency::now();
+  for(int ai=0; ai<threads; ai++) {
+    workers[ai].id = ai;
+    workers[ai].workload = workload;
+    workers[ai].cache = cache;
+    workers[ai].hits = workers[ai].finds = 0;
+    pthread_create(&workers[ai].thread, NULL, worker_main, &workers[ai]);
+  }
+  for(int ai=0; ai<threads; ai++) pthread_join(workers[ai].thread, NULL);
+  double sec = (Latency::now() - s) / 1e9;
+
+  Histogram hist[KINDS];
+  uint64_t hits = 0, finds = 0, ops = 0;
+  for(int ai=0; ai<threads; ai++) {
+    for(int k=0; k<KINDS; k++) hist[k].merge(workers[ai].hist[k]);
+    hits += workers[ai].hits;
+    finds += workers[ai].finds;
+  }
+  for(int k=0; k<KINDS; k++) ops += hist[k].count();
+  UrlStatCacheStats st = cache->stats();
+  cache->stop();
+  delete cache;
+
+  char t[512];
+  snprintf(t, sizeof(t), "{\"workload\":\"%s\",\"threads\":%d,\"entries\":%"FSIZET"u,\"ops\":%"FINT64"u,"
+           "\"seconds\":%.3f,\"ops_per_sec\":%.0f,\"hit_ratio\":%.4f,\"final_entries\":%"FINT64"u,"
+           "\"evicted\":%"FINT64"u,\"latency_ns\":{",
+           workload, threads, g_entries, ops, sec, ops/sec, (finds>0)? (double)hits/finds: 0.0,
+           st.entries, st.evicted_expired + st.evicted_capacity);
+  std::string r = t;
+  bool first = true;
+  for(int k=0; k<KINDS; k++) {
+    if(hist[k].count()==0) continue;
+    snprintf(t, sizeof(t), "%s\"%s\":{\"count\":%"FINT64"u,\"mean\":%"FINT64"u,\"p50\":%"FINT64"u,\"p90\":%"FINT64"u,"
+             "\"p99\":%"FINT64"u,\"p999\":%"FINT64"u,\"max\":%"FINT64"u}",
+             first? "": ",", kind_names[k], hist[k].count(), hist[k].mean(), hist[k].percentile(0.5),
+             hist[k].percentile(0.9), hist[k].percentile(0.99), hist[k].percentile(0.999), hist[k].max());
+    r += t;
+    first = false;
+  }
+  r += "}}";
+  return r;
+}
+
+
+static void populate()
+{
+  char t[128];
+  g_keys.clear();
+  g_absent.clear();
+  for(size_t i=0; i<g_entries*2; i++) {
+    snprintf(t, sizeof(t), "/origin.example.com/dir%04"FSIZET"u/file%08"FSIZET"u.dat", i%997, i);
+    g_keys.push_back(t);
+  }
+  for(size_t i=0; i<g_entries/4+1; i++) {
+    snprintf(t, sizeof(t), "/origin.example.com/missing/%08"FSIZET"u", i);
+    g_absent.push_back(t);
+  }
+
+  // Zipf(0.99), key 0 is the most popular. Keys are shuffled against the map order.
+  g_zipf.resize(g_entries);
+  double sum = 0;
+  for(size_t i=0; i<g_entries; i++) sum += 1.0 / pow(i+1, 0.99);
+  double c = 0;
+  for(size_t i=0; i<g_entries; i++) {
+    c += 1.0 / pow(i+1, 0.99) / sum;
+    g_zipf[i] = c;
+  }
+  Random r(12345);
+  for(size_t i=g_entries-1; i>0; i--) std::swap(g_keys[i], g_keys[r.next()%(i+1)]);
+}
+
+
+int main(int argc, char* argv[])
+{
+  std::vector<int> threads;
+  std::string only;
+  for(int ai=1; ai<argc; ai++) {
+    if(strncmp(argv[ai], "--entries=", 10)==0) g_entries = atol(argv[ai]+10);
+    else if(strncmp(argv[ai], "--ops=", 6)==0) g_ops = atol(argv[ai]+6);
+    else if(strncmp(argv[ai], "--workload=", 11)==0) only = argv[ai]+11;
+    else if(strncmp(argv[ai], "--threads=", 10)==0) {
+      for(char* p=argv[ai]+10; *p; ) {
+        threads.push_back(strtol(p, &p, 10));
+        if(*p==',') p++;
+      }
+    } else {
+      fprintf(stderr, "usage: %s [--entries=N] [--ops=N] [--threads=1,2,4,8] [--workload=NAME]\n", argv[0]);
+      return 1;
+    }
+  }
+  if(threads.empty()) {
+    threads.push_back(1);
+    threads.push_back(2);
+    threads.push_back(4);
+    threads.push_back(8);
+  }
+  if(g_entries<16) g_entries = 16;
+  populate();
+
+  printf("{\"bench\":\"cache_bench\",\"entries\":%"FSIZET"u,\"ops_per_thread\":%"FSIZET"u,\"results\":[\n",
+         g_entries, g_ops);
+  bool first = true;
+  for(size_t w=0; w<WORKLOADS; w++) {
+    if(!only.empty() && (only!=workloads[w])) continue;
+    for(size_t t=0; t<threads.size(); t++) {
+      printf("%s%s", first? "": ",\n", run(workloads[w], threads[t]).c_str());
+      fflush(stdout);
+      first = false;
+    }
+  }
+  printf("\n]}\n");
+  return 0;
+}
@@ -0,0 +1,452 @@
+// Offline cache simulator: runs a capture (.proc/debug/capture) through caches of many sizes in one pass.
+//   $ make cache_sim && ./cache_sim [--attr=500,2000,8000,32000] [--content_mb=16,64,256,1024] [--expire=SEC] CAPTURE_FILE
+//
+// attribute caches, fed by getattr:
+//   urlstat    UrlStatCache itself: eviction in insertion order, expiration extended by hits.
+//   lru        proposed: least recently used.
+//   clock      proposed: CLOCK (second chance).
+//   tinylfu    proposed: LRU admitting a new entry only if it is more frequent than the victim
+//              (count-min sketch of 4bit counters, halved every 10*size accesses).
+//   All of them expire entries after --expire seconds (default CACHE_EXPIRES_SEC) on the capture's clock.
+//   A miss costs the HEAD requests of RemoteAttr::get_attr: 1 for a directory, 2 for a file and
+//   3 for a missing path, which is not cached.
+// content caches, fed by read:
+//   content    ContentCache itself: files evicted least recently used first, cached per CONTENTCACHE_BLOCK.
+//   block_lru  proposed: blocks evicted least recently used.
+//   A miss costs a GET of the blocks covering the read. Readahead is not simulated.
+// The length of a file is the largest end of its reads in the capture.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <string>
+#include <vector>
+#include <list>
+#include <map>
+#include <set>
+#include <algorithm>
+#include "../cache.h"
+#include "../contentcache.h"
+#include "../capture.h"
+#include "../latency.h"
+#include "../int64format.h"
+
+extern Log glog;
+
+
+class Access
+{
+public:
+  uint64_t  at;       // usec from the start of the capture.
+  uint8_t   op;
+  uint32_t  path;
+  int32_t   result;
+  uint64_t  offset;
+  uint32_t  size;
+};
+
+
+// Hits and estimated origin traffic of a cache configuration.
+class Outcome
+{
+public:
+  inline Outcome(const char* _cache, const char* _policy, uint64_t _size):
+    cache(_cache), policy(_policy), size(_size), accesses(0), hits(0), requests(0), bytes(0) {};
+  const char* cache;
+  const char* policy;
+  uint64_t  size;     // entries or bytes.
+  uint64_t  accesses;
+  uint64_t  hits;
+  uint64_t  requests;
+  uint64_t  bytes;
+};
+
+
+// A proposed policy over 64bit keys, with expiration.
+class Policy
+{
+public:
+  Policy(size_t size): m_size(size) {};
+  virtual ~Policy() {};
+  virtual bool find(uint64_t key, time_t now, time_t expire) = 0;  // extends the expiration on a hit.
+  virtual void add(uint64_t key, time_t now, time_t expire) = 0;
+
+protected:
+  size_t    m_size;
+};
+
+
+class LruPolicy: public Policy
+{
+public:
+  LruPolicy(size_t size): Policy(size) {};
+  virtual bool find(uint64_t key, time_t now, time_t expire) {
+    Index::iterator it = m_index.find(key);
+    if((it==m_index.end()) || ((*it).second.second<now)) return false;
+    m_lru.splice(m_lru.begin(), m_lru, (*it).second.first);
+    (*it).second.second = expire;
+    return true;
+  };
+  virtual void add(uint64_t key, time_t now, time_t expire) {
+    Index::iterator it = m_index.find(key);
+    if(it!=m_index.end()) {
+      m_lru.splice(m_lru.begin(), m_lru, (*it).second.first);
+      (*it).second.second = expire;
+      return;
+    }
+    if(!admit(key, now)) return;
+    if(m_index.size()>=m_size) evict();
+    m_lru.push_front(key);
+    m_index[key] = std::make_pair(m_lru.begin(), expire);
+  };
+
+protected:
+  typedef std::map<uint64_t, std::pair<std::list<uint64_t>::iterator, time_t> > Index;
+  std::list<uint64_t> m_lru;    // most recent first.
+  Index     m_index;
+  virtual bool admit(uint64_t key, time_t now) { return true; };
+  void evict() {
+    m_index.erase(m_lru.back());
+    m_lru.pop_back();
+  };
+};
+
+
+class ClockPolicy: public Policy
+{
+public:
+  ClockPolicy(size_t size): Policy(size), m_hand(0) {};
+  virtual bool find(uint64_t key, time_t now, time_t expire) {
+    std::map<uint64_t, size_t>::iterator it = m_index.find(key);
+    if((it==m_index.end()) || (m_slots[(*it).second].expire<now)) return false;
+    m_slots[(*it).second].ref = true;
+    m_slots[(*it).second].expire = expire;
+    return true;
+  };
+  virtual void add(uint64_t key, time_t now, time_t expire) {
+    std::map<uint64_t, size_t>::iterator it = m_index.find(key);
+    if(it!=m_index.end()) {
+      m_slots[(*it).second].expire = expire;
+      m_slots[(*it).second].ref = true;
+      return;
+    }
+    Slot s = { key, expire, false };
+    if(m_slots.size()<m_size) {
+      m_index[key] = m_slots.size();
+      m_slots.push_back(s);
+      return;
+    }
+    // second chance, expired ones first.
+    while(m_slots[m_hand].ref && (m_slots[m_hand].expire>=now)) {
+      m_slots[m_hand].ref = false;
+      m_hand = (m_hand + 1) % m_slots.size();
+    }
+    m_index.erase(m_slots[m_hand].key);
+    m_slots[m_hand] = s;
+    m_index[key] = m_hand;
+    m_hand = (m_hand + 1) % m_slots.size();
+  };
+
+private:
+  struct Slot {
+    uint64_t  key;
+    time_t    expire;
+    bool      ref;
+  };
+  std::vector<Slot> m_slots;
+  std::map<uint64_t, size_t> m_index;
+  size_t    m_hand;
+};
+
+
+class TinyLfuPolicy: public LruPolicy
+{
+public:
+  TinyLfuPolicy(size_t size): LruPolicy(size), m_samples(0) {
+    size_t width = 64;
+    while(width<size*4) width <<= 1;
+    m_sketch.resize(width * 4, 0);
+  };
+  virtual bool find(uint64_t key, time_t now, time_t expire) {
+    count(key);
+    return LruPolicy::find(key, now, expire);
+  };
+
+private:
+  std::vector<uint8_t> m_sketch;  // 4 rows.
+  uint64_t  m_samples;
+  inline size_t slot(uint64_t key, int row) const {
+    size_t width = m_sketch.size() / 4;
+    return row*width + (MissRatioCurve::mix(key + row*0x9e3779b97f4a7c15ULL) & (width-1));
+  };
+  void count(uint64_t key) {
+    for(int r=0; r<4; r++) {
+      uint8_t& c = m_sketch[slot(key, r)];
+      if(c<15) c++;
+    }
+    if(++m_samples>=m_size*10) {
+      for(size_t i=0; i<m_sketch.size(); i++) m_sketch[i] >>= 1;
+      m_samples /= 2;
+    }
+  };
+  uint8_t frequency(uint64_t key) const {
+    uint8_t f = 15;
+    for(int r=0; r<4; r++) f = std::min(f, m_sketch[slot(key, r)]);
+    return f;
+  };
+  virtual bool admit(uint64_t key, time_t now) {
+    if(m_index.size()<m_size) return true;
+    uint64_t victim = m_lru.back();
+    if(m_index[victim].second<now) return true;
+    return frequency(key)>frequency(victim);
+  };
+};
+
+
+static time_t g_expire = CACHE_EXPIRES_SEC;
+static std::vector<Access> g_accesses;
+static std::map<uint32_t, std::string> g_keys;     // id => path, or "#hash".
+static std::set<uint32_t> g_dirs;
+static std::map<uint32_t, uint64_t> g_lengths;
+static time_t g_start;
+
+
+static bool load(const char* file)
+{
+  FILE* fp = fopen(file, "rb");
+  if(fp==NULL) {
+    fprintf(stderr, "%s: %s\n", file, strerror(errno));
+    return false;
+  }
+  CaptureHeader h;
+  if((fread(&h, sizeof(h), 1, fp)!=1) || (memcmp(h.magic, CAPTURE_MAGIC, sizeof(h.magic))!=0) ||
+     (h.version!=CAPTURE_VERSION)) {
+    fprintf(stderr, "%s: not a capture file.\n", file);
+    fclose(fp);
+    return false;
+  }
+  g_start = h.start / 1000000;
+
+  CaptureRecord r;
+  uint64_t at = 0;
+  while(fread(&r, sizeof(r), 1, fp)==1) {
+    if(r.op==CAPTURE_PATH) {
+      std::string p(r.size, '\0');
+      if((r.size>0) && (fread(&p[0], r.size, 1, fp)!=1)) break;
+      if(h.flags & CAPTURE_HASHED) {
+        uint64_t v = 0;
+        char t[32];
+        memcpy(&v, p.data(), (p.size()<sizeof(v))? p.size(): sizeof(v));
+        snprintf(t, sizeof(t), "#%016"FINT64"x", v);
+        p = t;
+      }
+      g_keys[r.path] = p;
+      continue;
+    }
+    at += r.usec;
+    if((r.op==Latency::OPENDIR) || (r.op==Latency::READDIR)) g_dirs.insert(r.path);
+    if((r.op==Latency::READ) && (r.result>0)) {
+      uint64_t& l = g_lengths[r.path];
+      if(r.offset+r.result>l) l = r.offset + r.result;
+    }
+    if((r.op!=Latency::GETATTR) && (r.op!=Latency::READ)) continue;
+    const std::string& key = g_keys[r.path];
+    if((key=="/") || (key.compare(0, 2, "/.")==0)) continue;
+    Access a;
+    a.at = at;
+    a.op = r.op;
+    a.path = r.path;
+    a.result = r.result;
+    a.offset = r.offset;
+    a.size = r.size;
+    g_accesses.push_back(a);
+  }
+  fclose(fp);
+  return true;
+}
+
+
+static std::vector<uint64_t> parse_list(const char* s, uint64_t unit)
+{
+  std::vector<uint64_t> r;
+  for(char* p=(char*)s; *p; ) {
+    r.push_back(strtoull(p, &p, 10) * unit);
+    if(*p==',') p++;
+    else if(*p) break;
+  }
+  return r;
+}
+
+
+static void print(const Outcome& o, bool first)
+{
+  printf("%s\n  {\"cache\":\"%s\",\"policy\":\"%s\",\"size\":%"FINT64"u,\"accesses\":%"FINT64"u,\"hits\":%"FINT64"u,"
+         "\"hit_ratio\":%.4f,\"origin_requests\":%"FINT64"u,\"origin_bytes\":%"FINT64"u}",
+         first? "": ",", o.cache, o.policy, o.size, o.accesses, o.hits,
+         (o.accesses>0)? (double)o.hits/o.accesses: 0.0, o.requests, o.bytes);
+}
+
+
+int main(int argc, char* argv[])
+{
+  const char* file = NULL;
+  std::vector<uint64_t> attr_sizes = parse_list("500,2000,8000,32000", 1);
+  std::vector<uint64_t> content_sizes = parse_list("16,64,256,1024", 1024*1024);
+  for(int ai=1; ai<argc; ai++) {
+    if(strncmp(argv[ai], "--attr=", 7)==0) attr_sizes = parse_list(argv[ai]+7, 1);
+    else if(strncmp(argv[ai], "--content_mb=", 13)==0) content_sizes = parse_list(argv[ai]+13, 1024*1024);
+    else if(strncmp(argv[ai], "--expire=", 9)==0) g_expire = atol(argv[ai]+9);
+    else if((argv[ai][0]!='-') && (file==NULL)) file = argv[ai];
+    else file = NULL, ai = argc;
+  }
+  if(file==NULL) {
+    fprintf(stderr, "usage: %s [--attr=500,2000,8000,32000] [--content_mb=16,64,256,1024] [--expire=SEC] CAPTURE_FILE\n", argv[0]);
+    return 1;
+  }
+  if(!load(file)) return 1;
+
+  // a ContentFile keeps an fd per cached file.
+  struct rlimit rl;
+  if(getrlimit(RLIMIT_NOFILE, &rl)==0) {
+    rl.rlim_cur = rl.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &rl);
+  }
+  char dir[] = "/tmp/cache_sim.XXXXXX";
+  if(mkdtemp(dir)==NULL) {
+    fprintf(stderr, "mkdtemp: %s\n", strerror(errno));
+    return 1;
+  }
+
+  // configurations.
+  std::vector<Outcome> attr, content;
+  std::vector<UrlStatCache*> urlstats;
+  std::vector<Policy*> policies;
+  std::vector<ContentCache*> contents;
+  std::vector<LruPolicy*> blocks;
+  for(size_t ai=0; ai<attr_sizes.size(); ai++) {
+    UrlStatCache* c = new UrlStatCache();
+    c->expire(g_expire);
+    c->max_entries(attr_sizes[ai]);
+    c->init(false);
+    urlstats.push_back(c);
+    attr.push_back(Outcome("attr", "urlstat", attr_sizes[ai]));
+  }
+  const char* names[] = { "lru", "clock", "tinylfu" };
+  for(int p=0; p<3; p++) {
+    for(size_t ai=0; ai<attr_sizes.size(); ai++) {
+      size_t size = attr_sizes[ai];
+      policies.push_back((p==0)? (Policy*)new LruPolicy(size): ((p==1)? (Policy*)new ClockPolicy(size): new TinyLfuPolicy(size)));
+      attr.push_back(Outcome("attr", names[p], size));
+    }
+  }
+  for(size_t ai=0; ai<content_sizes.size(); ai++) {
+    ContentCache* c = new ContentCache();
+    c->init(dir, content_sizes[ai]);
+    contents.push_back(c);
+    content.push_back(Outcome("content", "content", content_sizes[ai]));
+  }
+  for(size_t ai=0; ai<content_sizes.size(); ai++) {
+    blocks.push_back(new LruPolicy(content_sizes[ai] / CONTENTCACHE_BLOCK));
+    content.push_back(Outcome("content", "block_lru", content_sizes[ai]));
+  }
+
+  // one pass.
+  uint64_t failed_opens = 0;
+  for(size_t i=0; i<g_accesses.size(); i++) {
+    const Access& a = g_accesses[i];
+    const char* path = g_keys[a.path].c_str();
+    time_t now = g_start + a.at / 1000000;
+    UrlStat::now(now);
+
+    if(a.op==Latency::GETATTR) {
+      bool exists = (a.result==0);
+      int cost = !exists? 3: (g_dirs.count(a.path)? 1: 2);
+      uint64_t key = MissRatioCurve::hash(path);
+      for(size_t c=0; c<urlstats.size(); c++) {
+        Outcome& o = attr[c];
+        UrlStat us;
+        o.accesses++;
+        if(urlstats[c]->find(path, us)) {
+          o.hits++;
+          continue;
+        }
+        o.requests += cost;
+        if(!exists) continue;
+        urlstats[c]->add(path, g_dirs.count(a.path)? S_IFDIR: S_IFREG, 0);
+        if(urlstats[c]->size()>urlstats[c]->max_entries()) urlstats[c]->trim();
+      }
+      for(size_t c=0; c<policies.size(); c++) {
+        Outcome& o = attr[urlstats.size()+c];
+        o.accesses++;
+        if(policies[c]->find(key, now, now + g_expire)) {
+          o.hits++;
+          continue;
+        }
+        o.requests += cost;
+        if(exists) policies[c]->add(key, now, now + g_expire);
+      }
+      continue;
+    }
+
+    // read.
+    uint64_t length = g_lengths[a.path];
+    if(a.offset>=length) continue;
+    uint64_t size = (a.offset+a.size>length)? length - a.offset: a.size;
+    uint64_t from = a.offset - (a.offset % CONTENTCACHE_BLOCK);
+    uint64_t to = ((a.offset + size + CONTENTCACHE_BLOCK - 1) / CONTENTCACHE_BLOCK) * CONTENTCACHE_BLOCK;
+    if(to>length) to = length;
+    for(size_t c=0; c<contents.size(); c++) {
+      Outcome& o = content[c];
+      o.accesses++;
+      ContentFile* cf = contents[c]->open(glog, path, length, 0);
+      if(cf==NULL) failed_opens++;
+      if(cf && cf->has(a.offset, size)) {
+        o.hits++;
+      } else {
+        o.requests++;
+        o.bytes += to - from;
+        if(cf) cf->mark(from, to - from);
+      }
+      contents[c]->close(cf);
+    }
+    uint64_t h = MissRatioCurve::hash(path);
+    for(size_t c=0; c<blocks.size(); c++) {
+      Outcome& o = content[contents.size()+c];
+      o.accesses++;
+      bool hit = true;
+      uint64_t first = ~0ULL, last = 0;
+      for(uint64_t b=from/CONTENTCACHE_BLOCK; b*CONTENTCACHE_BLOCK<to; b++) {
+        uint64_t key = MissRatioCurve::mix(h + b);
+        if(blocks[c]->find(key, now, ~0U>>1)) continue;
+        hit = false;
+        if(first==~0ULL) first = b;
+        last = b;
+        blocks[c]->add(key, now, ~0U>>1);
+      }
+      if(hit) {
+        o.hits++;
+      } else {
+        uint64_t end = (last+1) * CONTENTCACHE_BLOCK;
+        o.requests++;
+        o.bytes += ((end>to)? to: end) - first*CONTENTCACHE_BLOCK;
+      }
+    }
+  }
+
+  printf("{\"capture\":\"%s\",\"accesses\":%"FSIZET"u,\"paths\":%"FSIZET"u,\"expire\":%ld,\"block\":%d,"
+         "\"failed_opens\":%"FINT64"u,\"results\":[",
+         file, g_accesses.size(), g_keys.size(), (long)g_expire, CONTENTCACHE_BLOCK, failed_opens);
+  bool first = true;
+  for(size_t ai=0; ai<attr.size(); ai++, first=false) print(attr[ai], first);
+  for(size_t ai=0; ai<content.size(); ai++, first=false) print(content[ai], first);
+  printf("\n]}\n");
+
+  for(size_t ai=0; ai<urlstats.size(); ai++) delete urlstats[ai];
+  for(size_t ai=0; ai<policies.size(); ai++) delete policies[ai];
+  for(size_t ai=0; ai<contents.size(); ai++) delete contents[ai];
+  for(size_t ai=0; ai<blocks.size(); ai++) delete blocks[ai];
+  rmdir(dir);
+  return 0;
+}
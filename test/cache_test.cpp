@@ -132,6 +132,47 @@ TEST(UrlStatCache, Remove)
   usc.stop();
 }
 
+TEST(UrlStatCache, Stats)
+{
+  MTrace mt("UrlStatCache_Stats.mlog");
+
+  UrlStatCache usc;
+  usc.init();
+  UrlStat us;
+
+  usc.add("dir", UrlStat(S_IFDIR, 0, 1000));
+  usc.add("file", UrlStat(S_IFREG, 100, 1000));
+  usc.add("file", UrlStat(S_IFREG, 200, 1000));
+  EXPECT_EQ(true, usc.find("file", us));
+  EXPECT_EQ(1000, us.mtime);
+  EXPECT_EQ(false, usc.find("none", us));
+  usc.remove("dir");
+  EXPECT_EQ(false, usc.find("dir", us));
+
+  UrlStatCacheStats st = usc.stats();
+  EXPECT_EQ(1U, st.hits);
+  EXPECT_EQ(2U, st.misses);
+  EXPECT_EQ(1U, st.expired);
+  EXPECT_EQ(2U, st.inserts);
+  EXPECT_EQ(1U, st.updates);
+  EXPECT_EQ(1U, st.invalidated);
+  EXPECT_EQ(2U, st.entries);
+  EXPECT_EQ(0U, st.live_dirs);
+  EXPECT_EQ(1U, st.live_files);
+  EXPECT_EQ(UrlStatMap::entry_bytes("dir") + UrlStatMap::entry_bytes("file"), st.bytes);
+
+  // trim() removes at least 5 entries.
+  usc.max_entries(1);
+  usc.trim();
+  st = usc.stats();
+  EXPECT_EQ(1U, st.evicted_expired);
+  EXPECT_EQ(1U, st.evicted_capacity);
+  EXPECT_EQ(0U, st.entries);
+  EXPECT_EQ(0U, st.bytes);
+
+  usc.stop();
+}
+
 TEST(UrlStatCache, Expire)
 {
   MTrace("UrlStatCache_Expire.mlog");
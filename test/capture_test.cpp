@@ -0,0 +1,124 @@
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <vector>
+#include <string>
+#include "mtrace.hxx"
+#include "../capture.h"
+#include "../latency.h"
+#include "../int64format.h"
+
+
+static std::string temp_file()
+{
+  char t[] = "/tmp/capture_test.XXXXXX";
+  close(mkstemp(t));
+  return t;
+}
+
+
+static std::vector<char> slurp(const std::string& file)
+{
+  std::vector<char> r;
+  FILE* fp = fopen(file.c_str(), "rb");
+  char buf[4096];
+  size_t n;
+  while((n = fread(buf, 1, sizeof(buf), fp))>0) r.insert(r.end(), buf, buf+n);
+  fclose(fp);
+  return r;
+}
+
+
+TEST(Capture, Format)
+{
+  EXPECT_EQ(24U, sizeof(CaptureHeader));
+  EXPECT_EQ(32U, sizeof(CaptureRecord));
+}
+
+
+TEST(Capture, Paths)
+{
+  std::string file = temp_file();
+  EXPECT_EQ("0\n", Capture::status());
+  EXPECT_FALSE(Capture::enabled());
+  EXPECT_EQ(0, Capture::start(file.c_str(), false));
+  EXPECT_TRUE(Capture::enabled());
+  Capture::record(Latency::GETATTR, "/host/a", 0, 0, 0, 1500, true);
+  Capture::record(Latency::OPEN, "/host/a", 0, 0, 0, 2000, false);
+  Capture::record(Latency::READ, "/host/a", 4096, 8192, 8192, 3000, false);
+  Capture::record(Latency::GETATTR, "/host/b", 0, 0, -2, 1000, true);
+  EXPECT_NE(std::string::npos, Capture::status().find(file + " records=4 paths=2 "));
+  Capture::stop();
+  EXPECT_FALSE(Capture::enabled());
+
+  std::vector<char> d = slurp(file);
+  ASSERT_EQ(sizeof(CaptureHeader) + 6*sizeof(CaptureRecord) + 14, d.size());
+  const CaptureHeader* h = (const CaptureHeader*)&d[0];
+  EXPECT_EQ(0, memcmp(h->magic, CAPTURE_MAGIC, 8));
+  EXPECT_EQ(0U, h->flags);
+
+  const char* p = &d[sizeof(CaptureHeader)];
+  const CaptureRecord* r = (const CaptureRecord*)p;
+  EXPECT_EQ(CAPTURE_PATH, r->op);
+  EXPECT_EQ(1U, r->path);
+  EXPECT_EQ(7U, r->size);
+  EXPECT_EQ("/host/a", std::string(p+sizeof(CaptureRecord), 7));
+  p += sizeof(CaptureRecord) + 7;
+  r = (const CaptureRecord*)p;
+  EXPECT_EQ(Latency::GETATTR, r->op);
+  EXPECT_EQ(CAPTURE_MISS, r->flags);
+  EXPECT_EQ(1U, r->duration);
+  p += 2*sizeof(CaptureRecord);
+  r = (const CaptureRecord*)p;
+  EXPECT_EQ(Latency::READ, r->op);
+  EXPECT_EQ(1U, r->path);
+  EXPECT_EQ(4096U, r->offset);
+  EXPECT_EQ(8192U, r->size);
+  EXPECT_EQ(8192, r->result);
+  EXPECT_EQ(3U, r->duration);
+  p += sizeof(CaptureRecord);
+  r = (const CaptureRecord*)p;
+  EXPECT_EQ(CAPTURE_PATH, r->op);
+  EXPECT_EQ(2U, r->path);
+  p += sizeof(CaptureRecord) + 7;
+  r = (const CaptureRecord*)p;
+  EXPECT_EQ(2U, r->path);
+  EXPECT_EQ(-2, r->result);
+  unlink(file.c_str());
+}
+
+
+TEST(Capture, Hashed)
+{
+  MTrace mt("Capture_Hashed.mlog");
+  std::string file = temp_file();
+  EXPECT_EQ(0, Capture::start(file.c_str(), true));
+  EXPECT_EQ("hash:", Capture::status().substr(0, 5));
+  for(int ai=0; ai<10000; ai++) {
+    Capture::record(Latency::GETATTR, (ai%2)? "/host/secret": "/host/other", 0, 0, 0, 0, false);
+  }
+  Capture::stop();
+
+  std::vector<char> d = slurp(file);
+  EXPECT_EQ(sizeof(CaptureHeader) + 10002*sizeof(CaptureRecord) + 2*8, d.size());
+  EXPECT_EQ((uint32_t)CAPTURE_HASHED, ((const CaptureHeader*)&d[0])->flags);
+  uint64_t h;
+  memcpy(&h, &d[sizeof(CaptureHeader)+sizeof(CaptureRecord)], 8);
+  EXPECT_EQ(Capture::hash("/host/other"), h);
+  EXPECT_EQ(std::string::npos, std::string(d.begin(), d.end()).find("secret"));
+  unlink(file.c_str());
+}
+
+
+TEST(Capture, StartFailure)
+{
+  EXPECT_EQ(-ENOENT, Capture::start("/nonexistent/dir/capture", false));
+  EXPECT_FALSE(Capture::enabled());
+}
+
+
+int main(int argc, char* argv[])
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,138 @@
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "mtrace.hxx"
+#include "../contentcache.h"
+#include "../int64format.h"
+
+
+static Log glog("contentcache_test", LOG_LOCAL7, Log::NOTE);
+
+
+// HTTP server answering every request by 'status' with the first 'body' bytes of a file of 'length'.
+class RangeServer
+{
+public:
+  RangeServer(int status, uint64_t length, uint64_t body): m_status(status), m_length(length), m_body(body) {
+    m_sock = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(m_sock, (struct sockaddr*)&sa, sizeof(sa));
+    socklen_t len = sizeof(sa);
+    getsockname(m_sock, (struct sockaddr*)&sa, &len);
+    listen(m_sock, 16);
+    char t[64];
+    snprintf(t, sizeof(t), "/127.0.0.1:%d/file", ntohs(sa.sin_port));
+    m_path = t;
+    pthread_create(&m_thread, NULL, serve, this);
+  };
+  ~RangeServer() {
+    shutdown(m_sock, SHUT_RDWR);
+    close(m_sock);
+    pthread_join(m_thread, NULL);
+  };
+  inline const char* path() const { return m_path.c_str(); };
+  static inline char content(uint64_t offset) { return (char)(offset * 7 + 1); };
+
+private:
+  int m_sock;
+  pthread_t m_thread;
+  std::string m_path;
+  int m_status;
+  uint64_t m_length;
+  uint64_t m_body;
+
+  static void* serve(void* ctx) {
+    RangeServer* self = (RangeServer*)ctx;
+    int c;
+    while((c = accept(self->m_sock, NULL, NULL))>=0) {
+      std::string req;
+      char buf[4096];
+      ssize_t n;
+      while((req.find("\r\n\r\n")==std::string::npos) && ((n = read(c, buf, sizeof(buf)))>0)) req.append(buf, n);
+      std::string res;
+      if(self->m_status==206) {
+        snprintf(buf, sizeof(buf), "HTTP/1.1 206 Partial Content\r\nContent-Range: bytes 0-%"FINT64"u/%"FINT64"u\r\n"
+                 "Content-Length: %"FINT64"u\r\nConnection: close\r\n\r\n", self->m_body-1, self->m_length, self->m_body);
+        res = buf;
+        for(uint64_t ai=0; ai<self->m_body; ai++) res += content(ai);
+      } else {
+        snprintf(buf, sizeof(buf), "HTTP/1.1 %d Error\r\nContent-Length: 0\r\nConnection: close\r\n\r\n", self->m_status);
+        res = buf;
+      }
+      for(size_t off=0; off<res.size(); off+=n) {
+        n = write(c, res.data() + off, res.size() - off);
+        if(n<=0) break;
+      }
+      close(c);
+    }
+    return NULL;
+  };
+};
+
+
+static int tmpfd()
+{
+  char path[] = "/tmp/contentcache_test.XXXXXX";
+  int fd = mkstemp(path);
+  unlink(path);
+  return fd;
+}
+
+
+TEST(ContentFile, fetch)
+{
+  MTrace mt("ContentFile_fetch.mlog");
+
+  uint64_t length = CONTENTCACHE_BLOCK * 2 + 100;
+  RangeServer server(206, length, length);
+  ContentFile cf(tmpfd(), server.path(), length, 0);
+  EXPECT_FALSE(cf.has(0, length));
+  EXPECT_EQ(0, cf.fetch(glog, 0, length));
+  EXPECT_TRUE(cf.has(0, length));
+
+  char buf[16];
+  ASSERT_EQ((ssize_t)sizeof(buf), pread(cf.fd(), buf, sizeof(buf), length - sizeof(buf)));
+  for(size_t ai=0; ai<sizeof(buf); ai++) EXPECT_EQ(RangeServer::content(length - sizeof(buf) + ai), buf[ai]);
+}
+
+
+TEST(ContentFile, short_body)
+{
+  MTrace mt("ContentFile_short_body.mlog");
+
+  // the file has shrunk since its length was cached: the tail must not be read as zeros.
+  uint64_t length = CONTENTCACHE_BLOCK * 3;
+  RangeServer server(206, length, CONTENTCACHE_BLOCK + CONTENTCACHE_BLOCK/2);
+  ContentFile cf(tmpfd(), server.path(), length, 0);
+  EXPECT_EQ(-EIO, cf.fetch(glog, 0, length));
+  EXPECT_TRUE(cf.has(0, CONTENTCACHE_BLOCK));
+  EXPECT_FALSE(cf.has(CONTENTCACHE_BLOCK, 1));
+  EXPECT_FALSE(cf.has(0, length));
+  EXPECT_EQ((uint64_t)CONTENTCACHE_BLOCK, cf.bytes());
+}
+
+
+TEST(ContentFile, failed)
+{
+  MTrace mt("ContentFile_failed.mlog");
+
+  RangeServer server(404, 1000, 0);
+  ContentFile cf(tmpfd(), server.path(), 1000, 0);
+  EXPECT_EQ(-ENOENT, cf.fetch(glog, 0, 1000));
+  EXPECT_FALSE(cf.has(0, 1));
+  EXPECT_EQ(0U, cf.bytes());
+}
+
+
+int main(int argc, char* argv[])
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
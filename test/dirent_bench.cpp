@@ -0,0 +1,335 @@
+// Decoding of directory listings and X-FileStat-Json headers, picojson against JsonScan, in JSON.
+//   $ make dirent_bench && ./dirent_bench [--entries=1000,10000,100000,1000000] [--file=LISTING.json ...] [--seconds=N]
+//
+// Synthetic listings are in the format of test/origin_server; a real one can be saved by
+//   $ curl -H 'Accept: text/json' http://host/dir/ > LISTING.json
+// With each ISA of JsonScan the CPU has, against picojson:
+//   parse       the structure of the listing, a DOM or JsonScan::skip_value().
+//   decode      the listing by Direntries or DirentList.
+//   x_filestat  the X-FileStat-Json of each entry by FileStat::from_json().
+// Reported per decoder: ns_per_entry, mb_per_sec, allocs_per_entry, alloc_bytes_per_entry
+// (by operator new) and the speedup against picojson.
+// The same listing in DirentBinary is compared with the JSON by the best ISA:
+//   binary      bytes of both, and DirentList::from_binary() against DirentList::from_json().
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#include <string>
+#include <vector>
+#include "../dirent.h"
+#include "../jsonscan.h"
+#include "../ext/time_iso8601.h"
+#include "../latency.h"
+#include "../int64format.h"
+
+
+static uint64_t g_allocs = 0;
+static uint64_t g_alloc_bytes = 0;
+
+void* operator new(size_t size)
+{
+  g_allocs++;
+  g_alloc_bytes += size;
+  void* p = malloc(size);
+  if(!p) throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void* p) throw()
+{
+  free(p);
+}
+
+
+static std::string listing(size_t entries)
+{
+  std::string json = "{";
+  char t[256];
+  for(size_t ai=0; ai<entries; ai++) {
+    bool dir = (ai%16==0);
+    snprintf(t, sizeof(t), "%s\"%s%"FSIZET"u\":{\"mode\":\"%s\",\"size\":%"FSIZET"u,\"mtime\":\"2016-%02d-%02dT%02d:%02d:%02d+0000\"}",
+             (ai==0)? "": ",", dir? "d": "f", ai, dir? "drwxr-xr-x": "-rw-r--r--", dir? 0: (ai*7919)%1048576,
+             (int)(ai%12)+1, (int)(ai%28)+1, (int)(ai%24), (int)(ai%60), (int)(ai*7%60));
+    json += t;
+  }
+  json += "}";
+  return json;
+}
+
+
+class Result
+{
+public:
+  inline Result(): loops(0), nsec(0), allocs(0), alloc_bytes(0), entries(0) {};
+  uint64_t loops;
+  uint64_t nsec;
+  uint64_t allocs;
+  uint64_t alloc_bytes;
+  size_t   entries;
+};
+
+
+// a decoder of the listing 'json', returns the number of entries.
+typedef size_t (*DECODE)(const std::string& json);
+static std::vector<std::string> g_headers;   // X-FileStat-Json of each entry.
+static JsonScan::ISA g_isa;                  // the best of the CPU.
+
+
+static size_t listing_picojson(const std::string& json)
+{
+  std::string j = json;
+  Direntries de;
+  de.from_json(j);
+  return de.size();
+}
+
+
+static size_t listing_scan(const std::string& json)
+{
+  DirentList de;
+  de.from_json(json);
+  return de.size();
+}
+
+
+static size_t listing_binary(const std::string& bin)
+{
+  DirentList de;
+  de.from_binary(bin);
+  return de.size();
+}
+
+
+// as FileStat::from_json(std::string&) decoded X-FileStat-Json before JsonScan.
+static size_t headers_picojson(const std::string&)
+{
+  FileStat fs;
+  for(size_t ai=0; ai<g_headers.size(); ai++) {
+    std::string err;
+    picojson::value root;
+    picojson::parse<std::string::const_iterator>(root, g_headers[ai].begin(), g_headers[ai].end(), &err);
+    if(!err.empty()) throw err;
+    picojson::object obj = root.get<picojson::object>();
+    std::pair<std::string, picojson::value> val = *obj.begin();
+    fs.name = val.first;
+    fs.from_json(val.second);
+  }
+  return g_headers.size();
+}
+
+
+static size_t headers_scan(const std::string&)
+{
+  FileStat fs;
+  for(size_t ai=0; ai<g_headers.size(); ai++) fs.from_json(g_headers[ai]);
+  return g_headers.size();
+}
+
+
+// the structure only: a DOM by picojson, or a skip of the listing by JsonScan.
+static size_t parse_picojson(const std::string& json)
+{
+  std::string err;
+  picojson::value root;
+  picojson::parse<std::string::const_iterator>(root, json.begin(), json.end(), &err);
+  if(!err.empty()) throw err;
+  return g_headers.size();
+}
+
+
+static size_t parse_scan(const std::string& json)
+{
+  if(!JsonScan::skip_value(json.data(), json.data() + json.size())) throw std::string("Unexpected end of json.");
+  return g_headers.size();
+}
+
+
+static Result run(DECODE decode, const std::string& json, double seconds)
+{
+  Result r;
+  do {
+    uint64_t a = g_allocs, b = g_alloc_bytes;
+    uint64_t s = Latency::now();
+    r.entries = decode(json);
+    r.nsec += Latency::now() - s;
+    r.allocs += g_allocs - a;
+    r.alloc_bytes += g_alloc_bytes - b;
+    r.loops++;
+  } while(r.nsec<seconds*1e9);
+  return r;
+}
+
+
+static std::string to_json(const char* decoder, const Result& r, size_t bytes, const Result* base)
+{
+  char t[512];
+  double n = (double)r.loops * r.entries;
+  snprintf(t, sizeof(t), "\"%s\":{\"loops\":%"FINT64"u,\"ns_per_entry\":%.1f,\"mb_per_sec\":%.1f,"
+           "\"allocs_per_entry\":%.2f,\"alloc_bytes_per_entry\":%.1f",
+           decoder, r.loops, r.nsec / n, (double)bytes * r.loops / (r.nsec / 1e9) / (1024*1024),
+           r.allocs / n, r.alloc_bytes / n);
+  std::string s = t;
+  if(base) {
+    snprintf(t, sizeof(t), ",\"speedup\":%.1f", ((double)base->nsec / base->loops) / ((double)r.nsec / r.loops));
+    s += t;
+  }
+  return s + "}";
+}
+
+
+// picojson, then JsonScan with each ISA the CPU has.
+static std::string compare(DECODE dom, DECODE scan, const std::string& json, size_t bytes, double seconds)
+{
+  std::vector<Result> results;
+  std::string r;
+  for(int isa=0; isa<JsonScan::ISAS; isa++) {
+    if(!JsonScan::use((JsonScan::ISA)isa)) continue;
+    Result s = run(scan, json, seconds);
+    r += "," + to_json(JsonScan::isa_name((JsonScan::ISA)isa), s, bytes, NULL);
+    results.push_back(s);
+  }
+  Result d = run(dom, json, seconds);
+  for(size_t ai=0; ai<results.size(); ai++) {
+    if(results[ai].entries!=d.entries) {
+      fprintf(stderr, "entries differ: %"FSIZET"u != %"FSIZET"u\n", results[ai].entries, d.entries);
+      exit(1);
+    }
+  }
+
+  // speedups against picojson.
+  r = "";
+  size_t ri = 0;
+  for(int isa=0; isa<JsonScan::ISAS; isa++) {
+    if(!JsonScan::supported((JsonScan::ISA)isa)) continue;
+    r += "," + to_json(JsonScan::isa_name((JsonScan::ISA)isa), results[ri++], bytes, &d);
+  }
+  return "{" + to_json("picojson", d, bytes, NULL) + r + "}";
+}
+
+
+static std::string mode_str(mode_t m)
+{
+  char r[11] = "----------";
+  if(S_ISDIR(m)) r[0] = 'd';
+  if(S_ISLNK(m)) r[0] = 'l';
+  const char* rwx = "rwxrwxrwx";
+  for(int ai=0; ai<9; ai++) if(m & (0400>>ai)) r[ai+1] = rwx[ai];
+  return r;
+}
+
+
+// X-FileStat-Json of each entry of the listing.
+static void headers(const std::string& json)
+{
+  DirentList dl;
+  dl.from_json(json);
+  g_headers.clear();
+  for(size_t ai=0; ai<dl.size(); ai++) {
+    std::string h = " {\"";
+    for(const char* p=dl.name(ai); *p; p++) {
+      if((*p=='"') || (*p=='\\')) h += '\\';
+      h += *p;
+    }
+    char t[256];
+    snprintf(t, sizeof(t), "\":{\"mode\":\"%s\",\"size\":%"FINT64"u,\"mtime\":\"%s\"}}\r\n",
+             mode_str(dl[ai].mode).c_str(), dl[ai].size, ((std::string)TimeIso8601(dl[ai].mtime)).c_str());
+    g_headers.push_back(h + t);
+  }
+}
+
+
+// the listing 'json' in DirentBinary, against the JSON by the best ISA.
+static std::string binary(const std::string& json, double seconds)
+{
+  DirentList dl;
+  dl.from_json(json);
+  std::string bin;
+  DirentBinary::header(bin);
+  for(size_t ai=0; ai<dl.size(); ai++) {
+    DirentBinary::entry(bin, dl.name(ai), strlen(dl.name(ai)), dl[ai].mode, dl[ai].size, dl[ai].mtime);
+  }
+  DirentBinary::end(bin);
+
+  JsonScan::use(g_isa);
+  Result j = run(listing_scan, json, seconds);
+  Result b = run(listing_binary, bin, seconds);
+  if(b.entries!=j.entries) {
+    fprintf(stderr, "entries differ: %"FSIZET"u != %"FSIZET"u\n", b.entries, j.entries);
+    exit(1);
+  }
+
+  char t[512];
+  snprintf(t, sizeof(t), "{\"bytes\":%"FSIZET"u,\"bytes_per_entry\":%.1f,\"json_bytes_per_entry\":%.1f,\"size_ratio\":%.2f,\"decode\":{",
+           bin.size(), (double)bin.size() / j.entries, (double)json.size() / j.entries, (double)bin.size() / json.size());
+  return t + to_json("json", j, json.size(), NULL) + "," + to_json("binary", b, bin.size(), &j) + "}}";
+}
+
+
+static std::string bench(const char* source, const std::string& json, double seconds)
+{
+  headers(json);
+  size_t hbytes = 0;
+  for(size_t ai=0; ai<g_headers.size(); ai++) hbytes += g_headers[ai].size();
+
+  char t[512];
+  snprintf(t, sizeof(t), "{\"source\":\"%s\",\"entries\":%"FSIZET"u,\"bytes\":%"FSIZET"u,\"parse\":",
+           source, g_headers.size(), json.size());
+  return t + compare(parse_picojson, parse_scan, json, json.size(), seconds) +
+         ",\"decode\":" + compare(listing_picojson, listing_scan, json, json.size(), seconds) +
+         ",\"x_filestat\":" + compare(headers_picojson, headers_scan, json, hbytes, seconds) +
+         ",\"binary\":" + binary(json, seconds) + "}";
+}
+
+
+int main(int argc, char* argv[])
+{
+  std::vector<size_t> entries;
+  std::vector<std::string> files;
+  double seconds = 0.5;
+  for(int ai=1; ai<argc; ai++) {
+    if(strncmp(argv[ai], "--seconds=", 10)==0) seconds = atof(argv[ai]+10);
+    else if(strncmp(argv[ai], "--file=", 7)==0) files.push_back(argv[ai]+7);
+    else if(strncmp(argv[ai], "--entries=", 10)==0) {
+      for(char* p=argv[ai]+10; *p; ) {
+        entries.push_back(strtol(p, &p, 10));
+        if(*p==',') p++;
+      }
+    } else {
+      fprintf(stderr, "usage: %s [--entries=1000,10000,100000,1000000] [--file=LISTING.json ...] [--seconds=N]\n", argv[0]);
+      return 1;
+    }
+  }
+  if(entries.empty() && files.empty()) {
+    entries.push_back(1000);
+    entries.push_back(10000);
+    entries.push_back(100000);
+    entries.push_back(1000000);
+  }
+
+  g_isa = JsonScan::isa();
+  printf("{\"bench\":\"dirent_bench\",\"isa\":\"%s\",\"results\":[\n", JsonScan::isa_name(g_isa));
+  bool first = true;
+  for(size_t ai=0; ai<files.size(); ai++) {
+    std::string json;
+    FILE* f = fopen(files[ai].c_str(), "r");
+    if(!f) {
+      perror(files[ai].c_str());
+      return 1;
+    }
+    char buf[65536];
+    size_t n;
+    while((n = fread(buf, 1, sizeof(buf), f))>0) json.append(buf, n);
+    fclose(f);
+    printf("%s%s", first? "": ",\n", bench(files[ai].c_str(), json, seconds).c_str());
+    fflush(stdout);
+    first = false;
+  }
+  for(size_t ai=0; ai<entries.size(); ai++) {
+    printf("%s%s", first? "": ",\n", bench("synthetic", listing(entries[ai]), seconds).c_str());
+    fflush(stdout);
+    first = false;
+  }
+  printf("\n]}\n");
+  return 0;
+}
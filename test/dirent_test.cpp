@@ -0,0 +1,250 @@
+#include <gtest/gtest.h>
+#include <map>
+#include <algorithm>
+#include "mtrace.hxx"
+#include "../dirent.h"
+#include "../ext/time_iso8601.h"
+#include "../int64format.h"
+
+
+static std::string listing(size_t entries)
+{
+  std::string json = "{";
+  char t[256];
+  for(size_t ai=0; ai<entries; ai++) {
+    snprintf(t, sizeof(t), "%s\"file%05"FSIZET"u.txt\":{\"mode\":\"%s\",\"size\":%"FSIZET"u,\"mtime\":\"2010-10-01T12:34:56+0900\"}",
+             (ai==0)? "": ",", ai, (ai%10==0)? "drwxr-xr-x": "-rw-r--r--", ai*1000);
+    json += t;
+  }
+  json += "}";
+  return json;
+}
+
+
+TEST(DirentList, same_as_Direntries)
+{
+  MTrace mt("DirentList_same_as_Direntries.mlog");
+
+  std::string json = listing(100);
+  json.insert(1, " \"sp ace\" : { \"size\" : 1.5e3 , \"extra\" : [1, {\"a\":null}, true], \"mode\" : \"lrwxrwxrwx\" } ,\n");
+  json.insert(1, "\"defaults\":1,\"empty\":{},");
+
+  Direntries de;
+  de.from_json(json);
+  DirentList dl;
+  dl.from_json(json);
+  ASSERT_EQ(de.size(), dl.size());
+
+  std::map<std::string, FileStat> expects;
+  for(size_t ai=0; ai<de.size(); ai++) expects[de[ai].name] = de[ai];
+  for(size_t ai=0; ai<dl.size(); ai++) {
+    std::map<std::string, FileStat>::iterator it = expects.find(dl.name(ai));
+    ASSERT_TRUE(it!=expects.end()) << dl.name(ai);
+    EXPECT_EQ(it->second.mode, dl[ai].mode) << dl.name(ai);
+    EXPECT_EQ(it->second.size, dl[ai].size) << dl.name(ai);
+    EXPECT_EQ(it->second.mtime, dl[ai].mtime) << dl.name(ai);
+  }
+
+  // in the order of the listing.
+  EXPECT_STREQ("defaults", dl.name(0));
+  EXPECT_EQ((unsigned)S_IFDIR, dl[0].mode);
+  EXPECT_STREQ("sp ace", dl.name(2));
+  EXPECT_EQ((unsigned)(S_IFLNK|0777), dl[2].mode);
+  EXPECT_EQ(1500U, dl[2].size);
+  EXPECT_STREQ("file00099.txt", dl.name(102));
+  EXPECT_EQ(99000U, dl[102].size);
+  EXPECT_EQ((time_t)TimeIso8601("2010-10-01T12:34:56+0900"), dl[102].mtime);
+}
+
+TEST(DirentList, array)
+{
+  MTrace mt("DirentList_array.mlog");
+
+  std::string json = "[\"a\", \"b\",\"c\" ]";
+  DirentList dl;
+  dl.from_json(json);
+  ASSERT_EQ(3U, dl.size());
+  EXPECT_STREQ("a", dl.name(0));
+  EXPECT_STREQ("c", dl.name(2));
+  EXPECT_EQ((unsigned)S_IFDIR, dl[1].mode);
+}
+
+TEST(DirentList, escapes)
+{
+  MTrace mt("DirentList_escapes.mlog");
+
+  std::string json = "{\"q\\\"b\\\\s\\/\":{},\"\\u3042\\u00e9A\":{},\"\\ud83d\\ude00\":{}}";
+  DirentList dl;
+  dl.from_json(json);
+  ASSERT_EQ(3U, dl.size());
+  EXPECT_STREQ("q\"b\\s/", dl.name(0));
+  EXPECT_STREQ("\xe3\x81\x82\xc3\xa9" "A", dl.name(1));
+  EXPECT_STREQ("\xf0\x9f\x98\x80", dl.name(2));
+
+  json = "{\"\\ude00\":{}}";
+  EXPECT_THROW(dl.from_json(json), std::string);
+  json = "{\"\\x\":{}}";
+  EXPECT_THROW(dl.from_json(json), std::string);
+}
+
+TEST(DirentList, bad_json)
+{
+  MTrace mt("DirentList_bad_json.mlog");
+
+  const char* bad[] = {
+    "", " ", "1", "\"a\"", "{}", "[]", "{\"a\"}", "{\"a\":}", "{\"a\":{}", "{\"a\":{},}",
+    "{\"a\":{\"size\":1", "{\"a\":{\"mode\":\"drw", "{\"a\" {}}", "{\"a\":{} \"b\":{}}", "[\"a\",1]",
+    "{\"a\":{\"x\":tru}}", "{\"a\":{\"x\":]}}",
+  };
+  DirentList dl;
+  for(size_t ai=0; ai<sizeof(bad)/sizeof(bad[0]); ai++) {
+    EXPECT_THROW(dl.from_json(bad[ai], strlen(bad[ai])), std::string) << bad[ai];
+  }
+
+  // truncated at every byte.
+  std::string json = listing(3);
+  for(size_t len=0; len<json.size(); len++) {
+    EXPECT_THROW(dl.from_json(json.data(), len), std::string) << len;
+  }
+  EXPECT_NO_THROW(dl.from_json(json));
+  EXPECT_EQ(3U, dl.size());
+}
+
+TEST(DirentStream, chunks)
+{
+  MTrace mt("DirentStream_chunks.mlog");
+
+  std::string json = listing(20);
+  json.insert(1, " \"\\u3042\\ud83d\\ude00\" : { \"x\" : [ \"}\" , {} ] } , ");
+  DirentList expect;
+  expect.from_json(json);
+
+  for(size_t chunk=1; chunk<=json.size(); chunk++) {
+    DirentStream ds;
+    DirentList dl;
+    size_t entries = 0;
+    for(size_t off=0; off<json.size(); off+=chunk) {
+      DirentList batch;
+      ds.feed(json.data() + off, std::min(chunk, json.size() - off), batch);
+      for(size_t ai=0; ai<batch.size(); ai++, entries++) {
+        ASSERT_STREQ(expect.name(entries), batch.name(ai)) << chunk;
+        EXPECT_EQ(expect[entries].mode, batch[ai].mode);
+        EXPECT_EQ(expect[entries].size, batch[ai].size);
+        EXPECT_EQ(expect[entries].mtime, batch[ai].mtime);
+      }
+    }
+    EXPECT_NO_THROW(ds.finish());
+    EXPECT_EQ(expect.size(), entries) << chunk;
+  }
+
+  // an empty listing is not an error while streaming.
+  DirentStream ds;
+  DirentList dl;
+  ds.feed(" [ ", 3, dl);
+  EXPECT_THROW(ds.finish(), std::string);
+  ds.feed("]", 1, dl);
+  EXPECT_NO_THROW(ds.finish());
+  EXPECT_EQ(0U, dl.size());
+  EXPECT_FALSE(ds.hash());
+}
+
+// the listing of 'json' in DirentBinary.
+static std::string binary(const std::string& json)
+{
+  DirentList dl;
+  dl.from_json(json);
+  std::string r;
+  DirentBinary::header(r);
+  for(size_t ai=0; ai<dl.size(); ai++) {
+    DirentBinary::entry(r, dl.name(ai), strlen(dl.name(ai)), dl[ai].mode, dl[ai].size, dl[ai].mtime);
+  }
+  DirentBinary::end(r);
+  return r;
+}
+
+TEST(DirentList, binary)
+{
+  MTrace mt("DirentList_binary.mlog");
+
+  std::string json = listing(100);
+  json.insert(1, "\"\\u3042 b\":{\"mode\":\"lrwxrwxrwx\",\"size\":18446744073709551615,\"mtime\":\"1960-01-01T00:00:00Z\"},");
+  DirentList expect;
+  expect.from_json(json);
+  std::string bin = binary(json);
+  EXPECT_EQ(8U + 101*22 + 2 + 100*13 + 5, bin.size());
+  EXPECT_LT(bin.size(), json.size() / 2);
+
+  DirentList dl;
+  dl.from_binary(bin);
+  ASSERT_EQ(expect.size(), dl.size());
+  for(size_t ai=0; ai<dl.size(); ai++) {
+    EXPECT_STREQ(expect.name(ai), dl.name(ai));
+    EXPECT_EQ(expect[ai].mode, dl[ai].mode);
+    EXPECT_EQ(expect[ai].size, dl[ai].size);
+    EXPECT_EQ(expect[ai].mtime, dl[ai].mtime);
+  }
+  EXPECT_STREQ("\xe3\x81\x82 b", dl.name(0));
+  EXPECT_EQ(18446744073709551615ULL, dl[0].size);
+  EXPECT_EQ((time_t)-315619200, dl[0].mtime);
+
+  // an empty directory.
+  bin.clear();
+  DirentBinary::header(bin);
+  DirentBinary::end(bin);
+  EXPECT_NO_THROW(dl.from_binary(bin));
+  EXPECT_EQ(0U, dl.size());
+}
+
+TEST(DirentList, bad_binary)
+{
+  MTrace mt("DirentList_bad_binary.mlog");
+
+  std::string bin = binary(listing(3));
+  DirentList dl;
+  for(size_t len=0; len<bin.size(); len++) {
+    EXPECT_THROW(dl.from_binary(bin.data(), len), std::string) << len;
+  }
+  EXPECT_NO_THROW(dl.from_binary(bin));
+  EXPECT_EQ(3U, dl.size());
+
+  std::string bad = bin;
+  bad[4] = 2;
+  EXPECT_THROW(dl.from_binary(bad), std::string);
+  EXPECT_THROW(dl.from_binary(listing(3)), std::string);
+  bad = bin;
+  bad[8+22+1] = '\0';
+  EXPECT_THROW(dl.from_binary(bad), std::string);
+}
+
+TEST(DirentStream, binary_chunks)
+{
+  MTrace mt("DirentStream_binary_chunks.mlog");
+
+  std::string bin = binary(listing(20));
+  DirentList expect;
+  expect.from_binary(bin);
+
+  for(size_t chunk=1; chunk<=bin.size(); chunk++) {
+    DirentStream ds(DirentStream::BINARY);
+    size_t entries = 0;
+    for(size_t off=0; off<bin.size(); off+=chunk) {
+      DirentList batch;
+      ds.feed(bin.data() + off, std::min(chunk, bin.size() - off), batch);
+      for(size_t ai=0; ai<batch.size(); ai++, entries++) {
+        ASSERT_STREQ(expect.name(entries), batch.name(ai)) << chunk;
+        EXPECT_EQ(expect[entries].mode, batch[ai].mode);
+        EXPECT_EQ(expect[entries].size, batch[ai].size);
+        EXPECT_EQ(expect[entries].mtime, batch[ai].mtime);
+      }
+    }
+    EXPECT_NO_THROW(ds.finish());
+    EXPECT_EQ(expect.size(), entries) << chunk;
+  }
+}
+
+
+int main(int argc, char* argv[])
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -98,6 +98,75 @@ TEST(FileStat, from_json)
   EXPECT_EQ((time_t)t, fs.mtime);
 }
 
+TEST(FileStat, str_to_mode)
+{
+  MTrace mt("FileStat_str_to_mode.mlog");
+
+  EXPECT_EQ((unsigned)(S_IFREG|0644), FileStat::str_to_mode("-rw-r--r--", 10));
+  EXPECT_EQ((unsigned)(S_IFLNK|0777), FileStat::str_to_mode("lrwxrwxrwx", 10));
+  EXPECT_EQ((unsigned)S_IFDIR, FileStat::str_to_mode("drwxr-xr-x", 1));
+  EXPECT_EQ(0U, FileStat::str_to_mode("", 0));
+}
+
+TEST(FileStat, str_to_mtime)
+{
+  MTrace mt("FileStat_str_to_mtime.mlog");
+
+  // 2010-10-01T03:34:56Z
+  const char* same[] = {
+    "2010-10-01T12:34:56+0900", "2010-10-01T12:34:56+09:00", "2010-10-01T12:34:56+09",
+    "2010-10-01T03:34:56Z", "2010-10-01T03:34:56+0000", "2010-09-30T22:34:56-0500",
+    "2010-10-01T03:34:56.789Z",
+  };
+  for(size_t ai=0; ai<sizeof(same)/sizeof(same[0]); ai++) {
+    time_t t = 0;
+    EXPECT_TRUE(FileStat::str_to_mtime(same[ai], strlen(same[ai]), t)) << same[ai];
+    EXPECT_EQ(1285904096, t) << same[ai];
+    // TimeIso8601 by strptime() and mktime() agrees, where strptime() takes it.
+    try { EXPECT_EQ((time_t)TimeIso8601(same[ai]), t) << same[ai]; }
+    catch(const char* e) {}
+  }
+
+  time_t t = 0;
+  EXPECT_TRUE(FileStat::str_to_mtime("1970-01-01T00:00:00Z", 20, t));
+  EXPECT_EQ(0, t);
+  EXPECT_TRUE(FileStat::str_to_mtime("2000-02-29T23:59:59+0000", 24, t));
+  EXPECT_EQ(951868799, t);
+  EXPECT_TRUE(FileStat::str_to_mtime("2038-01-19T03:14:08Z", 20, t));
+  EXPECT_EQ((time_t)2147483648LL, t);
+  EXPECT_TRUE(FileStat::str_to_mtime("1969-12-31T23:59:59Z", 20, t));
+  EXPECT_EQ(-1, t);
+
+  const char* bad[] = {
+    "", "2010-10-01", "2010-10-01T12:34:56", "000-00-00T00:00:00+0000", "2010-13-01T12:34:56Z",
+    "2010-10-01 12:34:56Z", "2010-10-01T24:00:00Z", "2010-10-01T12:34:56+09:", "2010-10-01T12:34:56+0900x",
+    "2010-10-01T12:34:56J", "2010-1a-01T12:34:56Z",
+  };
+  for(size_t ai=0; ai<sizeof(bad)/sizeof(bad[0]); ai++) {
+    t = 12345;
+    EXPECT_FALSE(FileStat::str_to_mtime(bad[ai], strlen(bad[ai]), t)) << bad[ai];
+    EXPECT_EQ(12345, t) << bad[ai];
+  }
+}
+
+TEST(FileStat, from_json_escaped)
+{
+  MTrace mt("FileStat_from_json_escaped.mlog");
+
+  FileStat fs;
+  std::string json = " {\"a\\\"b\\u3042\" : {\"size\":1,\"mtime\":\"2010-10-01T03:34:56Z\"}}\r\n";
+  EXPECT_NO_THROW(fs.from_json(json));
+  EXPECT_EQ("a\"b\xe3\x81\x82", fs.name);
+  EXPECT_EQ(1U, fs.size);
+  EXPECT_EQ(1285904096, fs.mtime);
+
+  // nothing is changed on errors.
+  json = "{\"c\":{\"size\":2";
+  EXPECT_THROW(fs.from_json(json), std::string);
+  EXPECT_EQ("a\"b\xe3\x81\x82", fs.name);
+  EXPECT_EQ(1U, fs.size);
+}
+
 
 int main(int argc, char* argv[])
 {
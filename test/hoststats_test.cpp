@@ -0,0 +1,55 @@
+#include <gtest/gtest.h>
+#include <curl/curl.h>
+#include "mtrace.hxx"
+#include "../hoststats.h"
+#include "../int64format.h"
+
+
+TEST(HostStats, HostOf)
+{
+  EXPECT_EQ("localhost", HostStats::host_of("localhost/index.html"));
+  EXPECT_EQ("localhost:8080", HostStats::host_of("/localhost:8080/dir/file"));
+  EXPECT_EQ("example.com", HostStats::host_of("http://example.com/"));
+  EXPECT_EQ("example.com", HostStats::host_of("example.com"));
+}
+
+
+TEST(HostStats, Record)
+{
+  HttpTiming t;
+  t.namelookup = 10;
+  t.connect = 110;
+  t.starttransfer = 1110;
+  t.total = 1610;
+  t.bytes = 4096;
+  t.status = 206;
+  HostStats::record("hoststats_test:80/a", t);
+
+  t.reused = true;
+  t.status = 404;
+  HostStats::record("hoststats_test:80/b", t);
+
+  HttpTiming e;
+  e.code = CURLE_COULDNT_CONNECT;
+  HostStats::record("hoststats_test:80/c", e);
+
+  EXPECT_TRUE(HostStats::find("nohost")==NULL);
+  HostStat* hs = HostStats::find("hoststats_test:80");
+  ASSERT_TRUE(hs!=NULL);
+  std::string r = hs->report();
+  EXPECT_NE(std::string::npos, r.find("requests: 3\n"));
+  EXPECT_NE(std::string::npos, r.find("bytes: 8192\n"));
+  EXPECT_NE(std::string::npos, r.find("new=2 reused=1 reuse_ratio=0.333"));
+  EXPECT_NE(std::string::npos, r.find("2xx=1 3xx=0 4xx=1 5xx=0 none=1"));
+  EXPECT_NE(std::string::npos, r.find("(7)=1"));
+  // connect = 110 - 10, wait = 1110 - 110, transfer = 1610 - 1110.
+  EXPECT_NE(std::string::npos, r.find("connect           100        100        100"));
+  EXPECT_NE(std::string::npos, r.find("transfer          500"));
+}
+
+
+int main(int argc, char* argv[])
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,103 @@
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include "mtrace.hxx"
+#include "../jsonscan.h"
+#include "../dirent.h"
+#include "../int64format.h"
+
+
+// random text of JSON-ish bytes, with quotes and brackets at every alignment.
+static std::string text(size_t len, unsigned seed)
+{
+  static const char chars[] = "abcdefgh \"\\{}[]:,0123456789\xe3\x81\x82";
+  std::string s;
+  srand(seed);
+  for(size_t ai=0; ai<len; ai++) {
+    s += (rand()%8==0)? chars[rand()%(sizeof(chars)-1)]: (char)('a' + rand()%26);
+  }
+  return s;
+}
+
+
+TEST(JsonScan, find)
+{
+  MTrace mt("JsonScan_find.mlog");
+
+  for(int isa=0; isa<JsonScan::ISAS; isa++) {
+    if(!JsonScan::use((JsonScan::ISA)isa)) continue;
+    for(unsigned seed=0; seed<50; seed++) {
+      std::string s = text(1 + seed*7, seed);
+      const char* end = s.data() + s.size();
+      for(const char* p=s.data(); p<end; p++) {
+        const char* q = p;
+        while((q<end) && (*q!='"') && (*q!='\\')) q++;
+        ASSERT_EQ(q, JsonScan::find_quote(p, end)) << JsonScan::isa_name((JsonScan::ISA)isa);
+        q = p;
+        while((q<end) && !strchr("\"{}[]", *q)) q++;
+        ASSERT_EQ(q, JsonScan::find_bracket(p, end)) << JsonScan::isa_name((JsonScan::ISA)isa);
+      }
+    }
+  }
+  EXPECT_TRUE(JsonScan::use(JsonScan::SCALAR));
+  EXPECT_EQ(JsonScan::SCALAR, JsonScan::isa());
+}
+
+TEST(JsonScan, skip_value)
+{
+  MTrace mt("JsonScan_skip_value.mlog");
+
+  const char* values[] = {
+    "\"a\\\"{b\"", "-1.5e3", "true", "null", "{}", "[[],{}]",
+    "{\"a\":[1,2,{\"b\":\"}]\"}],\"c\":\"\\\\\"}", "[\"abcdefghijklmnopqrstuvwxyz0123456789{\",[\"]\"]]",
+  };
+  for(int isa=0; isa<JsonScan::ISAS; isa++) {
+    if(!JsonScan::use((JsonScan::ISA)isa)) continue;
+    for(size_t ai=0; ai<sizeof(values)/sizeof(values[0]); ai++) {
+      std::string s = std::string("  ") + values[ai] + ",                                  ";
+      const char* p = JsonScan::skip_value(s.data(), s.data() + s.size());
+      ASSERT_TRUE(p!=NULL) << values[ai];
+      EXPECT_EQ(',', *p) << values[ai];
+      // truncated.
+      EXPECT_TRUE(JsonScan::skip_value(s.data(), s.data() + 2 + strlen(values[ai]) - 1)==NULL) << values[ai];
+    }
+  }
+  JsonScan::use(JsonScan::SCALAR);
+}
+
+TEST(JsonScan, listing)
+{
+  MTrace mt("JsonScan_listing.mlog");
+
+  std::string json = "{";
+  char t[256];
+  for(size_t ai=0; ai<1000; ai++) {
+    snprintf(t, sizeof(t), "%s\"%s%"FSIZET"u\\\"\":{\"mode\":\"-rw-r--r--\",\"x\":[{\"y\":\"%s\"}],\"size\":%"FSIZET"u}",
+             (ai==0)? "": ",", std::string(ai%50, 'n').c_str(), ai, std::string(ai%40, '}').c_str(), ai);
+    json += t;
+  }
+  json += "}";
+
+  JsonScan::use(JsonScan::SCALAR);
+  DirentList expect;
+  expect.from_json(json);
+  ASSERT_EQ(1000U, expect.size());
+  for(int isa=1; isa<JsonScan::ISAS; isa++) {
+    if(!JsonScan::use((JsonScan::ISA)isa)) continue;
+    DirentList dl;
+    dl.from_json(json);
+    ASSERT_EQ(expect.size(), dl.size());
+    for(size_t ai=0; ai<dl.size(); ai++) {
+      EXPECT_STREQ(expect.name(ai), dl.name(ai));
+      EXPECT_EQ(expect[ai].size, dl[ai].size);
+      EXPECT_EQ(expect[ai].mode, dl[ai].mode);
+    }
+  }
+  JsonScan::use(JsonScan::SCALAR);
+}
+
+
+int main(int argc, char* argv[])
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
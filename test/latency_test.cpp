@@ -0,0 +1,99 @@
+#include <gtest/gtest.h>
+#include <pthread.h>
+#include "mtrace.hxx"
+#include "../latency.h"
+#include "../int64format.h"
+
+
+TEST(Histogram, Index)
+{
+  for(uint64_t v=0; v<100000; v++) {
+    size_t i = Histogram::index(v);
+    ASSERT_LE(Histogram::lower(i), v);
+    ASSERT_GE(Histogram::upper(i), v);
+  }
+  EXPECT_EQ(0U, Histogram::index(0));
+  EXPECT_EQ(15U, Histogram::index(15));
+  EXPECT_EQ(16U, Histogram::index(16));
+  EXPECT_EQ((size_t)HISTOGRAM_BUCKETS-1, Histogram::index(~0ULL));
+  EXPECT_EQ((1ULL<<HISTOGRAM_MAX_BITS)-1, Histogram::upper(HISTOGRAM_BUCKETS-1));
+}
+
+
+TEST(Histogram, Percentile)
+{
+  MTrace mt("Histogram_Percentile.mlog");
+
+  Histogram h;
+  EXPECT_EQ(0U, h.percentile(0.5));
+  for(uint64_t v=1; v<=1000; v++) h.record(v * 1000);
+  EXPECT_EQ(1000U, h.count());
+  EXPECT_EQ(1000000U, h.max());
+  EXPECT_EQ(500500U, h.mean());
+  // within the precision of a bucket.
+  EXPECT_NEAR(500000, (double)h.percentile(0.5), 500000/16);
+  EXPECT_NEAR(900000, (double)h.percentile(0.9), 900000/16);
+  EXPECT_NEAR(990000, (double)h.percentile(0.99), 990000/16);
+  EXPECT_EQ(1000000U, h.percentile(1.0));
+}
+
+
+TEST(Histogram, Merge)
+{
+  MTrace mt("Histogram_Merge.mlog");
+
+  Histogram a, b;
+  a.record(10);
+  b.record(20);
+  b.record(3000);
+  a.merge(b);
+  EXPECT_EQ(3U, a.count());
+  EXPECT_EQ(3030U, a.sum());
+  EXPECT_EQ(3000U, a.max());
+  EXPECT_EQ(1U, a.bucket(Histogram::index(20)));
+  a.clear();
+  EXPECT_EQ(0U, a.count());
+}
+
+
+static void* record_main(void* ctx)
+{
+  for(int ai=0; ai<1000; ai++) {
+    LatencyTimer lt(Latency::READ);
+    if(ai%4==0) Latency::remote();
+  }
+  return NULL;
+}
+
+
+TEST(Latency, Threads)
+{
+  uint64_t hit = Latency::merged(Latency::READ, Latency::HIT).count();
+  uint64_t miss = Latency::merged(Latency::READ, Latency::MISS).count();
+  pthread_t th[4];
+  for(int ai=0; ai<4; ai++) pthread_create(&th[ai], NULL, record_main, NULL);
+  for(int ai=0; ai<4; ai++) pthread_join(th[ai], NULL);
+  EXPECT_EQ(hit + 3000, Latency::merged(Latency::READ, Latency::HIT).count());
+  EXPECT_EQ(miss + 1000, Latency::merged(Latency::READ, Latency::MISS).count());
+}
+
+
+TEST(Latency, Nested)
+{
+  uint64_t open = Latency::merged(Latency::OPEN, Latency::HIT).count();
+  uint64_t read = Latency::merged(Latency::READ, Latency::HIT).count();
+  {
+    LatencyTimer outer(Latency::OPEN);
+    LatencyTimer inner(Latency::READ);
+  }
+  EXPECT_EQ(open + 1, Latency::merged(Latency::OPEN, Latency::HIT).count());
+  EXPECT_EQ(read, Latency::merged(Latency::READ, Latency::HIT).count());
+  EXPECT_NE(std::string::npos, Latency::report().find("open       hit           1"));
+}
+
+
+int main(int argc, char* argv[])
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,67 @@
+// Cost of a filtered DEBUG message at the top of a fuse operation.
+//   $ make log_bench && ./log_bench
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <string>
+#include "../log.h"
+#include "../ext/time_iso8601.h"
+#include "../int64format.h"
+
+#define LOOPS (2000000)
+
+static Log blog("log_bench", LOG_LOCAL7, Log::NOTE);
+static const char* path = "/localhost/dir/file.txt";
+static volatile time_t mtime = 1286000000;
+
+
+static uint64_t now_usec()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1000000ULL + tv.tv_usec;
+}
+
+
+// arguments are evaluated before the level is checked.
+static void __attribute__((noinline)) op_call()
+{
+  blog(Log::DEBUG, "   RemoteAttr::get_attr(%s:FIND): %05o %s\n", path, 0644,
+       ((std::string)TimeIso8601(mtime)).c_str());
+}
+
+
+// the level is checked first.
+static void __attribute__((noinline)) op_macro()
+{
+  LOG(blog, Log::DEBUG, "   RemoteAttr::get_attr(%s:FIND): %05o %s\n", path, 0644,
+      ((std::string)TimeIso8601(mtime)).c_str());
+}
+
+
+// as a release build.
+#undef  LOG_BUILD_LEVEL
+#define LOG_BUILD_LEVEL LOG_INFO
+static void __attribute__((noinline)) op_elided()
+{
+  LOG(blog, Log::DEBUG, "   RemoteAttr::get_attr(%s:FIND): %05o %s\n", path, 0644,
+      ((std::string)TimeIso8601(mtime)).c_str());
+}
+
+
+static void bench(const char* name, void (*op)())
+{
+  uint64_t s = now_usec();
+  for(int ai=0; ai<LOOPS; ai++) op();
+  uint64_t e = now_usec();
+  printf("%-28s %8.2f ns/op\n", name, (e - s) * 1000.0 / LOOPS);
+}
+
+
+int main(int argc, char* argv[])
+{
+  bench("glog(Log::DEBUG, ...)", op_call);
+  bench("LOG(glog, Log::DEBUG, ...)", op_macro);
+  bench("LOG_BUILD_LEVEL=LOG_INFO", op_elided);
+  return 0;
+}
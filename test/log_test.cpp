@@ -0,0 +1,159 @@
+#include <gtest/gtest.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string>
+#include "mtrace.hxx"
+#include "../log.h"
+#include "../int64format.h"
+
+
+// discard stdout while logging.
+class Quiet
+{
+public:
+  inline Quiet() {
+    fflush(stdout);
+    m_fd = dup(1);
+    int nul = open("/dev/null", O_WRONLY);
+    dup2(nul, 1);
+    close(nul);
+  };
+  inline ~Quiet() {
+    fflush(stdout);
+    dup2(m_fd, 1);
+    close(m_fd);
+  };
+
+private:
+  int m_fd;
+};
+
+
+static Log tlog("log_test", LOG_LOCAL7, Log::NOTE);
+
+static void* log_main(void* ctx)
+{
+  for(int ai=0; ai<50; ai++) {
+    tlog(Log::NOTE, "log_test: thread=%d, n=%d\n", (int)(intptr_t)ctx, ai);
+    tlog(Log::DEBUG, "log_test: filtered\n");
+  }
+  return NULL;
+}
+
+
+TEST(Log, Synchronous)
+{
+  Quiet q;
+  uint64_t w = Log::written();
+  tlog(Log::NOTE, "log_test: synchronous\n");
+  tlog(Log::VERBOSE, "log_test: filtered\n");
+  EXPECT_EQ(w + 1, Log::written());
+}
+
+
+TEST(Log, Ring)
+{
+  Quiet q;
+  uint64_t w = Log::written() + Log::dropped();
+  Log::start();
+  pthread_t th[4];
+  for(int ai=0; ai<4; ai++) pthread_create(&th[ai], NULL, log_main, (void*)(intptr_t)ai);
+  for(int ai=0; ai<4; ai++) pthread_join(th[ai], NULL);
+  Log::stop();
+  EXPECT_EQ(w + 200, Log::written() + Log::dropped());
+}
+
+
+TEST(Log, Overflow)
+{
+  Quiet q;
+  uint64_t w = Log::written(), d = Log::dropped();
+  Log::start();
+  for(int ai=0; ai<LOG_RING_SLOTS*4; ai++) {
+    tlog(Log::NOTE, "log_test: %d %s\n", ai, "a message to fill the ring buffer");
+  }
+  Log::stop();
+  EXPECT_EQ((uint64_t)LOG_RING_SLOTS*4, (Log::written() - w) + (Log::dropped() - d));
+  EXPECT_LE((uint64_t)LOG_RING_SLOTS, Log::written() - w);
+}
+
+
+// stdout written while it lives.
+class Capture
+{
+public:
+  inline Capture() {
+    fflush(stdout);
+    m_fd = dup(1);
+    m_file = tmpfile();
+    dup2(fileno(m_file), 1);
+  };
+  inline ~Capture() {
+    restore();
+    fclose(m_file);
+  };
+  inline std::string text() {
+    restore();
+    std::string s;
+    char buf[4096];
+    size_t n;
+    rewind(m_file);
+    while((n = fread(buf, 1, sizeof(buf), m_file))>0) s.append(buf, n);
+    return s;
+  };
+
+private:
+  int m_fd;
+  FILE* m_file;
+  inline void restore() {
+    if(m_fd<0) return;
+    fflush(stdout);
+    dup2(m_fd, 1);
+    close(m_fd);
+    m_fd = -1;
+  };
+};
+
+
+TEST(Log, Long)
+{
+  std::string url = "http:/";
+  while(url.size()<PATH_MAX) url += "/a-directory-name";
+  uint64_t w = Log::written(), d = Log::dropped(), t = Log::truncated();
+
+  // a message longer than a record is written whole.
+  Capture c;
+  Log::start();
+  tlog(Log::NOTE, "log_test: %s\n", url.c_str());
+  tlog(Log::NOTE, "log_test: next\n");
+  Log::stop();
+  EXPECT_EQ("[5] log_test: " + url + "\n[5] log_test: next\n", c.text());
+  EXPECT_EQ(w + 2, Log::written());
+  EXPECT_EQ(d, Log::dropped());
+  EXPECT_EQ(t, Log::truncated());
+}
+
+
+TEST(Log, Truncated)
+{
+  std::string text(LOG_MESSAGE_MAX * 2, 'x');
+  uint64_t w = Log::written(), t = Log::truncated();
+
+  Capture c;
+  Log::start();
+  tlog(Log::NOTE, "log_test: %s\n", text.c_str());
+  Log::stop();
+  std::string out = c.text();
+  EXPECT_EQ(w + 1, Log::written());
+  EXPECT_EQ(t + 1, Log::truncated());
+  EXPECT_EQ(strlen("[5] ") + LOG_MESSAGE_MAX - 1, out.size());
+  EXPECT_EQ('\n', out[out.size()-1]);
+}
+
+
+int main(int argc, char* argv[])
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,81 @@
+#include <gtest/gtest.h>
+#include <string>
+#include "mtrace.hxx"
+#include "../metrics.h"
+#include "../int64format.h"
+
+
+static std::string text(const MetricsBuffer& m)
+{
+  return std::string(m.data(), m.size());
+}
+
+
+TEST(MetricsBuffer, Value)
+{
+  MTrace mt("MetricsBuffer_Value.mlog");
+
+  MetricsBuffer m;
+  m.family("test_total", "counter", "Test counter.");
+  m.value("test_total", NULL, (uint64_t)3);
+  m.value("test_total", "a=\"b\"", (uint64_t)4);
+  m.value("test_seconds", "", 0.25);
+  EXPECT_EQ("# HELP test_total Test counter.\n# TYPE test_total counter\n"
+            "test_total 3\ntest_total{a=\"b\"} 4\ntest_seconds 0.25\n", text(m));
+
+  m.clear();
+  EXPECT_EQ(0U, m.size());
+}
+
+
+TEST(MetricsBuffer, Reuse)
+{
+  MTrace mt("MetricsBuffer_Reuse.mlog");
+
+  MetricsBuffer m;
+  size_t initial = m.capacity();
+  for(int ai=0; ai<10000; ai++) m.value("test_value", "n=\"x\"", (uint64_t)ai);
+  EXPECT_LT(initial, m.capacity());
+  EXPECT_EQ("test_value{n=\"x\"} 9999\n", text(m).substr(m.size() - 23));
+
+  size_t grown = m.capacity();
+  const char* p = m.data();
+  m.clear();
+  for(int ai=0; ai<10000; ai++) m.value("test_value", "n=\"x\"", (uint64_t)ai);
+  EXPECT_EQ(grown, m.capacity());
+  EXPECT_EQ(p, m.data());
+}
+
+
+TEST(MetricsBuffer, Histogram)
+{
+  MTrace mt("MetricsBuffer_Histogram.mlog");
+
+  Histogram h;
+  h.record(3);
+  h.record(1000);
+  h.record(1000000);
+  MetricsBuffer m;
+  m.histogram("test_seconds", "op=\"read\"", h, 1e-9);
+  std::string t = text(m);
+  EXPECT_NE(std::string::npos, t.find("test_seconds_bucket{op=\"read\",le=\"1e-09\"} 0\n"));
+  EXPECT_NE(std::string::npos, t.find("test_seconds_bucket{op=\"read\",le=\"4e-09\"} 1\n"));
+  EXPECT_NE(std::string::npos, t.find("test_seconds_bucket{op=\"read\",le=\"1.024e-06\"} 2\n"));
+  EXPECT_NE(std::string::npos, t.find("test_seconds_bucket{op=\"read\",le=\"+Inf\"} 3\n"));
+  EXPECT_NE(std::string::npos, t.find("test_seconds_sum{op=\"read\"} 0.001001003\n"));
+  EXPECT_NE(std::string::npos, t.find("test_seconds_count{op=\"read\"} 3\n"));
+
+  m.clear();
+  m.summary("test_seconds", NULL, h, 1e-9);
+  t = text(m);
+  EXPECT_NE(std::string::npos, t.find("test_seconds{quantile=\"0.5\"} "));
+  EXPECT_NE(std::string::npos, t.find("test_seconds{quantile=\"0.999\"} 0.001\n"));
+  EXPECT_NE(std::string::npos, t.find("test_seconds_count 3\n"));
+}
+
+
+int main(int argc, char* argv[])
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
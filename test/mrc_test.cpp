@@ -0,0 +1,93 @@
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <math.h>
+#include <list>
+#include <map>
+#include "mtrace.hxx"
+#include "../mrc.h"
+#include "../int64format.h"
+
+
+// hit ratio of an exact LRU cache of 'size' keys.
+static double lru_hit_ratio(const std::vector<uint64_t>& keys, size_t size)
+{
+  std::list<uint64_t> lru;
+  std::map<uint64_t, std::list<uint64_t>::iterator> index;
+  uint64_t hits = 0;
+  for(size_t i=0; i<keys.size(); i++) {
+    std::map<uint64_t, std::list<uint64_t>::iterator>::iterator it = index.find(keys[i]);
+    if(it!=index.end()) {
+      hits++;
+      lru.erase((*it).second);
+    } else if(lru.size()>=size) {
+      index.erase(lru.back());
+      lru.pop_back();
+    }
+    lru.push_front(keys[i]);
+    index[keys[i]] = lru.begin();
+  }
+  return (double)hits / keys.size();
+}
+
+
+TEST(MissRatioCurve, Cyclic)
+{
+  MissRatioCurve mrc(1024);
+  // 100 keys, 10 rounds: LRU hits all but the first round with 100 entries, none with less.
+  for(int round=0; round<10; round++) {
+    for(uint64_t k=0; k<100; k++) mrc.access(MissRatioCurve::mix(k));
+  }
+  EXPECT_EQ(1000U, mrc.accesses());
+  EXPECT_EQ(1000U, mrc.sampled());
+  EXPECT_NEAR(1.0, mrc.rate(), 1e-9);
+  EXPECT_NEAR(0.0, mrc.hit_ratio(64), 0.01);
+  EXPECT_NEAR(0.9, mrc.hit_ratio(100), 0.01);
+  EXPECT_NEAR(0.9, mrc.hit_ratio(1000), 0.01);
+}
+
+
+TEST(MissRatioCurve, Sampled)
+{
+  MissRatioCurve mrc(256);
+  for(int round=0; round<5; round++) {
+    for(uint64_t k=0; k<20000; k++) mrc.access(MissRatioCurve::mix(k));
+  }
+  EXPECT_EQ(100000U, mrc.accesses());
+  EXPECT_LT(mrc.rate(), 0.02);
+  EXPECT_LT(mrc.sampled(), 10000U);
+  EXPECT_NEAR(0.0, mrc.hit_ratio(10000), 0.05);
+  EXPECT_NEAR(0.8, mrc.hit_ratio(40000), 0.05);
+}
+
+
+TEST(MissRatioCurve, Skewed)
+{
+  MTrace mt("MissRatioCurve_Skewed.mlog");
+
+  // skewed popularity over 50000 keys.
+  srand(1);
+  std::vector<uint64_t> keys;
+  for(int ai=0; ai<300000; ai++) {
+    double u = (rand() + 1.0) / (RAND_MAX + 2.0);
+    keys.push_back((uint64_t)(50000 * pow(u, 3.0)));
+  }
+
+  MissRatioCurve mrc(2048);
+  for(size_t i=0; i<keys.size(); i++) mrc.access(MissRatioCurve::mix(keys[i]));
+  size_t sizes[] = { 500, 2000, 8000, 32000 };
+  for(int ai=0; ai<4; ai++) {
+    EXPECT_NEAR(lru_hit_ratio(keys, sizes[ai]), mrc.hit_ratio(sizes[ai]), 0.05) << "size: " << sizes[ai];
+  }
+
+  std::string r = mrc.report("attr", 1, 4, 6);
+  EXPECT_NE(std::string::npos, r.find("# attr: accesses=300000 "));
+  EXPECT_NE(std::string::npos, r.find("size(entries)"));
+  EXPECT_NE(std::string::npos, r.find("\nattr                 64 "));
+}
+
+
+int main(int argc, char* argv[])
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,780 @@
+// Local stand-in origin speaking the mod_index_json conventions, for benchmarks.
+//   $ make origin_server && ./origin_server [--port=8124] [--threads=N] [--fanout=N] [--depth=N] [--files=N]
+//        [--size=BYTES] [--fixed_size] [--rtt_ms=N] [--bandwidth=BYTES] [--error_rate=R] [--no_range] [--etag_churn=SEC]
+//        [--no_binary]
+//   $ autohttpfs /mnt/http && ls /mnt/http/localhost:8124/d3/d1/
+//
+// The tree is synthesized from its parameters, nothing is stored:
+//   every directory above 'depth' has 'fanout' subdirectories "d0".."d<fanout-1>",
+//   and every directory has 'files' regular files "f0".."f<files-1>".
+//   e.g. --fanout=10 --depth=3 --files=1000 serves 1111 directories and 1,111,000 files.
+// A file is 0..'size' bytes (by the hash of its path, or 'size' by --fixed_size), and its content is a function
+// of the path, the offset and the ETag generation (see content()).
+//
+// requests:
+//   HEAD/GET "dir/"    200 text/json with X-FileStat-Json. GET returns the listing
+//                      '{"name":{"mode":..,"size":..,"mtime":..},..}' when Accept has text/json,
+//                      in DIRENT_BINARY_TYPE (see DirentBinary of dirent.h) when Accept has it, 403 otherwise.
+//   HEAD/GET "dir"     301 to "dir/", with X-FileStat-Json.
+//   HEAD/GET "file"    200 with X-FileStat-Json, ETag, Last-Modified and Accept-Ranges.
+//                      GET with "Range: bytes=" is answered by 206 (or 416).
+//   GET "/.stats"      counters in JSON.
+//
+// faults:
+//   --rtt_ms=N        every response is delayed by N msec after its request is read.
+//   --bandwidth=N     bytes/sec per connection.
+//   --error_rate=R    ratio of requests answered by 503.
+//   --no_range        Range is ignored, and the whole file is returned by 200.
+//   --etag_churn=SEC  ETag, mtime and the content of files change every SEC seconds.
+//   --no_binary       listings are in text/json only, as servers without the binary listing.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+#include "../dirent.h"
+#include "../int64format.h"
+
+#define MAX_REQUEST   (64*1024)
+#define SEND_CHUNK    (64*1024)
+#define MAX_EVENTS    (256)
+
+
+// parameters.
+static int      g_port = 8124;
+static int      g_threads = 1;
+static uint64_t g_fanout = 10;
+static uint64_t g_depth = 3;
+static uint64_t g_files = 1000;
+static uint64_t g_size = 64*1024;
+static bool     g_fixed_size = false;
+static uint64_t g_rtt_ns = 0;
+static uint64_t g_bandwidth = 0;
+static double   g_error_rate = 0;
+static bool     g_no_range = false;
+static bool     g_no_binary = false;
+static uint64_t g_etag_churn = 0;
+static time_t   g_started;
+static volatile bool g_stop = false;
+
+// counters.
+static volatile uint64_t g_connections = 0;
+static volatile uint64_t g_requests = 0;
+static volatile uint64_t g_listings = 0;
+static volatile uint64_t g_ranges = 0;
+static volatile uint64_t g_errors = 0;
+static volatile uint64_t g_bytes = 0;
+static volatile uint64_t g_status[6] = { 0, 0, 0, 0, 0, 0 };   // by status/100.
+
+
+static inline uint64_t now_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec*1000000000ULL + ts.tv_nsec;
+}
+
+
+static inline uint64_t mix(uint64_t h)
+{
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+
+static std::string iso8601(time_t t)
+{
+  struct tm tm;
+  char r[64];
+  gmtime_r(&t, &tm);
+  strftime(r, sizeof(r), "%Y-%m-%dT%H:%M:%S+0000", &tm);
+  return r;
+}
+
+
+static std::string rfc1123(time_t t)
+{
+  struct tm tm;
+  char r[64];
+  gmtime_r(&t, &tm);
+  strftime(r, sizeof(r), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+  return r;
+}
+
+
+// A directory or a file of the synthetic tree.
+class Node
+{
+public:
+  bool      dir;
+  uint64_t  level;  // directories above.
+  uint64_t  id;     // hash of the path.
+  std::string name;
+
+  // "/d1/d2/f3" => file f3 of level 2. false when it is not in the tree.
+  bool resolve(const std::string& path) {
+    dir = true;
+    level = 0;
+    id = 0xcbf29ce484222325ULL;
+    name = "/";
+    size_t p = 1;
+    while(p<path.length()) {
+      size_t e = path.find('/', p);
+      if(e==std::string::npos) e = path.length();
+      std::string c = path.substr(p, e-p);
+      p = e + 1;
+      uint64_t n;
+      if(!dir || !number(c, n)) return false;
+      if((c[0]=='d') && (n<g_fanout) && (level<g_depth)) {
+        level++;
+      } else if((c[0]=='f') && (n<g_files)) {
+        dir = false;
+      } else {
+        return false;
+      }
+      for(size_t ai=0; ai<c.length(); ai++) id = (id ^ (unsigned char)c[ai]) * 0x100000001b3ULL;
+      id = (id ^ '/') * 0x100000001b3ULL;
+      name = c;
+    }
+    return true;
+  };
+
+  inline uint64_t generation() const {
+    return (g_etag_churn>0)? (time(NULL) - g_started) / g_etag_churn: 0;
+  };
+  inline uint64_t size() const { return dir? 4096: (g_fixed_size? g_size: mix(id) % (g_size+1)); };
+  inline time_t mtime() const {
+    if(dir) return g_started;
+    return g_started - (time_t)(mix(id+1) % (365*86400)) + generation()*g_etag_churn;
+  };
+  std::string etag() const {
+    char r[64];
+    snprintf(r, sizeof(r), "\"%"FINT64"x-%"FINT64"x-%"FINT64"x\"", id, size(), generation());
+    return r;
+  };
+  std::string stat_json() const {
+    char r[128];
+    snprintf(r, sizeof(r), "{\"mode\":\"%s\",\"size\":%"FINT64"u,\"mtime\":\"%s\"}",
+             dir? "drwxr-xr-x": "-rw-r--r--", size(), iso8601(mtime()).c_str());
+    return r;
+  };
+  std::string x_filestat() const { return "{\"" + name + "\":" + stat_json() + "}"; };
+
+  // byte at 'offset' of the file.
+  static inline unsigned char content(uint64_t seed, uint64_t offset) {
+    return (unsigned char)(mix(seed + (offset>>3)) >> ((offset&7)*8));
+  };
+  inline uint64_t seed() const { return mix(id ^ generation()); };
+  static void fill(unsigned char* buf, uint64_t seed, uint64_t offset, size_t size) {
+    size_t ai = 0;
+    for(; (ai<size) && ((offset+ai)&7); ai++) buf[ai] = content(seed, offset+ai);
+    for(; ai+8<=size; ai+=8) {
+      uint64_t v = mix(seed + ((offset+ai)>>3));
+      for(int b=0; b<8; b++) buf[ai+b] = (unsigned char)(v >> (b*8));
+    }
+    for(; ai<size; ai++) buf[ai] = content(seed, offset+ai);
+  };
+
+  // listing of the directory 'path' (with the trailing '/').
+  std::string listing(const std::string& path) const {
+    std::string r = "{";
+    r.reserve((g_fanout+g_files)*80);
+    char t[32];
+    Node c;
+    for(uint64_t ai=0; (level<g_depth) && (ai<g_fanout); ai++) {
+      snprintf(t, sizeof(t), "d%"FINT64"u", ai);
+      c.resolve(path + t);
+      r += (r.length()>1)? ",\"": "\"";
+      r += c.name + "\":" + c.stat_json();
+    }
+    for(uint64_t ai=0; ai<g_files; ai++) {
+      snprintf(t, sizeof(t), "f%"FINT64"u", ai);
+      c.resolve(path + t);
+      r += (r.length()>1)? ",\"": "\"";
+      r += c.name + "\":" + c.stat_json();
+    }
+    return r + "}\n";
+  };
+
+  // the same in DirentBinary.
+  std::string listing_binary(const std::string& path) const {
+    std::string r;
+    r.reserve((g_fanout+g_files)*(DirentBinary::RECORD+8) + DirentBinary::HEADER + 2);
+    DirentBinary::header(r);
+    char t[32];
+    Node c;
+    for(uint64_t ai=0; (level<g_depth) && (ai<g_fanout); ai++) {
+      snprintf(t, sizeof(t), "d%"FINT64"u", ai);
+      c.resolve(path + t);
+      DirentBinary::entry(r, c.name.data(), c.name.length(), S_IFDIR|0755, c.size(), c.mtime());
+    }
+    for(uint64_t ai=0; ai<g_files; ai++) {
+      snprintf(t, sizeof(t), "f%"FINT64"u", ai);
+      c.resolve(path + t);
+      DirentBinary::entry(r, c.name.data(), c.name.length(), S_IFREG|0644, c.size(), c.mtime());
+    }
+    DirentBinary::end(r);
+    return r;
+  };
+
+private:
+  // "d12" => 12. Leading zeros are not in the tree.
+  static bool number(const std::string& c, uint64_t& n) {
+    if((c.length()<2) || (c.length()>20) || ((c[1]=='0') && (c.length()>2))) return false;
+    n = 0;
+    for(size_t ai=1; ai<c.length(); ai++) {
+      if((c[ai]<'0') || (c[ai]>'9')) return false;
+      n = n*10 + (c[ai]-'0');
+    }
+    return true;
+  };
+};
+
+
+// A client connection: one request is read, delayed, then written.
+class Connection
+{
+public:
+  typedef enum { READ, WAIT, WRITE } STATE;
+  int       fd;
+  STATE     state;
+  uint64_t  wake;         // timer, or 0.
+  std::string in;
+  std::string head;       // response header and small bodies.
+  size_t    head_sent;
+  uint64_t  body_seed;    // file content in [body_pos, body_end).
+  uint64_t  body_pos;
+  uint64_t  body_end;
+  uint64_t  started;      // of the response, for the bandwidth.
+  uint64_t  sent;
+  bool      keep_alive;
+
+  Connection(int _fd): fd(_fd), state(READ), wake(0), head_sent(0), body_seed(0), body_pos(0), body_end(0),
+                       started(0), sent(0), keep_alive(true) {};
+};
+
+
+// An epoll loop, one per thread, on its own SO_REUSEPORT socket.
+class Server
+{
+public:
+  Server(): m_listen(-1), m_epoll(-1), m_random(0) {};
+  bool init(uint64_t seed);
+  void run();
+
+private:
+  int       m_listen;
+  int       m_epoll;
+  uint64_t  m_random;
+  std::map<int, Connection*> m_conns;
+  std::set<std::pair<uint64_t, int> > m_timers;
+
+  void accept_all();
+  void on_read(Connection* c);
+  void on_write(Connection* c);
+  void on_timer(Connection* c);
+  int  next(Connection* c);
+  int  parse(Connection* c);
+  void respond(Connection* c, const std::string& method, const std::string& target,
+               const std::string& accept, const std::string& range);
+  void header(Connection* c, int status, const char* reason, const std::string& extra, uint64_t length);
+  void schedule(Connection* c, uint64_t at);
+  void watch(Connection* c, uint32_t events);
+  void close(Connection* c);
+  inline double uniform() {
+    m_random ^= m_random >> 12;
+    m_random ^= m_random << 25;
+    m_random ^= m_random >> 27;
+    return ((m_random * 0x2545f4914f6cdd1dULL) >> 11) / (double)(1ULL<<53);
+  };
+};
+
+
+bool Server::init(uint64_t seed)
+{
+  m_random = seed*0x9e3779b97f4a7c15ULL + 1;
+  m_listen = socket(AF_INET, SOCK_STREAM|SOCK_NONBLOCK, 0);
+  int one = 1;
+  setsockopt(m_listen, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  setsockopt(m_listen, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(g_port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if((bind(m_listen, (struct sockaddr*)&addr, sizeof(addr))<0) || (listen(m_listen, 1024)<0)) {
+    fprintf(stderr, "bind/listen(%d): %s\n", g_port, strerror(errno));
+    return false;
+  }
+  m_epoll = epoll_create(MAX_EVENTS);
+  struct epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.fd = m_listen;
+  epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_listen, &ev);
+  return true;
+}
+
+
+void Server::run()
+{
+  struct epoll_event events[MAX_EVENTS];
+  while(!g_stop) {
+    int timeout = 100;
+    if(!m_timers.empty()) {
+      uint64_t now = now_ns(), at = m_timers.begin()->first;
+      int t = (at>now)? (int)((at-now+999999)/1000000): 0;
+      if(t<timeout) timeout = t;
+    }
+    int n = epoll_wait(m_epoll, events, MAX_EVENTS, timeout);
+    for(int ai=0; ai<n; ai++) {
+      if(events[ai].data.fd==m_listen) {
+        accept_all();
+        continue;
+      }
+      std::map<int, Connection*>::iterator it = m_conns.find(events[ai].data.fd);
+      if(it==m_conns.end()) continue;
+      Connection* c = (*it).second;
+      if(events[ai].events & (EPOLLERR|EPOLLHUP)) {
+        close(c);
+      } else if(events[ai].events & EPOLLIN) {
+        on_read(c);
+      } else if((events[ai].events & EPOLLOUT) && (c->state==Connection::WRITE)) {
+        on_write(c);
+      }
+    }
+
+    uint64_t now = now_ns();
+    while(!m_timers.empty() && (m_timers.begin()->first<=now)) {
+      int fd = m_timers.begin()->second;
+      m_timers.erase(m_timers.begin());
+      std::map<int, Connection*>::iterator it = m_conns.find(fd);
+      if(it!=m_conns.end()) on_timer((*it).second);
+    }
+  }
+
+  while(!m_conns.empty()) close((*m_conns.begin()).second);
+  ::close(m_epoll);
+  ::close(m_listen);
+}
+
+
+void Server::accept_all()
+{
+  for(;;) {
+    int fd = accept4(m_listen, NULL, NULL, SOCK_NONBLOCK);
+    if(fd<0) return;
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    Connection* c = new Connection(fd);
+    m_conns[fd] = c;
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    epoll_ctl(m_epoll, EPOLL_CTL_ADD, fd, &ev);
+    __sync_fetch_and_add(&g_connections, 1);
+  }
+}
+
+
+void Server::on_read(Connection* c)
+{
+  char buf[16*1024];
+  for(;;) {
+    ssize_t r = recv(c->fd, buf, sizeof(buf), 0);
+    if(r==0) {
+      close(c);
+      return;
+    }
+    if(r<0) {
+      if(errno==EINTR) continue;
+      if(errno==EAGAIN) break;
+      close(c);
+      return;
+    }
+    c->in.append(buf, r);
+  }
+  // pipelined requests are kept while a response is pending.
+  if(c->in.length()>MAX_REQUEST*16) {
+    close(c);
+    return;
+  }
+  if(c->state!=Connection::READ) return;
+  switch(next(c)) {
+  case -1: close(c); break;
+  case 1:  on_write(c); break;
+  }
+}
+
+
+void Server::on_timer(Connection* c)
+{
+  c->wake = 0;
+  if(c->state==Connection::WAIT) {
+    c->state = Connection::WRITE;
+    c->started = now_ns();
+  }
+  if(c->state==Connection::WRITE) on_write(c);
+}
+
+
+// starts the next request in the buffer. 1: to be written now, 0: waiting, -1: to be closed.
+int Server::next(Connection* c)
+{
+  int r = parse(c);
+  if(r<=0) {
+    if(r==0) watch(c, EPOLLIN);
+    return r;
+  }
+  c->sent = 0;
+  if(g_rtt_ns>0) {
+    c->state = Connection::WAIT;
+    schedule(c, now_ns() + g_rtt_ns);
+    watch(c, EPOLLIN);
+    return 0;
+  }
+  c->state = Connection::WRITE;
+  c->started = now_ns();
+  return 1;
+}
+
+
+void Server::on_write(Connection* c)
+{
+  static __thread unsigned char buf[SEND_CHUNK];
+  for(;;) {
+    // header and small bodies.
+    while(c->head_sent<c->head.length()) {
+      ssize_t w = send(c->fd, c->head.data()+c->head_sent, c->head.length()-c->head_sent, MSG_NOSIGNAL);
+      if(w<0) {
+        if(errno==EINTR) continue;
+        if(errno==EAGAIN) {
+          watch(c, EPOLLIN|EPOLLOUT);
+          return;
+        }
+        close(c);
+        return;
+      }
+      c->head_sent += w;
+      __sync_fetch_and_add(&g_bytes, w);
+    }
+
+    // file content.
+    while(c->body_pos<c->body_end) {
+      size_t n = c->body_end - c->body_pos;
+      if(n>SEND_CHUNK) n = SEND_CHUNK;
+      if(g_bandwidth>0) {
+        // tokens of 'bandwidth' per sec, up to 16KB of burst.
+        uint64_t now = now_ns(), burst = 16*1024;
+        double budget = g_bandwidth * ((now - c->started) / 1e9) + burst - c->sent;
+        if(budget<4096 && budget<n) {
+          uint64_t want = (n<4096)? n: 4096;
+          schedule(c, now + (uint64_t)((want - budget) * 1e9 / g_bandwidth) + 1);
+          watch(c, EPOLLIN);
+          return;
+        }
+        if(n>budget) n = (size_t)budget;
+      }
+      Node::fill(buf, c->body_seed, c->body_pos, n);
+      ssize_t w = send(c->fd, buf, n, MSG_NOSIGNAL);
+      if(w<0) {
+        if(errno==EINTR) continue;
+        if(errno==EAGAIN) {
+          watch(c, EPOLLIN|EPOLLOUT);
+          return;
+        }
+        close(c);
+        return;
+      }
+      c->body_pos += w;
+      c->sent += w;
+      __sync_fetch_and_add(&g_bytes, w);
+    }
+
+    // done.
+    if(!c->keep_alive) {
+      close(c);
+      return;
+    }
+    c->state = Connection::READ;
+    c->head.clear();
+    c->head_sent = 0;
+    switch(next(c)) {
+    case -1: close(c); return;
+    case 0:  return;
+    }
+  }
+}
+
+
+// a request in the buffer to a response. 1: ready, 0: incomplete, -1: malformed.
+int Server::parse(Connection* c)
+{
+  size_t e = c->in.find("\r\n\r\n");
+  if(e==std::string::npos) return (c->in.length()>MAX_REQUEST)? -1: 0;
+  std::string req = c->in.substr(0, e+2);
+  c->in.erase(0, e+4);
+
+  size_t l = req.find("\r\n");
+  std::string line = req.substr(0, l);
+  size_t s1 = line.find(' '), s2 = line.rfind(' ');
+  if((s1==std::string::npos) || (s1==s2)) return -1;
+  std::string method = line.substr(0, s1);
+  std::string target = line.substr(s1+1, s2-s1-1);
+  std::string version = line.substr(s2+1);
+  c->keep_alive = (version!="HTTP/1.0");
+
+  std::string accept, range;
+  for(size_t p=l+2; p<req.length(); ) {
+    size_t q = req.find("\r\n", p);
+    std::string h = req.substr(p, q-p);
+    p = q + 2;
+    size_t colon = h.find(':');
+    if(colon==std::string::npos) continue;
+    std::string v = h.substr(colon+1);
+    v.erase(0, v.find_first_not_of(" \t"));
+    h.erase(colon);
+    if(strcasecmp(h.c_str(), "Accept")==0) accept = v;
+    else if(strcasecmp(h.c_str(), "Range")==0) range = v;
+    else if(strcasecmp(h.c_str(), "Connection")==0) {
+      if(strcasecmp(v.c_str(), "close")==0) c->keep_alive = false;
+      if(strcasecmp(v.c_str(), "keep-alive")==0) c->keep_alive = true;
+    }
+  }
+  respond(c, method, target, accept, range);
+  __sync_fetch_and_add(&g_requests, 1);
+  return 1;
+}
+
+
+void Server::respond(Connection* c, const std::string& method, const std::string& _target,
+                     const std::string& accept, const std::string& range)
+{
+  c->body_pos = c->body_end = 0;
+  std::string target = _target.substr(0, _target.find_first_of("?#"));
+  bool head = (method=="HEAD");
+
+  if(target=="/.stats") {
+    char t[512];
+    snprintf(t, sizeof(t), "{\"connections\":%"FINT64"u,\"requests\":%"FINT64"u,\"listings\":%"FINT64"u,"
+             "\"ranges\":%"FINT64"u,\"errors\":%"FINT64"u,\"bytes\":%"FINT64"u,\"status\":{\"1xx\":%"FINT64"u,"
+             "\"2xx\":%"FINT64"u,\"3xx\":%"FINT64"u,\"4xx\":%"FINT64"u,\"5xx\":%"FINT64"u}}\n",
+             g_connections, g_requests, g_listings, g_ranges, g_errors, g_bytes,
+             g_status[1], g_status[2], g_status[3], g_status[4], g_status[5]);
+    header(c, 200, "OK", "Content-Type: text/json\r\n", strlen(t));
+    if(!head) c->head += t;
+    return;
+  }
+  if(uniform()<g_error_rate) {
+    __sync_fetch_and_add(&g_errors, 1);
+    header(c, 503, "Service Unavailable", "Retry-After: 1\r\n", 0);
+    return;
+  }
+  if(!head && (method!="GET")) {
+    header(c, 405, "Method Not Allowed", "Allow: GET, HEAD\r\n", 0);
+    return;
+  }
+
+  bool slash = (target.length()>1) && (target[target.length()-1]=='/');
+  std::string path = slash? target.substr(0, target.length()-1): target;
+  Node node;
+  if(path.empty() || (path[0]!='/') || !node.resolve(path) || (slash && !node.dir)) {
+    header(c, 404, "Not Found", "", 0);
+    return;
+  }
+  std::string extra = "X-FileStat-Json: " + node.x_filestat() + "\r\n";
+
+  // directory.
+  if(node.dir) {
+    if(!slash && (path!="/")) {
+      header(c, 301, "Moved Permanently", extra + "Location: " + path + "/\r\n", 0);
+      return;
+    }
+    bool binary = !g_no_binary && (accept.find(DIRENT_BINARY_TYPE)!=std::string::npos);
+    if(!binary && (accept.find("text/json")==std::string::npos)) {
+      header(c, 403, "Forbidden", extra, 0);
+      return;
+    }
+    extra += binary? "Content-Type: " DIRENT_BINARY_TYPE "\r\n": "Content-Type: text/json\r\n";
+    if(head) {
+      // the listing is not built for HEAD.
+      header(c, 200, "OK", extra, ~0ULL);
+      return;
+    }
+    std::string dir = (path=="/")? path: path + "/";
+    std::string body = binary? node.listing_binary(dir): node.listing(dir);
+    __sync_fetch_and_add(&g_listings, 1);
+    header(c, 200, "OK", extra, body.length());
+    c->head += body;
+    return;
+  }
+
+  // regular file.
+  uint64_t size = node.size();
+  extra += "Content-Type: application/octet-stream\r\n";
+  extra += "ETag: " + node.etag() + "\r\n";
+  extra += "Last-Modified: " + rfc1123(node.mtime()) + "\r\n";
+  if(!g_no_range) extra += "Accept-Ranges: bytes\r\n";
+  uint64_t first = 0, last = size - 1;
+  bool partial = false;
+  if(!head && !g_no_range && (strncmp(range.c_str(), "bytes=", 6)==0) && (range.find(',')==std::string::npos)) {
+    const char* p = range.c_str() + 6;
+    char* q;
+    if(*p=='-') {
+      uint64_t n = strtoull(p+1, NULL, 10);
+      first = (n<size)? size - n: 0;
+    } else {
+      first = strtoull(p, &q, 10);
+      if((*q=='-') && (*(q+1)!='\0')) last = strtoull(q+1, NULL, 10);
+    }
+    if(last>=size) last = size - 1;
+    if((first>=size) || (first>last)) {
+      char t[64];
+      snprintf(t, sizeof(t), "Content-Range: bytes */%"FINT64"u\r\n", size);
+      header(c, 416, "Range Not Satisfiable", extra + t, 0);
+      return;
+    }
+    partial = true;
+    __sync_fetch_and_add(&g_ranges, 1);
+  }
+  if(partial) {
+    char t[128];
+    snprintf(t, sizeof(t), "Content-Range: bytes %"FINT64"u-%"FINT64"u/%"FINT64"u\r\n", first, last, size);
+    header(c, 206, "Partial Content", extra + t, last - first + 1);
+  } else {
+    header(c, 200, "OK", extra, size);
+    first = 0;
+    last = size - 1;
+  }
+  if(!head && (size>0)) {
+    c->body_seed = node.seed();
+    c->body_pos = first;
+    c->body_end = last + 1;
+  }
+}
+
+
+// 'length' of ~0 omits Content-Length.
+void Server::header(Connection* c, int status, const char* reason, const std::string& extra, uint64_t length)
+{
+  char t[128];
+  snprintf(t, sizeof(t), "HTTP/1.1 %d %s\r\nServer: origin_server\r\n", status, reason);
+  c->head = t;
+  c->head += extra;
+  if(length!=~0ULL) {
+    snprintf(t, sizeof(t), "Content-Length: %"FINT64"u\r\n", length);
+    c->head += t;
+  }
+  if(!c->keep_alive) c->head += "Connection: close\r\n";
+  c->head += "\r\n";
+  c->head_sent = 0;
+  __sync_fetch_and_add(&g_status[status/100], 1);
+}
+
+
+void Server::schedule(Connection* c, uint64_t at)
+{
+  if(c->wake>0) m_timers.erase(std::make_pair(c->wake, c->fd));
+  c->wake = at;
+  m_timers.insert(std::make_pair(at, c->fd));
+}
+
+
+void Server::watch(Connection* c, uint32_t events)
+{
+  struct epoll_event ev;
+  ev.events = events;
+  ev.data.fd = c->fd;
+  epoll_ctl(m_epoll, EPOLL_CTL_MOD, c->fd, &ev);
+}
+
+
+void Server::close(Connection* c)
+{
+  if(c->wake>0) m_timers.erase(std::make_pair(c->wake, c->fd));
+  epoll_ctl(m_epoll, EPOLL_CTL_DEL, c->fd, NULL);
+  ::close(c->fd);
+  m_conns.erase(c->fd);
+  delete c;
+}
+
+
+static void* server_main(void* ctx)
+{
+  ((Server*)ctx)->run();
+  return NULL;
+}
+
+
+static void on_signal(int)
+{
+  g_stop = true;
+}
+
+
+int main(int argc, char* argv[])
+{
+  for(int ai=1; ai<argc; ai++) {
+    if(strncmp(argv[ai], "--port=", 7)==0) g_port = atoi(argv[ai]+7);
+    else if(strncmp(argv[ai], "--threads=", 10)==0) g_threads = atoi(argv[ai]+10);
+    else if(strncmp(argv[ai], "--fanout=", 9)==0) g_fanout = strtoull(argv[ai]+9, NULL, 10);
+    else if(strncmp(argv[ai], "--depth=", 8)==0) g_depth = strtoull(argv[ai]+8, NULL, 10);
+    else if(strncmp(argv[ai], "--files=", 8)==0) g_files = strtoull(argv[ai]+8, NULL, 10);
+    else if(strncmp(argv[ai], "--size=", 7)==0) g_size = strtoull(argv[ai]+7, NULL, 10);
+    else if(strcmp(argv[ai], "--fixed_size")==0) g_fixed_size = true;
+    else if(strncmp(argv[ai], "--rtt_ms=", 9)==0) g_rtt_ns = strtoull(argv[ai]+9, NULL, 10) * 1000000ULL;
+    else if(strncmp(argv[ai], "--bandwidth=", 12)==0) g_bandwidth = strtoull(argv[ai]+12, NULL, 10);
+    else if(strncmp(argv[ai], "--error_rate=", 13)==0) g_error_rate = atof(argv[ai]+13);
+    else if(strcmp(argv[ai], "--no_range")==0) g_no_range = true;
+    else if(strcmp(argv[ai], "--no_binary")==0) g_no_binary = true;
+    else if(strncmp(argv[ai], "--etag_churn=", 13)==0) g_etag_churn = strtoull(argv[ai]+13, NULL, 10);
+    else {
+      fprintf(stderr, "usage: %s [--port=8124] [--threads=N] [--fanout=N] [--depth=N] [--files=N] [--size=BYTES]\n"
+                      "        [--fixed_size] [--rtt_ms=N] [--bandwidth=BYTES] [--error_rate=R] [--no_range] [--etag_churn=SEC]\n"
+                      "        [--no_binary]\n", argv[0]);
+      return 1;
+    }
+  }
+  if(g_threads<1) g_threads = 1;
+  g_started = time(NULL);
+  signal(SIGPIPE, SIG_IGN);
+  signal(SIGINT, on_signal);
+  signal(SIGTERM, on_signal);
+
+  std::vector<Server> servers(g_threads);
+  for(int ai=0; ai<g_threads; ai++) {
+    if(!servers[ai].init(ai+1)) return 1;
+  }
+
+  uint64_t dirs = 1, level = 1;
+  for(uint64_t ai=0; ai<g_depth; ai++) dirs += (level *= g_fanout);
+  fprintf(stderr, "origin_server: port=%d threads=%d dirs=%"FINT64"u files=%"FINT64"u\n",
+          g_port, g_threads, dirs, dirs*g_files);
+
+  std::vector<pthread_t> threads(g_threads);
+  for(int ai=0; ai<g_threads; ai++) pthread_create(&threads[ai], NULL, server_main, &servers[ai]);
+  for(int ai=0; ai<g_threads; ai++) pthread_join(threads[ai], NULL);
+
+  fprintf(stderr, "origin_server: requests=%"FINT64"u listings=%"FINT64"u ranges=%"FINT64"u errors=%"FINT64"u bytes=%"FINT64"u\n",
+          g_requests, g_listings, g_ranges, g_errors, g_bytes);
+  return 0;
+}
+
+// vim: sw=2 sts=2 ts=4 expandtab :
@@ -0,0 +1,159 @@
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "mtrace.hxx"
+#include "../readdir.h"
+#include "../latency.h"
+#include "../int64format.h"
+
+
+static Log glog("readdir_test", LOG_LOCAL7, Log::NOTE);
+
+
+// HTTP server of one directory of 'entries' files, a connection per request.
+class ListingServer
+{
+public:
+  ListingServer(size_t entries) {
+    m_body = "{";
+    char t[256];
+    for(size_t ai=0; ai<entries; ai++) {
+      snprintf(t, sizeof(t), "%s\"f%"FSIZET"u\":{\"mode\":\"-rw-r--r--\",\"size\":%"FSIZET"u,\"mtime\":\"2016-01-01T00:00:00Z\"}",
+               (ai==0)? "": ",", ai, ai);
+      m_body += t;
+    }
+    m_body += "}";
+
+    m_sock = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(m_sock, (struct sockaddr*)&sa, sizeof(sa));
+    socklen_t len = sizeof(sa);
+    getsockname(m_sock, (struct sockaddr*)&sa, &len);
+    listen(m_sock, 16);
+    snprintf(t, sizeof(t), "/127.0.0.1:%d/dir", ntohs(sa.sin_port));
+    m_path = t;
+    pthread_create(&m_thread, NULL, serve, this);
+  };
+  ~ListingServer() {
+    shutdown(m_sock, SHUT_RDWR);
+    close(m_sock);
+    pthread_join(m_thread, NULL);
+  };
+  inline const char* path() const { return m_path.c_str(); };
+
+private:
+  int m_sock;
+  pthread_t m_thread;
+  std::string m_path;
+  std::string m_body;
+
+  static void* serve(void* ctx) {
+    ListingServer* self = (ListingServer*)ctx;
+    int c;
+    while((c = accept(self->m_sock, NULL, NULL))>=0) {
+      std::string req;
+      char buf[4096];
+      ssize_t n;
+      while((req.find("\r\n\r\n")==std::string::npos) && ((n = read(c, buf, sizeof(buf)))>0)) req.append(buf, n);
+      snprintf(buf, sizeof(buf), "HTTP/1.1 200 OK\r\nContent-Type: text/json\r\nContent-Length: %"FSIZET"u\r\n"
+               "Connection: close\r\n\r\n", self->m_body.size());
+      std::string res = buf + self->m_body;
+      for(size_t off=0; off<res.size(); off+=n) {
+        n = write(c, res.data() + off, res.size() - off);
+        if(n<=0) break;
+      }
+      close(c);
+    }
+    return NULL;
+  };
+};
+
+
+class StatJob: public WorkerJob
+{
+public:
+  inline StatJob(uint64_t* c): counter(c) {};
+  inline virtual void run() { __sync_fetch_and_add(counter, 1); };
+  uint64_t* counter;
+};
+
+
+// a reader which stats every entry while it reads, as 'ls -l' or find.
+static uint64_t walk(WorkerPool& pool, const char* path, uint64_t* stats)
+{
+  ReadDir rd;
+  uint64_t index = 0;
+  for(;;) {
+    DirentList::Entry entry;
+    const char* name;
+    int r;
+    {
+      LatencyTimer t(Latency::READDIR);
+      r = rd.get(glog, pool, path, index, true, entry, name);
+      // the call which starts the transfer is a miss.
+      if(index==0) EXPECT_TRUE(Latency::remoted());
+    }
+    if(r<=0) break;
+    StatJob job(stats);
+    pool.execute(&job, WorkerPool::META);
+    index++;
+  }
+  rd.cancel(pool);
+  return index;
+}
+
+
+TEST(ReadDir, one_worker)
+{
+  MTrace mt("ReadDir_one_worker.mlog");
+  alarm(60);
+
+  // more entries than READDIR_QUEUE_MAX: the only worker must not wait for the reader.
+  ListingServer server(READDIR_QUEUE_MAX * 3);
+  WorkerPool pool;
+  pool.start(1, 16, 0);
+  uint64_t stats = 0;
+  EXPECT_EQ((uint64_t)READDIR_QUEUE_MAX * 3, walk(pool, server.path(), &stats));
+  EXPECT_EQ((uint64_t)READDIR_QUEUE_MAX * 3, stats);
+  EXPECT_EQ(0U, ReadDirJob::streams());
+  pool.stop();
+  alarm(0);
+}
+
+
+TEST(ReadDir, streams)
+{
+  MTrace mt("ReadDir_streams.mlog");
+  alarm(60);
+
+  ListingServer server(READDIR_QUEUE_MAX * 3);
+  WorkerPool pool;
+  pool.start(4, 16, 2);
+
+  // bounded transfers are limited to a half of the reserved workers.
+  EXPECT_TRUE(ReadDirJob::reserve(1));
+  EXPECT_FALSE(ReadDirJob::reserve(1));
+  ReadDirJob held(glog, server.path(), 0, true);
+  pool.execute(&held, WorkerPool::META);
+  EXPECT_EQ(0U, ReadDirJob::streams());
+
+  uint64_t stats = 0;
+  EXPECT_EQ((uint64_t)READDIR_QUEUE_MAX * 3, walk(pool, server.path(), &stats));
+  EXPECT_EQ((uint64_t)READDIR_QUEUE_MAX * 3, stats);
+  EXPECT_EQ(0U, ReadDirJob::streams());
+  pool.stop();
+  alarm(0);
+}
+
+
+int main(int argc, char* argv[])
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
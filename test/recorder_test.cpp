@@ -0,0 +1,105 @@
+#include <gtest/gtest.h>
+#include <pthread.h>
+#include "mtrace.hxx"
+#include "../recorder.h"
+#include "../int64format.h"
+
+
+TEST(RecorderRing, Wrap)
+{
+  RecorderRing ring(4);
+  std::vector<RecorderEntry> entries;
+  ring.snapshot(entries);
+  EXPECT_EQ(0U, entries.size());
+
+  const char* paths[] = { "/a", "/b", "/c", "/d", "/e", "/f" };
+  for(int ai=0; ai<6; ai++) {
+    ring.push(RecorderEntry::FUSE, "read", paths[ai], ai*1000, ai, ai*10, false);
+  }
+  EXPECT_EQ(6U, ring.pushed());
+  ring.snapshot(entries);
+  ASSERT_EQ(4U, entries.size());
+  for(int ai=0; ai<4; ai++) {
+    EXPECT_STREQ(paths[ai+2], entries[ai].path);
+    EXPECT_EQ((uint64_t)ai+3, entries[ai].seq);
+    EXPECT_EQ(ai+2, entries[ai].status);
+    EXPECT_EQ((uint64_t)(ai+2)*10, entries[ai].bytes);
+  }
+}
+
+
+TEST(RecorderRing, Truncate)
+{
+  RecorderRing ring(2);
+  std::string path(RECORDER_PATH*2, 'x');
+  ring.push(RecorderEntry::HTTP, "GET", path.c_str(), 0, 200, 0, true);
+  ring.push(RecorderEntry::HTTP, "GET", NULL, 0, 200, 0, true);
+  std::vector<RecorderEntry> entries;
+  ring.snapshot(entries);
+  ASSERT_EQ(2U, entries.size());
+  EXPECT_EQ((size_t)RECORDER_PATH-1, strlen(entries[0].path));
+  EXPECT_STREQ("", entries[1].path);
+}
+
+
+TEST(Recorder, Slow)
+{
+  MTrace mt("Recorder_Slow.mlog");
+
+  uint64_t recent = Recorder::recent().pushed();
+  uint64_t slow = Recorder::slow().pushed();
+  Recorder::slow_msec(10);
+  Recorder::record(RecorderEntry::FUSE, "getattr", "/fast", 9999999, 0, 0, false);
+  Recorder::record(RecorderEntry::HTTP, "HEAD", "http://host/slow", 10000000, 404, 0, true);
+  EXPECT_EQ(recent + 2, Recorder::recent().pushed());
+  EXPECT_EQ(slow + 1, Recorder::slow().pushed());
+
+  std::string s = Recorder::dump(Recorder::slow());
+  EXPECT_NE(std::string::npos, s.find("slow_msec=10\n"));
+  EXPECT_NE(std::string::npos, s.find(" http HEAD "));
+  EXPECT_NE(std::string::npos, s.find("10.000ms status=404 bytes=0 http://host/slow\n"));
+  EXPECT_EQ(std::string::npos, s.find("/fast"));
+
+  Recorder::slow_msec(0);
+  Recorder::record(RecorderEntry::HTTP, "GET", "http://host/slower", 100000000, 200, 0, true);
+  EXPECT_EQ(slow + 1, Recorder::slow().pushed());
+}
+
+
+static void* push_main(void* ctx)
+{
+  RecorderRing* ring = (RecorderRing*)ctx;
+  for(int ai=0; ai<10000; ai++) {
+    ring->push(RecorderEntry::FUSE, "read", "/threads", ai, ai, ai, false);
+  }
+  return NULL;
+}
+
+
+TEST(RecorderRing, Threads)
+{
+  RecorderRing ring(64);
+  pthread_t th[4];
+  for(int ai=0; ai<4; ai++) pthread_create(&th[ai], NULL, push_main, &ring);
+
+  // readers never see torn entries.
+  std::vector<RecorderEntry> entries;
+  for(int ai=0; ai<100; ai++) {
+    ring.snapshot(entries);
+    for(size_t bi=0; bi<entries.size(); bi++) {
+      ASSERT_STREQ("/threads", entries[bi].path);
+      ASSERT_EQ((uint64_t)entries[bi].status, entries[bi].bytes);
+    }
+  }
+  for(int ai=0; ai<4; ai++) pthread_join(th[ai], NULL);
+  EXPECT_EQ(40000U, ring.pushed());
+  ring.snapshot(entries);
+  EXPECT_EQ(64U, entries.size());
+}
+
+
+int main(int argc, char* argv[])
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
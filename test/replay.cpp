@@ -0,0 +1,323 @@
+// Replays a capture of fuse operations (.proc/debug/capture) against a mount.
+//   $ make replay && ./replay --mount=DIR [--speed=X] [--threads=N] [--keep_paths]
+//        [--host=127.0.0.1:8124] [--fanout=N] [--depth=N] [--files=N] CAPTURE_FILE
+//
+// Operations are issued at their captured times divided by 'speed' (1: original,
+// 10: ten times faster, 0: as fast as possible). Operations on the same path go
+// to the same thread, in order.
+//
+// Paths are mapped onto the tree of origin_server at 'host' with the same
+// --fanout/--depth/--files, by their hashes: a directory to a directory, a file
+// to a file. With --keep_paths, the captured paths are used as they are (not for
+// hashed captures).
+//
+//   getattr => lstat, readdir of offset 0 => opendir/readdir/closedir,
+//   open => open(O_RDONLY), read => pread, release => close.
+//   Other operations are counted as skipped.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include "../capture.h"
+#include "../latency.h"
+#include "../int64format.h"
+
+
+class Op
+{
+public:
+  uint64_t  at;       // usec from the start of the capture.
+  uint8_t   op;
+  uint32_t  path;
+  int32_t   result;
+  uint64_t  offset;
+  uint32_t  size;
+  uint32_t  duration;
+};
+
+
+class Worker
+{
+public:
+  std::vector<const Op*> ops;
+  Histogram hist[Latency::OPS];
+  Histogram captured[Latency::OPS];
+  uint64_t  errors[Latency::OPS];
+  uint64_t  skipped;
+  uint64_t  max_lag;  // usec.
+  pthread_t thread;
+};
+
+
+static std::string g_mount;
+static std::string g_host = "127.0.0.1:8124";
+static double   g_speed = 1.0;
+static int      g_threads = 8;
+static bool     g_keep_paths = false;
+static uint64_t g_fanout = 10;
+static uint64_t g_depth = 3;
+static uint64_t g_files = 1000;
+static bool     g_hashed = false;
+static std::vector<Op> g_ops;
+static std::map<uint32_t, std::string> g_paths;   // id => mapped path.
+static uint64_t g_start;
+
+
+static bool load(const char* file, std::map<uint32_t, std::string>& names, std::map<uint32_t, uint64_t>& hashes)
+{
+  FILE* fp = fopen(file, "rb");
+  if(fp==NULL) {
+    fprintf(stderr, "%s: %s\n", file, strerror(errno));
+    return false;
+  }
+  CaptureHeader h;
+  if((fread(&h, sizeof(h), 1, fp)!=1) || (memcmp(h.magic, CAPTURE_MAGIC, sizeof(h.magic))!=0) ||
+     (h.version!=CAPTURE_VERSION)) {
+    fprintf(stderr, "%s: not a capture file.\n", file);
+    fclose(fp);
+    return false;
+  }
+  g_hashed = (h.flags & CAPTURE_HASHED);
+
+  CaptureRecord r;
+  uint64_t at = 0;
+  while(fread(&r, sizeof(r), 1, fp)==1) {
+    if(r.op==CAPTURE_PATH) {
+      std::string p(r.size, '\0');
+      if((r.size>0) && (fread(&p[0], r.size, 1, fp)!=1)) break;
+      if(g_hashed) {
+        uint64_t v = 0;
+        memcpy(&v, p.data(), (p.size()<sizeof(v))? p.size(): sizeof(v));
+        hashes[r.path] = v;
+      } else {
+        names[r.path] = p;
+        hashes[r.path] = Capture::hash(p.c_str());
+      }
+      continue;
+    }
+    at += r.usec;
+    Op op;
+    op.at = at;
+    op.op = r.op;
+    op.path = r.path;
+    op.result = r.result;
+    op.offset = r.offset;
+    op.size = r.size;
+    op.duration = r.duration;
+    g_ops.push_back(op);
+  }
+  fclose(fp);
+  return true;
+}
+
+
+// a directory or a file of the origin_server tree for a hash.
+static std::string synthetic(uint64_t h, bool dir)
+{
+  std::string r = "/" + g_host;
+  uint64_t level = (g_fanout>0)? h % (g_depth+1): 0;
+  char t[32];
+  for(uint64_t ai=0; ai<level; ai++) {
+    h = h * 0x9e3779b97f4a7c15ULL + 1;
+    snprintf(t, sizeof(t), "/d%"FINT64"u", (h>>33) % g_fanout);
+    r += t;
+  }
+  if(!dir && (g_files>0)) {
+    snprintf(t, sizeof(t), "/f%"FINT64"u", (h>>17) % g_files);
+    r += t;
+  }
+  return r;
+}
+
+
+static void map_paths(const std::map<uint32_t, std::string>& names, const std::map<uint32_t, uint64_t>& hashes)
+{
+  std::set<uint32_t> dirs;
+  for(size_t ai=0; ai<g_ops.size(); ai++) {
+    if((g_ops[ai].op==Latency::OPENDIR) || (g_ops[ai].op==Latency::READDIR)) dirs.insert(g_ops[ai].path);
+  }
+  std::map<uint32_t, uint64_t>::const_iterator it;
+  for(it=hashes.begin(); it!=hashes.end(); it++) {
+    std::map<uint32_t, std::string>::const_iterator n = names.find((*it).first);
+    std::string name = (n!=names.end())? (*n).second: "";
+    if(!name.empty() && ((name=="/") || (name.compare(0, 2, "/.")==0))) {
+      g_paths[(*it).first] = "";   // the root and .proc are not replayed.
+    } else if(g_keep_paths && !g_hashed) {
+      g_paths[(*it).first] = g_mount + name;
+    } else if(!name.empty() && (name.find('/', 1)==std::string::npos)) {
+      g_paths[(*it).first] = g_mount + "/" + g_host;   // a host.
+    } else {
+      g_paths[(*it).first] = g_mount + synthetic((*it).second, dirs.count((*it).first)>0);
+    }
+  }
+}
+
+
+static void* worker_main(void* ctx)
+{
+  Worker* w = (Worker*)ctx;
+  std::map<uint32_t, int> fds;
+  std::vector<char> buf;
+
+  for(size_t ai=0; ai<w->ops.size(); ai++) {
+    const Op& op = *w->ops[ai];
+    std::map<uint32_t, std::string>::const_iterator found = g_paths.find(op.path);
+    if((op.op>=Latency::OPS) || (found==g_paths.end()) || (*found).second.empty()) {
+      w->skipped++;
+      continue;
+    }
+    const std::string& path = (*found).second;
+    if(g_speed>0) {
+      uint64_t at = g_start + (uint64_t)(op.at * 1000 / g_speed), now = Latency::now();
+      if(at>now) {
+        struct timespec ts = { (time_t)((at-now)/1000000000ULL), (long)((at-now)%1000000000ULL) };
+        nanosleep(&ts, NULL);
+      } else if((now-at)/1000>w->max_lag) {
+        w->max_lag = (now-at)/1000;
+      }
+    }
+
+    uint64_t s = Latency::now();
+    int r = 0;
+    switch(op.op) {
+    case Latency::GETATTR: {
+      struct stat st;
+      r = lstat(path.c_str(), &st);
+      break;
+    }
+    case Latency::READDIR: {
+      if(op.offset!=0) {
+        w->skipped++;
+        continue;
+      }
+      DIR* d = opendir(path.c_str());
+      if(d==NULL) {
+        r = -1;
+        break;
+      }
+      while(readdir(d)!=NULL) ;
+      closedir(d);
+      break;
+    }
+    case Latency::OPEN: {
+      int fd = open(path.c_str(), O_RDONLY);
+      if(fd<0) {
+        r = -1;
+        break;
+      }
+      if(fds.count(op.path)>0) close(fds[op.path]);
+      fds[op.path] = fd;
+      break;
+    }
+    case Latency::READ: {
+      std::map<uint32_t, int>::iterator it = fds.find(op.path);
+      int fd = (it!=fds.end())? (*it).second: open(path.c_str(), O_RDONLY);
+      if(fd<0) {
+        r = -1;
+        break;
+      }
+      if(buf.size()<op.size) buf.resize(op.size);
+      r = (pread(fd, &buf[0], op.size, op.offset)<0)? -1: 0;
+      if(it==fds.end()) close(fd);
+      break;
+    }
+    case Latency::RELEASE: {
+      std::map<uint32_t, int>::iterator it = fds.find(op.path);
+      if(it!=fds.end()) {
+        close((*it).second);
+        fds.erase(it);
+      }
+      break;
+    }
+    default:
+      w->skipped++;
+      continue;
+    }
+    w->hist[op.op].record(Latency::now() - s);
+    w->captured[op.op].record(op.duration * 1000ULL);
+    if(r<0) w->errors[op.op]++;
+  }
+
+  for(std::map<uint32_t, int>::iterator it=fds.begin(); it!=fds.end(); it++) close((*it).second);
+  return NULL;
+}
+
+
+int main(int argc, char* argv[])
+{
+  const char* file = NULL;
+  for(int ai=1; ai<argc; ai++) {
+    if(strncmp(argv[ai], "--mount=", 8)==0) g_mount = argv[ai]+8;
+    else if(strncmp(argv[ai], "--host=", 7)==0) g_host = argv[ai]+7;
+    else if(strncmp(argv[ai], "--speed=", 8)==0) g_speed = atof(argv[ai]+8);
+    else if(strncmp(argv[ai], "--threads=", 10)==0) g_threads = atoi(argv[ai]+10);
+    else if(strcmp(argv[ai], "--keep_paths")==0) g_keep_paths = true;
+    else if(strncmp(argv[ai], "--fanout=", 9)==0) g_fanout = strtoull(argv[ai]+9, NULL, 10);
+    else if(strncmp(argv[ai], "--depth=", 8)==0) g_depth = strtoull(argv[ai]+8, NULL, 10);
+    else if(strncmp(argv[ai], "--files=", 8)==0) g_files = strtoull(argv[ai]+8, NULL, 10);
+    else if((argv[ai][0]!='-') && (file==NULL)) file = argv[ai];
+    else file = NULL, ai = argc;
+  }
+  if((file==NULL) || g_mount.empty()) {
+    fprintf(stderr, "usage: %s --mount=DIR [--speed=X] [--threads=N] [--keep_paths]\n"
+                    "        [--host=127.0.0.1:8124] [--fanout=N] [--depth=N] [--files=N] CAPTURE_FILE\n", argv[0]);
+    return 1;
+  }
+  if(g_threads<1) g_threads = 1;
+  if(!g_mount.empty() && (g_mount[g_mount.length()-1]=='/')) g_mount.erase(g_mount.length()-1);
+
+  std::map<uint32_t, std::string> names;
+  std::map<uint32_t, uint64_t> hashes;
+  if(!load(file, names, hashes)) return 1;
+  map_paths(names, hashes);
+
+  std::vector<Worker> workers(g_threads);
+  for(size_t ai=0; ai<g_ops.size(); ai++) workers[g_ops[ai].path % g_threads].ops.push_back(&g_ops[ai]);
+  g_start = Latency::now();
+  for(int ai=0; ai<g_threads; ai++) {
+    memset(workers[ai].errors, 0, sizeof(workers[ai].errors));
+    workers[ai].skipped = workers[ai].max_lag = 0;
+    pthread_create(&workers[ai].thread, NULL, worker_main, &workers[ai]);
+  }
+  for(int ai=0; ai<g_threads; ai++) pthread_join(workers[ai].thread, NULL);
+  double sec = (Latency::now() - g_start) / 1e9;
+
+  Histogram hist[Latency::OPS], captured[Latency::OPS];
+  uint64_t errors[Latency::OPS], skipped = 0, lag = 0;
+  memset(errors, 0, sizeof(errors));
+  for(int ai=0; ai<g_threads; ai++) {
+    for(int o=0; o<Latency::OPS; o++) {
+      hist[o].merge(workers[ai].hist[o]);
+      captured[o].merge(workers[ai].captured[o]);
+      errors[o] += workers[ai].errors[o];
+    }
+    skipped += workers[ai].skipped;
+    if(workers[ai].max_lag>lag) lag = workers[ai].max_lag;
+  }
+
+  printf("{\"replay\":\"%s\",\"records\":%"FSIZET"u,\"paths\":%"FSIZET"u,\"hashed\":%s,\"speed\":%g,\"threads\":%d,"
+         "\"captured_seconds\":%.3f,\"seconds\":%.3f,\"max_lag_ms\":%.3f,\"skipped\":%"FINT64"u,\"ops\":{",
+         file, g_ops.size(), hashes.size(), g_hashed? "true": "false", g_speed, g_threads,
+         g_ops.empty()? 0.0: g_ops.back().at / 1e6, sec, lag / 1000.0, skipped);
+  bool first = true;
+  for(int o=0; o<Latency::OPS; o++) {
+    if(hist[o].count()==0) continue;
+    printf("%s\n  \"%s\":{\"count\":%"FINT64"u,\"errors\":%"FINT64"u,\"mean_us\":%.1f,\"p50_us\":%.1f,"
+           "\"p99_us\":%.1f,\"max_us\":%.1f,\"captured_mean_us\":%.1f,\"captured_p99_us\":%.1f}",
+           first? "": ",", Latency::op_name((Latency::OP)o), hist[o].count(), errors[o],
+           hist[o].mean()/1000.0, hist[o].percentile(0.5)/1000.0, hist[o].percentile(0.99)/1000.0,
+           hist[o].max()/1000.0, captured[o].mean()/1000.0, captured[o].percentile(0.99)/1000.0);
+    first = false;
+  }
+  printf("\n}}\n");
+  return 0;
+}
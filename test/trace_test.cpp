@@ -0,0 +1,112 @@
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <pthread.h>
+#include "mtrace.hxx"
+#include "../trace.h"
+#include "../int64format.h"
+
+
+static std::string fmt(const char* f, uint64_t v)
+{
+  char t[64];
+  snprintf(t, sizeof(t), f, v);
+  return t;
+}
+
+
+TEST(Trace, Disabled)
+{
+  Trace::stop();
+  uint64_t n = Trace::spans();
+  {
+    TraceSpan span("fuse", "getattr", "/a");
+    EXPECT_EQ(0U, Trace::current());
+  }
+  EXPECT_EQ(n, Trace::spans());
+}
+
+
+TEST(Trace, Nested)
+{
+  Trace::start();
+  uint64_t outer, inner;
+  {
+    TraceSpan a("fuse", "read", "/dir/\"quoted\"");
+    outer = Trace::current();
+    {
+      TraceSpan b("http", "GET", "http://host/dir/file");
+      inner = Trace::current();
+      b.status(206);
+      b.bytes(4096);
+    }
+    EXPECT_EQ(outer, Trace::current());
+  }
+  Trace::stop();
+  EXPECT_EQ(0U, Trace::current());
+  EXPECT_EQ(2U, Trace::spans());
+
+  std::string json = Trace::json();
+  EXPECT_EQ(0U, json.find("{\"displayTimeUnit\":\"ms\",\"traceEvents\":["));
+  EXPECT_NE(std::string::npos, json.find("\"name\":\"GET\",\"cat\":\"http\",\"ph\":\"X\""));
+  EXPECT_NE(std::string::npos, json.find(fmt("\"id\":%"FINT64"u,", inner) + fmt("\"parent\":%"FINT64"u,", outer)
+                                         + "\"status\":206,\"bytes\":4096,\"detail\":\"http://host/dir/file\""));
+  EXPECT_NE(std::string::npos, json.find(fmt("\"id\":%"FINT64"u,\"parent\":0,", outer)));
+  EXPECT_NE(std::string::npos, json.find("\"detail\":\"/dir/\\\"quoted\\\"\""));
+  // same thread: no flow events.
+  EXPECT_EQ(std::string::npos, json.find("\"ph\":\"s\""));
+
+  // a new session discards the previous spans.
+  Trace::start();
+  EXPECT_EQ(0U, Trace::spans());
+  Trace::stop();
+}
+
+
+static void* child_main(void* ctx)
+{
+  Trace::thread_name("child");
+  TraceSpan span("pool", "data", "wait_usec=0", *(uint64_t*)ctx);
+  return NULL;
+}
+
+
+TEST(Trace, Threads)
+{
+  Trace::start();
+  uint64_t parent;
+  {
+    TraceSpan span("http", "GET", "http://host/file");
+    parent = Trace::current();
+    pthread_t th;
+    pthread_create(&th, NULL, child_main, &parent);
+    pthread_join(th, NULL);
+  }
+  Trace::stop();
+  EXPECT_EQ(2U, Trace::spans());
+
+  std::string json = Trace::json();
+  EXPECT_NE(std::string::npos, json.find(fmt("\"parent\":%"FINT64"u,", parent)));
+  EXPECT_NE(std::string::npos, json.find("\"ph\":\"M\""));
+  EXPECT_NE(std::string::npos, json.find("\"args\":{\"name\":\"child\"}"));
+  EXPECT_NE(std::string::npos, json.find("\"cat\":\"flow\",\"ph\":\"s\""));
+  EXPECT_NE(std::string::npos, json.find("\"cat\":\"flow\",\"ph\":\"f\",\"bp\":\"e\""));
+}
+
+
+TEST(Trace, Overflow)
+{
+  Trace::start();
+  for(int ai=0; ai<TRACE_SPANS+10; ai++) {
+    TraceSpan span("fuse", "getattr");
+  }
+  Trace::stop();
+  EXPECT_EQ((uint64_t)TRACE_SPANS, Trace::spans());
+  EXPECT_EQ(10U, Trace::dropped());
+}
+
+
+int main(int argc, char* argv[])
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,291 @@
+#include <gtest/gtest.h>
+#include "mtrace.hxx"
+#include "../workerpool.h"
+#include "../latency.h"
+#include "../int64format.h"
+
+
+class CountJob: public WorkerJob
+{
+public:
+  inline CountJob(uint64_t* c): counter(c) {};
+  inline virtual void run() { __sync_fetch_and_add(counter, 1); usleep(100); };
+  uint64_t* counter;
+};
+
+
+TEST(WorkerPool, Inline)
+{
+  MTrace mt("WorkerPool_Inline.mlog");
+
+  uint64_t n = 0;
+  WorkerPool pool;
+  CountJob job(&n);
+  pool.execute(&job);
+  EXPECT_TRUE(job.done());
+  EXPECT_EQ(1U, n);
+  EXPECT_EQ(0U, pool.workers());
+}
+
+
+TEST(WorkerPool, Execute)
+{
+  MTrace mt("WorkerPool_Execute.mlog");
+
+  uint64_t n = 0;
+  WorkerPool pool;
+  pool.start(4, 8);
+  EXPECT_EQ(4U, pool.workers());
+  for(int ai=0; ai<100; ai++) {
+    CountJob job(&n);
+    pool.execute(&job);
+    EXPECT_TRUE(job.done());
+  }
+  EXPECT_EQ(100U, n);
+  pool.stop();
+  EXPECT_EQ(0U, pool.workers());
+}
+
+
+TEST(WorkerPool, Backpressure)
+{
+  MTrace mt("WorkerPool_Backpressure.mlog");
+
+  uint64_t n = 0;
+  WorkerPool pool;
+  pool.start(2, 4);
+
+  std::vector<CountJob*> jobs;
+  for(int ai=0; ai<200; ai++) {
+    jobs.push_back(new CountJob(&n));
+    pool.submit(jobs.back());
+    EXPECT_GE(4U, pool.queued());
+  }
+  for(int ai=0; ai<200; ai++) {
+    jobs[ai]->wait();
+    delete jobs[ai];
+  }
+  EXPECT_EQ(200U, n);
+  EXPECT_EQ(200U, pool.submitted());
+  EXPECT_LT(0U, pool.blocked());
+  pool.stop();
+}
+
+
+class GateJob: public WorkerJob
+{
+public:
+  inline GateJob(): open(false) {};
+  inline virtual void run() { while(!open) usleep(100); };
+  volatile bool open;
+};
+
+
+TEST(WorkerPool, TrySubmit)
+{
+  MTrace mt("WorkerPool_TrySubmit.mlog");
+
+  uint64_t n = 0;
+  WorkerPool pool;
+  pool.start(1, 2, 0);
+
+  // the worker is busy, so the lane fills up without waiting.
+  GateJob busy;
+  std::vector<CountJob*> jobs;
+  pool.submit(&busy, WorkerPool::DATA);
+  while(pool.lane_stat(WorkerPool::DATA).queued>0) usleep(100);
+  for(int ai=0; ai<2; ai++) {
+    jobs.push_back(new CountJob(&n));
+    EXPECT_TRUE(pool.try_submit(jobs.back(), WorkerPool::DATA, WorkerPool::READAHEAD));
+  }
+  CountJob extra(&n);
+  EXPECT_FALSE(pool.try_submit(&extra, WorkerPool::DATA, WorkerPool::READAHEAD));
+  EXPECT_TRUE(pool.try_submit(&extra, WorkerPool::META));
+
+  busy.open = true;
+  busy.wait();
+  for(size_t ai=0; ai<jobs.size(); ai++) {
+    jobs[ai]->wait();
+    delete jobs[ai];
+  }
+  extra.wait();
+  EXPECT_EQ(3U, n);
+  EXPECT_EQ(4U, pool.submitted());
+  pool.stop();
+}
+
+
+class SleepJob: public WorkerJob
+{
+public:
+  inline SleepJob(WorkerPool& p, uint64_t* m): pool(p), max_running(m) {};
+  inline virtual void run() {
+    uint64_t r = pool.lane_stat(WorkerPool::DATA).running;
+    if(*max_running<r) *max_running = r;
+    usleep(20000);
+  };
+  WorkerPool& pool;
+  uint64_t* max_running;
+};
+
+
+TEST(WorkerPool, Lanes)
+{
+  MTrace mt("WorkerPool_Lanes.mlog");
+
+  uint64_t n = 0, max_running = 0;
+  WorkerPool pool;
+  pool.start(3, 16, 1);
+  EXPECT_EQ(1U, pool.meta_reserved());
+
+  std::vector<SleepJob*> jobs;
+  for(int ai=0; ai<10; ai++) {
+    jobs.push_back(new SleepJob(pool, &max_running));
+    pool.submit(jobs.back(), WorkerPool::DATA);
+  }
+
+  // META lane is not starved by DATA lane.
+  CountJob meta(&n);
+  pool.submit(&meta, WorkerPool::META);
+  usleep(10000);
+  EXPECT_TRUE(meta.done());
+  EXPECT_FALSE(jobs.back()->done());
+
+  for(int ai=0; ai<10; ai++) {
+    jobs[ai]->wait();
+    delete jobs[ai];
+  }
+  EXPECT_GE(2U, max_running);
+  WorkerPool::LaneStat ls = pool.lane_stat(WorkerPool::DATA);
+  EXPECT_EQ(10U, ls.submitted);
+  EXPECT_EQ(0U, ls.queued);
+  EXPECT_LT(0U, ls.wait_max_usec);
+  pool.stop();
+}
+
+
+class OrderJob: public WorkerJob
+{
+public:
+  inline OrderJob(std::string* l, char n, useconds_t u = 0): log(l), name(n), sleep(u) {};
+  inline virtual void run() { usleep(sleep); log->push_back(name); };
+  std::string* log;
+  char name;
+  useconds_t sleep;
+};
+
+
+TEST(WorkerPool, Priority)
+{
+  MTrace mt("WorkerPool_Priority.mlog");
+
+  std::string log;
+  WorkerPool pool;
+  pool.start(1, 16, 0);
+
+  OrderJob busy(&log, 'X', 20000), bg(&log, 'B'), ra(&log, 'R'), fg(&log, 'F');
+  pool.submit(&busy, WorkerPool::DATA);
+  usleep(5000);
+  pool.submit(&bg, WorkerPool::DATA, WorkerPool::BACKGROUND);
+  pool.submit(&ra, WorkerPool::DATA, WorkerPool::READAHEAD);
+  pool.submit(&fg, WorkerPool::DATA, WorkerPool::FOREGROUND);
+  bg.wait();
+  ra.wait();
+  fg.wait();
+  EXPECT_EQ("XFRB", log);
+  pool.stop();
+}
+
+
+TEST(WorkerPool, Promote)
+{
+  MTrace mt("WorkerPool_Promote.mlog");
+
+  std::string log;
+  WorkerPool pool;
+  pool.start(1, 16, 0);
+
+  OrderJob busy(&log, 'X', 20000), ra1(&log, '1'), ra2(&log, '2');
+  pool.submit(&busy, WorkerPool::DATA);
+  usleep(5000);
+  pool.submit(&ra1, WorkerPool::DATA, WorkerPool::READAHEAD);
+  pool.submit(&ra2, WorkerPool::DATA, WorkerPool::READAHEAD);
+  EXPECT_TRUE(pool.promote(&ra2));
+  EXPECT_FALSE(pool.promote(&ra2));
+  ra1.wait();
+  ra2.wait();
+  EXPECT_EQ("X21", log);
+  EXPECT_FALSE(pool.promote(&ra1));
+  EXPECT_EQ(1U, pool.class_stat(WorkerPool::FOREGROUND).promoted);
+  pool.stop();
+}
+
+
+static int always_interrupted() { return 1; }
+
+TEST(WorkerPool, Cancel)
+{
+  MTrace mt("WorkerPool_Cancel.mlog");
+
+  std::string log;
+  WorkerPool pool;
+  pool.start(1, 16, 0);
+
+  OrderJob busy(&log, 'X', 20000), ra(&log, 'R');
+  pool.submit(&busy, WorkerPool::DATA);
+  usleep(5000);
+  pool.submit(&ra, WorkerPool::DATA, WorkerPool::READAHEAD);
+  EXPECT_TRUE(pool.cancel(&ra));
+  EXPECT_TRUE(ra.done());
+  EXPECT_FALSE(pool.cancel(&busy));
+
+  // interrupted client stops waiting.
+  OrderJob slow(&log, 'S', 50000);
+  pool.submit(&slow, WorkerPool::DATA);
+  WorkerPool::interrupted(always_interrupted);
+  EXPECT_FALSE(pool.wait(&slow));
+  WorkerPool::interrupted(NULL);
+  EXPECT_TRUE(pool.wait(&slow));
+  EXPECT_EQ("XS", log);
+  EXPECT_EQ(1U, pool.cancelled());
+  EXPECT_EQ(0U, pool.queued());
+  pool.stop();
+}
+
+
+TEST(WorkerPool, Remote)
+{
+  MTrace mt("WorkerPool_Remote.mlog");
+
+  std::string log;
+  WorkerPool pool;
+  pool.start(1, 16, 0);
+
+  // a finished job, e.g. a readahead window fetched before the read, is a hit.
+  OrderJob done(&log, 'D');
+  pool.submit(&done, WorkerPool::DATA);
+  done.wait();
+  {
+    LatencyTimer t(Latency::READ);
+    EXPECT_TRUE(pool.wait(&done));
+    EXPECT_FALSE(Latency::remoted());
+  }
+
+  // the op which waits for a job is charged with it.
+  OrderJob slow(&log, 'S', 20000);
+  {
+    LatencyTimer t(Latency::READ);
+    pool.submit(&slow, WorkerPool::DATA);
+    EXPECT_TRUE(pool.wait(&slow));
+    EXPECT_TRUE(Latency::remoted());
+  }
+  EXPECT_EQ("DS", log);
+  pool.stop();
+}
+
+
+int main(int argc, char* argv[])
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
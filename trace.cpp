@@ -0,0 +1,244 @@
+/*
+  Copyright 2010 Toshiyuki Terashita.
+
+  fuse-autohttpfs is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This software is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <map>
+#include "trace.h"
+#include "int64format.h"
+
+
+// append 's' as a JSON string.
+static void json_string(std::string& r, const char* s)
+{
+  r += '"';
+  for(; *s; s++) {
+    unsigned char c = *s;
+    if((c=='"') || (c=='\\')) {
+      r += '\\';
+      r += c;
+    } else if(c<0x20) {
+      char t[8];
+      snprintf(t, sizeof(t), "\\u%04x", c);
+      r += t;
+    } else {
+      r += c;
+    }
+  }
+  r += '"';
+}
+
+
+
+// Trace class implements.
+volatile bool Trace::s_enabled = false;
+volatile uint64_t Trace::s_generation = 0;
+volatile uint64_t Trace::s_next_id = 0;
+pthread_mutex_t Trace::s_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_key_t Trace::s_key;
+std::list<TraceBuffer*> Trace::s_buffers;
+__thread TraceBuffer* Trace::s_buffer = NULL;
+__thread uint64_t Trace::s_current = 0;
+__thread const char* Trace::s_thread_name = NULL;
+
+
+void Trace::start()
+{
+  __sync_add_and_fetch(&s_generation, 1);
+  s_enabled = true;
+}
+
+
+void Trace::stop()
+{
+  s_enabled = false;
+}
+
+
+// buffer of the calling thread, emptied when a new session has started.
+// Buffers of exited threads are kept for json(), and reused from the next session.
+TraceBuffer* Trace::buffer()
+{
+  uint64_t gen = s_generation;
+  TraceBuffer* b = s_buffer;
+  if(b==NULL) {
+    static bool keyed = false;
+    pthread_mutex_lock(&s_lock);
+    {
+      if(!keyed) {
+        pthread_key_create(&s_key, buffer_closed);
+        keyed = true;
+      }
+      std::list<TraceBuffer*>::iterator it;
+      for(it=s_buffers.begin(); it!=s_buffers.end(); it++) {
+        if((*it)->closed && ((*it)->generation!=gen)) break;
+      }
+      if(it==s_buffers.end()) {
+        b = new TraceBuffer();
+        b->generation = gen - 1;
+        s_buffers.push_back(b);
+      } else {
+        b = *it;
+      }
+      b->closed = false;
+      b->tid = syscall(SYS_gettid);
+      b->thread_name = s_thread_name;
+    }
+    pthread_mutex_unlock(&s_lock);
+    pthread_setspecific(s_key, b);
+    s_buffer = b;
+  }
+  if(b->generation!=gen) {
+    // json() reads buffers of the current generation only.
+    b->count = 0;
+    b->dropped = 0;
+    b->thread_name = s_thread_name;
+    __sync_synchronize();
+    b->generation = gen;
+  }
+  return b;
+}
+
+
+void Trace::buffer_closed(void* buffer)
+{
+  pthread_mutex_lock(&s_lock);
+  {
+    ((TraceBuffer*)buffer)->closed = true;
+  }
+  pthread_mutex_unlock(&s_lock);
+}
+
+
+void Trace::push(uint64_t id, uint64_t parent, uint64_t begin, const char* cat, const char* name,
+                 const char* detail, int status, uint64_t bytes)
+{
+  TraceBuffer* b = buffer();
+  size_t n = b->count;
+  if(n>=TRACE_SPANS) {
+    b->dropped++;
+    return;
+  }
+  TraceEvent& e = b->events[n];
+  e.id = id;
+  e.parent = parent;
+  e.begin = begin;
+  e.end = Latency::now();
+  e.bytes = bytes;
+  e.status = status;
+  e.cat = cat;
+  e.name = name;
+  strncpy(e.detail, detail? detail: "", TRACE_DETAIL-1);
+  e.detail[TRACE_DETAIL-1] = '\0';
+  __sync_synchronize();
+  b->count = n + 1;
+}
+
+
+uint64_t Trace::spans()
+{
+  uint64_t n = 0;
+  pthread_mutex_lock(&s_lock);
+  {
+    std::list<TraceBuffer*>::iterator it;
+    for(it=s_buffers.begin(); it!=s_buffers.end(); it++) {
+      if((*it)->generation==s_generation) n += (*it)->count;
+    }
+  }
+  pthread_mutex_unlock(&s_lock);
+  return n;
+}
+
+
+uint64_t Trace::dropped()
+{
+  uint64_t n = 0;
+  pthread_mutex_lock(&s_lock);
+  {
+    std::list<TraceBuffer*>::iterator it;
+    for(it=s_buffers.begin(); it!=s_buffers.end(); it++) {
+      if((*it)->generation==s_generation) n += (*it)->dropped;
+    }
+  }
+  pthread_mutex_unlock(&s_lock);
+  return n;
+}
+
+
+// spans of the current session in Chrome trace-event format.
+// A child running on another thread than its parent is linked by a flow event.
+std::string Trace::json()
+{
+  typedef std::pair<const TraceEvent*, pid_t> Span;
+  std::map<uint64_t, Span> spans;
+  std::string r = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+  char t[512];
+  int pid = getpid();
+  bool first = true;
+
+  pthread_mutex_lock(&s_lock);
+  {
+    uint64_t gen = s_generation;
+    std::list<TraceBuffer*>::iterator it;
+    for(it=s_buffers.begin(); it!=s_buffers.end(); it++) {
+      TraceBuffer* b = *it;
+      if(b->generation!=gen) continue;
+      size_t count = b->count;
+      __sync_synchronize();
+      if(b->thread_name) {
+        snprintf(t, sizeof(t), "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":",
+                 first? "": ",\n", pid, b->tid);
+        r += t;
+        json_string(r, b->thread_name);
+        r += "}}";
+        first = false;
+      }
+      for(size_t i=0; i<count; i++) {
+        const TraceEvent& e = b->events[i];
+        spans[e.id] = Span(&e, b->tid);
+        snprintf(t, sizeof(t), "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d,"
+                 "\"args\":{\"id\":%"FINT64"u,\"parent\":%"FINT64"u,\"status\":%d,\"bytes\":%"FINT64"u,\"detail\":",
+                 first? "": ",\n", e.name, e.cat, e.begin/1000.0, (e.end-e.begin)/1000.0, pid, b->tid,
+                 e.id, e.parent, e.status, e.bytes);
+        r += t;
+        json_string(r, e.detail);
+        r += "}}";
+        first = false;
+      }
+    }
+
+    std::map<uint64_t, Span>::iterator s;
+    for(s=spans.begin(); s!=spans.end(); s++) {
+      const TraceEvent* e = (*s).second.first;
+      std::map<uint64_t, Span>::iterator p = spans.find(e->parent);
+      if((p==spans.end()) || ((*p).second.second==(*s).second.second)) continue;
+      snprintf(t, sizeof(t), ",\n{\"name\":\"%s\",\"cat\":\"flow\",\"ph\":\"s\",\"id\":%"FINT64"u,\"ts\":%.3f,\"pid\":%d,\"tid\":%d}"
+               ",\n{\"name\":\"%s\",\"cat\":\"flow\",\"ph\":\"f\",\"bp\":\"e\",\"id\":%"FINT64"u,\"ts\":%.3f,\"pid\":%d,\"tid\":%d}",
+               e->name, e->id, (*p).second.first->begin/1000.0, pid, (*p).second.second,
+               e->name, e->id, e->begin/1000.0, pid, (*s).second.second);
+      r += t;
+    }
+  }
+  pthread_mutex_unlock(&s_lock);
+
+  r += "\n]}\n";
+  return r;
+}
+
+// vim: sw=2 sts=2 ts=4 expandtab :
@@ -0,0 +1,144 @@
+/*
+  Copyright 2010 Toshiyuki Terashita.
+
+  fuse-autohttpfs is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This software is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __INCLUDE_TRACE_H__
+#define __INCLUDE_TRACE_H__
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <pthread.h>
+#include <string>
+#include <list>
+#include "latency.h"
+
+#ifndef TRACE_SPANS
+# define TRACE_SPANS  (8192)  // per thread, later spans are dropped.
+#endif
+#define TRACE_DETAIL  (96)    // longer details are truncated.
+
+
+// A completed span.
+class TraceEvent
+{
+public:
+  uint64_t  id;
+  uint64_t  parent;   // 0: root.
+  uint64_t  begin;    // nsec, monotonic.
+  uint64_t  end;
+  uint64_t  bytes;
+  int       status;
+  const char* cat;    // static strings.
+  const char* name;
+  char      detail[TRACE_DETAIL];
+};
+
+
+// Spans of a thread. Only its owner writes; 'count' publishes the events.
+class TraceBuffer
+{
+public:
+  pid_t     tid;
+  const char* thread_name;
+  uint64_t  generation;
+  bool      closed;     // the owner has exited.
+  volatile size_t count;
+  uint64_t  dropped;
+  TraceEvent events[TRACE_SPANS];
+};
+
+
+// Timeline of fuse operations, HTTP transfers and pool jobs, exported in
+// Chrome trace-event format. Disabled by default, spans cost a flag check.
+// start() discards spans of the previous session.
+class Trace
+{
+public:
+  static void start();
+  static void stop();
+  inline static bool enabled() { return s_enabled; };
+  inline static uint64_t current() { return s_current; };
+  inline static void thread_name(const char* name) { s_thread_name = name; };
+  static std::string json();
+  static uint64_t spans();
+  static uint64_t dropped();
+
+private:
+  friend class TraceSpan;
+  static volatile bool s_enabled;
+  static volatile uint64_t s_generation;
+  static volatile uint64_t s_next_id;
+  static pthread_mutex_t s_lock;    // guards s_buffers.
+  static pthread_key_t s_key;
+  static std::list<TraceBuffer*> s_buffers;
+  static __thread TraceBuffer* s_buffer;
+  static __thread uint64_t s_current;
+  static __thread const char* s_thread_name;
+  static TraceBuffer* buffer();
+  static void buffer_closed(void* buffer);
+  static void push(uint64_t id, uint64_t parent, uint64_t begin, const char* cat, const char* name,
+                   const char* detail, int status, uint64_t bytes);
+};
+
+
+// Records the scope as a span, a child of the innermost span of the thread
+// or of 'parent' given explicitly (e.g. the submitter of a pool job).
+class TraceSpan
+{
+public:
+  inline TraceSpan(const char* cat, const char* name, const char* detail = NULL) {
+    begin(cat, name, detail, Trace::s_current);
+  };
+  inline TraceSpan(const char* cat, const char* name, const char* detail, uint64_t parent) {
+    begin(cat, name, detail, parent);
+  };
+  inline ~TraceSpan() {
+    if(m_id==0) return;
+    Trace::s_current = m_outer;
+    Trace::push(m_id, m_parent, m_begin, m_cat, m_name, m_detail, m_status, m_bytes);
+  };
+  inline void status(int s) { m_status = s; };
+  inline void bytes(uint64_t b) { m_bytes = b; };
+
+private:
+  uint64_t  m_id;
+  uint64_t  m_parent;
+  uint64_t  m_outer;
+  uint64_t  m_begin;
+  uint64_t  m_bytes;
+  int       m_status;
+  const char* m_cat;
+  const char* m_name;
+  const char* m_detail;
+  inline void begin(const char* cat, const char* name, const char* detail, uint64_t parent) {
+    m_id = 0;
+    if(!Trace::s_enabled) return;
+    m_id = __sync_add_and_fetch(&Trace::s_next_id, 1);
+    m_parent = parent;
+    m_outer = Trace::s_current;
+    Trace::s_current = m_id;
+    m_cat = cat;
+    m_name = name;
+    m_detail = detail;
+    m_status = 0;
+    m_bytes = 0;
+    m_begin = Latency::now();
+  };
+};
+
+
+#endif // __INCLUDE_TRACE_H__
+// vim: sw=2 sts=2 ts=4 expandtab :
@@ -0,0 +1,524 @@
+/*
+  Copyright 2010 Toshiyuki Terashita.
+
+  fuse-autohttpfs is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This software is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <sched.h>
+#include <time.h>
+#include "workerpool.h"
+#include "trace.h"
+#include "latency.h"
+#include "int64format.h"
+
+
+static uint64_t now_usec()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec*1000000 + ts.tv_nsec/1000;
+}
+
+
+
+// WorkerJob class implements.
+WorkerJob::WorkerJob()
+{
+  pthread_mutex_init(&m_lock, NULL);
+  pthread_cond_init(&m_cond, NULL);
+  m_done = false;
+  m_queued = false;
+  m_home = 0;
+  m_lane = WorkerPool::META;
+  m_priority = WorkerPool::FOREGROUND;
+  m_submit_usec = 0;
+  m_trace_parent = 0;
+}
+
+
+WorkerJob::~WorkerJob()
+{
+  pthread_cond_destroy(&m_cond);
+  pthread_mutex_destroy(&m_lock);
+}
+
+
+void WorkerJob::wait()
+{
+  pthread_mutex_lock(&m_lock);
+  {
+    while(!m_done) pthread_cond_wait(&m_cond, &m_lock);
+  }
+  pthread_mutex_unlock(&m_lock);
+}
+
+
+// wait up to 'usec'. Returns true if the job has finished.
+bool WorkerJob::wait(uint64_t usec)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  ts.tv_sec += usec / 1000000;
+  ts.tv_nsec += (usec % 1000000) * 1000;
+  if(ts.tv_nsec>=1000000000) {
+    ts.tv_sec++;
+    ts.tv_nsec -= 1000000000;
+  }
+
+  bool result;
+  pthread_mutex_lock(&m_lock);
+  {
+    while(!m_done) {
+      if(pthread_cond_timedwait(&m_cond, &m_lock, &ts)!=0) break;
+    }
+    result = m_done;
+  }
+  pthread_mutex_unlock(&m_lock);
+  return result;
+}
+
+
+// the worker does not touch the job once this returns true.
+bool WorkerJob::done()
+{
+  bool result;
+  pthread_mutex_lock(&m_lock);
+  {
+    result = m_done;
+  }
+  pthread_mutex_unlock(&m_lock);
+  return result;
+}
+
+
+void WorkerJob::finish()
+{
+  pthread_mutex_lock(&m_lock);
+  {
+    m_done = true;
+    pthread_cond_broadcast(&m_cond);
+  }
+  pthread_mutex_unlock(&m_lock);
+}
+
+
+
+// WorkerPool class implements.
+__thread bool WorkerPool::s_on_worker = false;
+int (*WorkerPool::s_interrupted)() = NULL;
+
+
+WorkerPool::WorkerPool()
+{
+  pthread_mutex_init(&m_lock, NULL);
+  pthread_cond_init(&m_not_empty, NULL);
+  pthread_cond_init(&m_not_full, NULL);
+  m_queue_max = 0;
+  m_meta_reserved = m_data_limit = 0;
+  for(int l=0; l<LANES; l++) {
+    for(int p=0; p<PRIORITIES; p++) m_ready[l][p] = 0;
+  }
+  m_next = m_submitted = m_stolen = m_cancelled = 0;
+  m_stop = false;
+}
+
+
+WorkerPool::~WorkerPool()
+{
+  try { stop(); }
+  catch(...){}
+  pthread_cond_destroy(&m_not_full);
+  pthread_cond_destroy(&m_not_empty);
+  pthread_mutex_destroy(&m_lock);
+}
+
+
+void WorkerPool::start(size_t workers, size_t queue_max, size_t meta_reserved)
+{
+  m_stop = false;
+  m_queue_max = (queue_max>0)? queue_max: 1;
+  m_meta_reserved = (meta_reserved<workers)? meta_reserved: ((workers>1)? workers-1: 0);
+  m_data_limit = workers - m_meta_reserved;
+  m_class[FOREGROUND].limit = workers;
+  m_class[READAHEAD].limit = (workers>1)? workers/2: 1;
+  m_class[BACKGROUND].limit = (workers>3)? workers/4: 1;
+  for(size_t i=0; i<workers; i++) {
+    m_workers.push_back(new Worker(this, i));
+  }
+  for(size_t i=0; i<workers; i++) {
+    pthread_create(&m_workers[i]->thread, NULL, worker_main, (void*)m_workers[i]);
+  }
+}
+
+
+void WorkerPool::stop()
+{
+  if(m_workers.empty()) return;
+
+  pthread_mutex_lock(&m_lock);
+  {
+    m_stop = true;
+    pthread_cond_broadcast(&m_not_empty);
+  }
+  pthread_mutex_unlock(&m_lock);
+
+  std::vector<Worker*>::iterator it;
+  for(it=m_workers.begin(); it!=m_workers.end(); it++) {
+    void* ret;
+    pthread_join((*it)->thread, &ret);
+    delete (*it);
+  }
+  m_workers.clear();
+}
+
+
+void WorkerPool::limit(PRIORITY priority, size_t workers)
+{
+  pthread_mutex_lock(&m_lock);
+  {
+    m_class[priority].limit = (workers>0)? workers: 1;
+    pthread_cond_broadcast(&m_not_empty);
+  }
+  pthread_mutex_unlock(&m_lock);
+}
+
+
+void WorkerPool::submit(WorkerJob* job, LANE lane, PRIORITY priority)
+{
+  enqueue(job, lane, priority, true);
+}
+
+
+// submit() that does not wait for a full lane. Returns false if it is not submitted.
+bool WorkerPool::try_submit(WorkerJob* job, LANE lane, PRIORITY priority)
+{
+  return enqueue(job, lane, priority, false);
+}
+
+
+bool WorkerPool::enqueue(WorkerJob* job, LANE lane, PRIORITY priority, bool block)
+{
+  job->m_done = false;
+  job->m_queued = false;
+  job->m_lane = lane;
+  job->m_priority = priority;
+  job->m_submit_usec = now_usec();
+  job->m_trace_parent = Trace::current();
+
+  // Not started: run on the caller's thread.
+  if(m_workers.empty()) {
+    __sync_fetch_and_add(&m_submitted, 1);
+    job->run();
+    job->finish();
+    return true;
+  }
+
+  bool result = false;
+  pthread_mutex_lock(&m_lock);
+  {
+    LaneStat& ls = m_lane[lane];
+    if(ls.queued>=m_queue_max) ls.blocked++;
+    while(block && (ls.queued>=m_queue_max)) pthread_cond_wait(&m_not_full, &m_lock);
+    if(ls.queued<m_queue_max) {
+      ls.queued++;
+      ls.submitted++;
+      m_class[priority].submitted++;
+      __sync_fetch_and_add(&m_submitted, 1);
+
+      Worker* w = m_workers[m_next++ % m_workers.size()];
+      pthread_mutex_lock(&w->lock);
+      {
+        job->m_home = w->index;
+        job->m_queued = true;
+        w->jobs[lane][priority].push_back(job);
+      }
+      pthread_mutex_unlock(&w->lock);
+      m_ready[lane][priority]++;
+      pthread_cond_signal(&m_not_empty);
+      result = true;
+    }
+  }
+  pthread_mutex_unlock(&m_lock);
+  return result;
+}
+
+
+// raise the priority of a queued job in place.
+// Returns false if the job has been dispatched already.
+bool WorkerPool::promote(WorkerJob* job, PRIORITY priority)
+{
+  bool result = false;
+  if(m_workers.empty()) return false;
+
+  pthread_mutex_lock(&m_lock);
+  {
+    int l = job->m_lane, p = job->m_priority;
+    // m_ready==0: every queued job of the class is claimed by a worker.
+    if((p>priority) && (m_ready[l][p]>0)) {
+      Worker* w = m_workers[job->m_home];
+      pthread_mutex_lock(&w->lock);
+      if(job->m_queued) {
+        std::deque<WorkerJob*>& from = w->jobs[l][p];
+        std::deque<WorkerJob*>::iterator it;
+        for(it=from.begin(); it!=from.end(); it++) {
+          if((*it)==job) {
+            from.erase(it);
+            w->jobs[l][priority].push_front(job);
+            job->m_priority = priority;
+            result = true;
+            break;
+          }
+        }
+      }
+      pthread_mutex_unlock(&w->lock);
+      if(result) {
+        m_ready[l][p]--;
+        m_ready[l][priority]++;
+        m_class[priority].promoted++;
+        pthread_cond_broadcast(&m_not_empty);
+      }
+    }
+  }
+  pthread_mutex_unlock(&m_lock);
+  return result;
+}
+
+
+// drop a queued job. It is finished without running.
+// Returns false if the job has been dispatched already.
+bool WorkerPool::cancel(WorkerJob* job)
+{
+  bool result = false;
+  if(m_workers.empty()) return false;
+
+  pthread_mutex_lock(&m_lock);
+  {
+    int l = job->m_lane, p = job->m_priority;
+    if(m_ready[l][p]>0) {
+      Worker* w = m_workers[job->m_home];
+      pthread_mutex_lock(&w->lock);
+      if(job->m_queued) {
+        std::deque<WorkerJob*>& jobs = w->jobs[l][p];
+        std::deque<WorkerJob*>::iterator it;
+        for(it=jobs.begin(); it!=jobs.end(); it++) {
+          if((*it)==job) {
+            jobs.erase(it);
+            job->m_queued = false;
+            result = true;
+            break;
+          }
+        }
+      }
+      pthread_mutex_unlock(&w->lock);
+      if(result) {
+        m_ready[l][p]--;
+        m_lane[l].queued--;
+        m_cancelled++;
+        pthread_cond_broadcast(&m_not_full);
+      }
+    }
+  }
+  pthread_mutex_unlock(&m_lock);
+
+  if(result) job->finish();
+  return result;
+}
+
+
+// wait for a job on behalf of a client.
+// Returns false if the client has been interrupted.
+bool WorkerPool::wait(WorkerJob* job)
+{
+  // the client waits for a transfer run on a worker: its op is not served locally.
+  if(!s_on_worker && !job->done()) Latency::remote();
+  if((s_interrupted==NULL) || s_on_worker) {
+    job->wait();
+    return true;
+  }
+  while(!job->wait(WORKERPOOL_POLL_USEC)) {
+    if(s_interrupted()) return false;
+  }
+  return true;
+}
+
+
+WorkerPool::LaneStat WorkerPool::lane_stat(LANE lane)
+{
+  LaneStat ls;
+  pthread_mutex_lock(&m_lock);
+  {
+    ls = m_lane[lane];
+  }
+  pthread_mutex_unlock(&m_lock);
+  return ls;
+}
+
+
+WorkerPool::ClassStat WorkerPool::class_stat(PRIORITY priority)
+{
+  ClassStat cs;
+  pthread_mutex_lock(&m_lock);
+  {
+    cs = m_class[priority];
+  }
+  pthread_mutex_unlock(&m_lock);
+  return cs;
+}
+
+
+const char* WorkerPool::lane_name(LANE lane)
+{
+  switch(lane) {
+  case META:  return "meta";
+  case DATA:  return "data";
+  default:
+    break;
+  }
+  return "unknown";
+}
+
+
+const char* WorkerPool::priority_name(PRIORITY priority)
+{
+  switch(priority) {
+  case FOREGROUND:  return "foreground";
+  case READAHEAD:   return "readahead";
+  case BACKGROUND:  return "background";
+  default:
+    break;
+  }
+  return "unknown";
+}
+
+
+// Caller must hold m_lock.
+uint64_t WorkerPool::ready() const
+{
+  uint64_t n = 0;
+  for(int l=0; l<LANES; l++) {
+    for(int p=0; p<PRIORITIES; p++) n += m_ready[l][p];
+  }
+  return n;
+}
+
+
+// choose a job class to run: higher priority first, META before DATA,
+// within the class limit and the DATA lane limit.
+// Caller must hold m_lock.
+bool WorkerPool::claim(LANE& lane, PRIORITY& priority)
+{
+  for(int p=0; p<PRIORITIES; p++) {
+    if(m_class[p].running>=m_class[p].limit) continue;
+    for(int l=0; l<LANES; l++) {
+      if(m_ready[l][p]==0) continue;
+      if((l==DATA) && (m_lane[DATA].running>=m_data_limit)) continue;
+      lane = (LANE)l;
+      priority = (PRIORITY)p;
+      m_ready[l][p]--;
+      m_lane[l].running++;
+      m_class[p].running++;
+      return true;
+    }
+  }
+  return false;
+}
+
+
+// pop own deque from the front, or steal from the back of the others.
+// Caller must have claimed one job of the class.
+WorkerJob* WorkerPool::take(Worker* self, LANE lane, PRIORITY priority)
+{
+  size_t n = m_workers.size();
+  for(;;) {
+    for(size_t i=0; i<n; i++) {
+      Worker* w = m_workers[(self->index + i) % n];
+      WorkerJob* job = NULL;
+      pthread_mutex_lock(&w->lock);
+      std::deque<WorkerJob*>& jobs = w->jobs[lane][priority];
+      if(!jobs.empty()) {
+        if(w==self) {
+          job = jobs.front();
+          jobs.pop_front();
+        } else {
+          job = jobs.back();
+          jobs.pop_back();
+        }
+        job->m_queued = false;
+      }
+      pthread_mutex_unlock(&w->lock);
+      if(job) {
+        if(w!=self) __sync_fetch_and_add(&m_stolen, 1);
+        return job;
+      }
+    }
+    sched_yield();
+  }
+}
+
+
+void* WorkerPool::worker_main(void* ctx)
+{
+  Worker* self = (Worker*)ctx;
+  WorkerPool* pool = self->pool;
+  s_on_worker = true;
+  Trace::thread_name("worker");
+
+  for(;;) {
+    LANE lane;
+    PRIORITY priority;
+    bool claimed;
+    pthread_mutex_lock(&pool->m_lock);
+    while(!(claimed = pool->claim(lane, priority))) {
+      if(pool->m_stop && (pool->ready()==0)) break;
+      pthread_cond_wait(&pool->m_not_empty, &pool->m_lock);
+    }
+    pthread_mutex_unlock(&pool->m_lock);
+    if(!claimed) break;
+
+    WorkerJob* job = pool->take(self, lane, priority);
+    uint64_t wait = now_usec() - job->m_submit_usec;
+
+    pthread_mutex_lock(&pool->m_lock);
+    {
+      LaneStat& ls = pool->m_lane[lane];
+      ls.queued--;
+      ls.wait_usec += wait;
+      if(ls.wait_max_usec<wait) ls.wait_max_usec = wait;
+      pthread_cond_broadcast(&pool->m_not_full);
+    }
+    pthread_mutex_unlock(&pool->m_lock);
+
+    {
+      static const char* names[] = { "meta", "data" };
+      char detail[32] = "";
+      if(Trace::enabled()) snprintf(detail, sizeof(detail), "wait_usec=%"FINT64"u", wait);
+      TraceSpan span("pool", names[lane], detail, job->m_trace_parent);
+      job->run();
+    }
+
+    pthread_mutex_lock(&pool->m_lock);
+    {
+      pool->m_lane[lane].running--;
+      pool->m_class[priority].running--;
+      // a limited slot may be free now.
+      if((pool->ready()>0) || pool->m_stop) pthread_cond_broadcast(&pool->m_not_empty);
+    }
+    pthread_mutex_unlock(&pool->m_lock);
+    job->finish();
+  }
+  return NULL;
+}
+
+// vim: sw=2 sts=2 ts=4 expandtab :
@@ -0,0 +1,189 @@
+/*
+  Copyright 2010 Toshiyuki Terashita.
+
+  fuse-autohttpfs is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This software is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __INCLUDE_WORKERPOOL_H__
+#define __INCLUDE_WORKERPOOL_H__
+
+#include <stdint.h>
+#include <pthread.h>
+#include <deque>
+#include <vector>
+
+#ifndef WORKERPOOL_WORKERS
+# define WORKERPOOL_WORKERS (16)
+#endif
+
+#ifndef WORKERPOOL_QUEUE_MAX
+# define WORKERPOOL_QUEUE_MAX (256)
+#endif
+
+#ifndef WORKERPOOL_META_RESERVED
+# define WORKERPOOL_META_RESERVED (4)
+#endif
+
+#ifndef WORKERPOOL_POLL_USEC
+# define WORKERPOOL_POLL_USEC (50000)
+#endif
+
+
+// A unit of work executed by WorkerPool.
+class WorkerJob
+{
+public:
+  WorkerJob();
+  virtual ~WorkerJob();
+  virtual void run() = 0;
+  void wait();
+  bool wait(uint64_t usec);
+  bool done();
+
+private:
+  friend class WorkerPool;
+  pthread_mutex_t m_lock;
+  pthread_cond_t  m_cond;
+  volatile bool   m_done;
+  bool      m_queued;       // in a deque of m_home. guarded by the worker lock.
+  size_t    m_home;
+  int       m_lane;
+  int       m_priority;
+  uint64_t  m_submit_usec;
+  uint64_t  m_trace_parent; // span of the submitter.
+  void finish();
+};
+
+
+// Bounded pool of worker threads.
+// Each worker owns a deque per lane and priority; idle workers steal from the others.
+// submit() blocks while queue_max jobs of the lane are pending (backpressure), try_submit() fails.
+// Higher priorities are always dispatched first, within their concurrency limit.
+// DATA lane may use all workers but 'meta_reserved' of them.
+class WorkerPool
+{
+public:
+  typedef enum {
+    META = 0,   // getattr, opendir, readdir, open.
+    DATA,       // read.
+    LANES,
+  } LANE;
+
+  typedef enum {
+    FOREGROUND = 0, // a client is blocked on it.
+    READAHEAD,      // speculative read of the next range.
+    BACKGROUND,     // prefetch and revalidation.
+    PRIORITIES,
+  } PRIORITY;
+
+  // per lane statistics.
+  class LaneStat
+  {
+  public:
+    inline LaneStat() { queued = running = submitted = blocked = wait_usec = wait_max_usec = 0; };
+    uint64_t  queued;
+    uint64_t  running;
+    uint64_t  submitted;
+    uint64_t  blocked;
+    uint64_t  wait_usec;
+    uint64_t  wait_max_usec;
+  };
+
+  // per priority statistics.
+  class ClassStat
+  {
+  public:
+    inline ClassStat() { limit = running = submitted = promoted = 0; };
+    uint64_t  limit;
+    uint64_t  running;
+    uint64_t  submitted;
+    uint64_t  promoted;
+  };
+
+  WorkerPool();
+  virtual ~WorkerPool();
+  void start(size_t workers, size_t queue_max, size_t meta_reserved = WORKERPOOL_META_RESERVED);
+  void stop();
+  void submit(WorkerJob* job, LANE lane = META, PRIORITY priority = FOREGROUND);
+  bool try_submit(WorkerJob* job, LANE lane = META, PRIORITY priority = FOREGROUND);
+  inline void execute(WorkerJob* job, LANE lane = META, PRIORITY priority = FOREGROUND) {
+    submit(job, lane, priority);
+    job->wait();
+  };
+  bool promote(WorkerJob* job, PRIORITY priority = FOREGROUND);
+  bool cancel(WorkerJob* job);
+  bool wait(WorkerJob* job);
+  void limit(PRIORITY priority, size_t workers);
+  inline static bool on_worker() { return s_on_worker; };
+  inline static void interrupted(int (*func)()) { s_interrupted = func; };
+  inline static bool interrupted() { return (!s_on_worker && s_interrupted && s_interrupted()); };
+
+  inline size_t workers() const { return m_workers.size(); };
+  inline size_t queue_max() const { return m_queue_max; };
+  inline size_t meta_reserved() const { return m_meta_reserved; };
+  inline uint64_t queued() const { return m_lane[META].queued + m_lane[DATA].queued; };
+  inline uint64_t running() const { return m_lane[META].running + m_lane[DATA].running; };
+  inline uint64_t submitted() const { return m_submitted; };
+  inline uint64_t stolen() const { return m_stolen; };
+  inline uint64_t cancelled() const { return m_cancelled; };
+  inline uint64_t blocked() const { return m_lane[META].blocked + m_lane[DATA].blocked; };
+  LaneStat lane_stat(LANE lane);
+  ClassStat class_stat(PRIORITY priority);
+  static const char* lane_name(LANE lane);
+  static const char* priority_name(PRIORITY priority);
+
+private:
+  class Worker
+  {
+  public:
+    inline Worker(WorkerPool* p, size_t i) {
+      pool = p;
+      index = i;
+      pthread_mutex_init(&lock, NULL);
+    };
+    inline ~Worker() { pthread_mutex_destroy(&lock); };
+    WorkerPool* pool;
+    size_t    index;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    std::deque<WorkerJob*> jobs[LANES][PRIORITIES];
+  };
+
+  pthread_mutex_t m_lock;
+  pthread_cond_t  m_not_empty;
+  pthread_cond_t  m_not_full;
+  std::vector<Worker*> m_workers;
+  size_t    m_queue_max;
+  size_t    m_meta_reserved;
+  size_t    m_data_limit;
+  LaneStat  m_lane[LANES];    // 'queued' is submitted and not yet taken (backpressure).
+  ClassStat m_class[PRIORITIES];
+  uint64_t  m_ready[LANES][PRIORITIES]; // pushed and not yet claimed by a worker.
+  uint64_t  m_next;
+  uint64_t  m_submitted;
+  uint64_t  m_stolen;
+  uint64_t  m_cancelled;
+  bool      m_stop;
+  static __thread bool s_on_worker;
+  static int (*s_interrupted)();
+  uint64_t  ready() const;
+  bool      claim(LANE& lane, PRIORITY& priority);
+  WorkerJob* take(Worker* self, LANE lane, PRIORITY priority);
+  bool      enqueue(WorkerJob* job, LANE lane, PRIORITY priority, bool block);
+  static void* worker_main(void* ctx);
+};
+
+
+#endif // __INCLUDE_WORKERPOOL_H__
+// vim: sw=2 sts=2 ts=4 expandtab :